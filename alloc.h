@@ -0,0 +1,253 @@
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Allocation layers for mesh storage.
+ *
+ * Pool: size-classed free lists for buffers that are rebuilt over and over
+ * (meshes of live data). Class k holds blocks of 2^k bytes, so a rebuilt mesh
+ * of about the same size gets its old block back instead of going through
+ * malloc and faulting in fresh pages. Freed blocks are cached up to
+ * POOL_MAX_CACHED bytes in total; beyond that they go back to the system, so
+ * the cache cannot grow without bound. Blocks larger than the biggest class
+ * are plain mallocs. The pool is shared between threads behind one mutex,
+ * which is fine at one allocation per mesh.
+ *
+ * Arena: a bump allocator for scratch that only lives for one frame or one
+ * job. Allocation is a pointer increment, arena_reset() frees everything at
+ * once and keeps the chunks for the next frame. The render loop resets
+ * frame_arena at the start of every pass.
+ *
+ * The pool counts allocations and bytes so leaks and churn show up in the
+ * profiler: allocations since pool_begin_frame(), bytes in use and peak.
+ * pool_stats() reads them under the lock.
+ */
+
+#define POOL_MIN_CLASS 6
+#define POOL_MAX_CLASS 30
+#define POOL_LARGE 0xff
+#define POOL_MAX_CACHED ((size_t) 256 << 20)
+#define POOL_ALIGN 16
+
+typedef struct PoolHeader
+{
+    uint32_t size_class;
+    uint32_t unused;
+    size_t size;
+} PoolHeader;
+
+typedef struct PoolBlock
+{
+    struct PoolBlock *next;
+} PoolBlock;
+
+typedef struct Pool
+{
+    pthread_mutex_t mutex;
+    PoolBlock *free_lists[POOL_MAX_CLASS + 1];
+    size_t cached_bytes;
+    size_t allocations, frame_allocations;
+    size_t bytes_in_use, peak_bytes;
+} Pool;
+
+Pool mesh_pool = {PTHREAD_MUTEX_INITIALIZER};
+
+uint32_t pool_class(size_t size)
+{
+    uint32_t k = POOL_MIN_CLASS;
+    while (k <= POOL_MAX_CLASS && ((size_t) 1 << k) < size)
+        ++k;
+    return k <= POOL_MAX_CLASS ? k : POOL_LARGE;
+}
+
+/* Returns uninitialised, 16-byte aligned storage */
+void *pool_alloc(Pool *pool, size_t size)
+{
+    size_t total = size + sizeof(PoolHeader);
+    uint32_t k = pool_class(total);
+    PoolHeader *header = NULL;
+
+    pthread_mutex_lock(&pool->mutex);
+    if (k != POOL_LARGE && pool->free_lists[k] != NULL)
+    {
+        PoolBlock *block = pool->free_lists[k];
+        pool->free_lists[k] = block->next;
+        pool->cached_bytes -= (size_t) 1 << k;
+        header = (PoolHeader *) block;
+    }
+    ++pool->allocations;
+    ++pool->frame_allocations;
+    pool->bytes_in_use += size;
+    if (pool->bytes_in_use > pool->peak_bytes)
+        pool->peak_bytes = pool->bytes_in_use;
+    pthread_mutex_unlock(&pool->mutex);
+
+    if (header == NULL)
+    {
+        header = aligned_alloc(POOL_ALIGN, k != POOL_LARGE ? (size_t) 1 << k
+                                                           : (total + POOL_ALIGN - 1) / POOL_ALIGN * POOL_ALIGN);
+        if (header == NULL)
+        {
+            printf("error: out of memory allocating %zu bytes\n", size);
+            exit(1);
+        }
+    }
+    header->size_class = k;
+    header->size = size;
+    return header + 1;
+}
+
+void pool_free(Pool *pool, void *ptr)
+{
+    if (ptr == NULL)
+        return;
+    PoolHeader *header = (PoolHeader *) ptr - 1;
+    uint32_t k = header->size_class;
+    bool cache = false;
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->bytes_in_use -= header->size;
+    if (k != POOL_LARGE && pool->cached_bytes + ((size_t) 1 << k) <= POOL_MAX_CACHED)
+    {
+        PoolBlock *block = (PoolBlock *) header;
+        block->next = pool->free_lists[k];
+        pool->free_lists[k] = block;
+        pool->cached_bytes += (size_t) 1 << k;
+        cache = true;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    if (!cache)
+        free(header);
+}
+
+/* Starts a new frame for the per-frame allocation counter */
+void pool_begin_frame(Pool *pool)
+{
+    pthread_mutex_lock(&pool->mutex);
+    pool->frame_allocations = 0;
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+typedef struct PoolStats
+{
+    size_t allocations, frame_allocations;
+    size_t bytes_in_use, peak_bytes;
+} PoolStats;
+
+/* A consistent copy of the counters while other threads allocate */
+PoolStats pool_stats(Pool *pool)
+{
+    pthread_mutex_lock(&pool->mutex);
+    PoolStats stats = {pool->allocations, pool->frame_allocations, pool->bytes_in_use, pool->peak_bytes};
+    pthread_mutex_unlock(&pool->mutex);
+    return stats;
+}
+
+/* Returns every cached block to the system */
+void pool_trim(Pool *pool)
+{
+    pthread_mutex_lock(&pool->mutex);
+    for (size_t k = 0; k <= POOL_MAX_CLASS; ++k)
+    {
+        while (pool->free_lists[k] != NULL)
+        {
+            PoolBlock *block = pool->free_lists[k];
+            pool->free_lists[k] = block->next;
+            free(block);
+        }
+    }
+    pool->cached_bytes = 0;
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+#define ARENA_CHUNK ((size_t) 1 << 20)
+
+typedef struct ArenaChunk
+{
+    struct ArenaChunk *next;
+    size_t capacity, used;
+    _Alignas(POOL_ALIGN) unsigned char data[];
+} ArenaChunk;
+
+typedef struct Arena
+{
+    ArenaChunk *chunks; /* current chunk first */
+    ArenaChunk *spare;  /* chunks kept from before the last reset */
+} Arena;
+
+/* Scratch for one pass of the render loop, reset at its start; render thread only */
+Arena frame_arena = {NULL, NULL};
+
+void init_Arena(Arena *arena)
+{
+    arena->chunks = NULL;
+    arena->spare = NULL;
+}
+
+void *arena_alloc(Arena *arena, size_t size)
+{
+    size = (size + POOL_ALIGN - 1) / POOL_ALIGN * POOL_ALIGN;
+    ArenaChunk *chunk = arena->chunks;
+    if (chunk == NULL || chunk->used + size > chunk->capacity)
+    {
+        /* Reuse a spare chunk if it is big enough, else make one */
+        ArenaChunk **link = &arena->spare;
+        while (*link != NULL && (*link)->capacity < size)
+            link = &(*link)->next;
+        if (*link != NULL)
+        {
+            chunk = *link;
+            *link = chunk->next;
+        }
+        else
+        {
+            size_t capacity = size > ARENA_CHUNK ? size : ARENA_CHUNK;
+            chunk = malloc(sizeof(ArenaChunk) + capacity);
+            if (chunk == NULL)
+            {
+                printf("error: out of memory allocating %zu bytes\n", size);
+                exit(1);
+            }
+            chunk->capacity = capacity;
+        }
+        chunk->used = 0;
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+    }
+    void *ptr = &chunk->data[chunk->used];
+    chunk->used += size;
+    return ptr;
+}
+
+/* Frees everything allocated since the last reset, keeping the chunks */
+void arena_reset(Arena *arena)
+{
+    while (arena->chunks != NULL)
+    {
+        ArenaChunk *chunk = arena->chunks;
+        arena->chunks = chunk->next;
+        chunk->next = arena->spare;
+        arena->spare = chunk;
+    }
+}
+
+void delete_Arena(Arena *arena)
+{
+    arena_reset(arena);
+    while (arena->spare != NULL)
+    {
+        ArenaChunk *chunk = arena->spare;
+        arena->spare = chunk->next;
+        free(chunk);
+    }
+}
+
+#endif
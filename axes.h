@@ -0,0 +1,84 @@
+#ifndef AXES_H
+#define AXES_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "render.h"
+#include "ticks.h"
+
+/*
+ * Grid lines and the frame around the plot, all in one GL_LINES buffer
+ * allocated once at its largest size, TICKS_VERTICES vertices. A change of
+ * view rewrites the used part with one glBufferSubData of a few kilobytes
+ * and the frame draws them with a single glDrawArrays.
+ */
+
+const char axes_vertex_shader_source[] =
+    "#version 330 core\n"
+    "layout (location = 0) in vec3 aPos; /* z is brightness */\n"
+    "out float shade;\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "   shade = aPos.z;\n"
+    "   gl_Position = vec4(aPos.x, aPos.y, 0.0, 1.0);\n"
+    "}\n\0";
+const char axes_fragment_shader_source[] =
+    "#version 330 core\n"
+    "in float shade;\n"
+    "out vec4 FragColor;\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "    FragColor = vec4(vec3(shade), 1.0);\n"
+    "}\n\0";
+
+typedef struct Axes
+{
+    uint program, VAO, VBO;
+    size_t num_vertices;
+} Axes;
+
+void init_Axes(Axes *axes)
+{
+    axes->program = setup_shader_program(axes_vertex_shader_source, axes_fragment_shader_source);
+    glGenVertexArrays(1, &axes->VAO);
+    glGenBuffers(1, &axes->VBO);
+    glBindVertexArray(axes->VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, axes->VBO);
+    glBufferData(GL_ARRAY_BUFFER, TICKS_VERTICES * sizeof(vec3), NULL, GL_DYNAMIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), (void *) 0);
+    glEnableVertexAttribArray(0);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    axes->num_vertices = 0;
+}
+
+void delete_Axes(Axes *axes)
+{
+    glDeleteBuffers(1, &axes->VBO);
+    glDeleteVertexArrays(1, &axes->VAO);
+    glDeleteProgram(axes->program);
+}
+
+/* Rebuilds the grid lines for new ticks */
+void axes_update(Axes *axes, const Ticks *x, const Ticks *y)
+{
+    vec3 vertices[TICKS_VERTICES];
+    axes->num_vertices = tick_lines(x, y, vertices);
+    glBindBuffer(GL_ARRAY_BUFFER, axes->VBO);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, axes->num_vertices * sizeof(vec3), vertices);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void axes_draw(Axes *axes)
+{
+    glUseProgram(axes->program);
+    glBindVertexArray(axes->VAO);
+    glDrawArrays(GL_LINES, 0, axes->num_vertices);
+    glBindVertexArray(0);
+    glUseProgram(0);
+}
+
+#endif
@@ -0,0 +1,419 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mesh.h"
+#include "threads.h"
+#include "timing.h"
+#include "stream.h"
+#include "image.h"
+#ifdef PLOT_SOFTWARE
+#include "raster.h"
+#else
+#include "render.h"
+#endif
+
+/*
+ * Batch thumbnail rendering.
+ *
+ * The manifest has one job per line, "input.csv output.png width height";
+ * blank lines and lines starting with '#' are ignored. Jobs flow through a
+ * pipeline of bounded queues, so only a handful are ever in flight:
+ *
+ *     manifest -> mesh workers -> GL renderers -> PNG encoders
+ *
+ * Mesh workers load, downsample and mesh on the CPU. Each renderer owns a
+ * hidden window's GL context and reads pixels back through a pair of PBOs, so
+ * a frame is only mapped after the next one has been submitted and encoding
+ * overlaps with GPU work.
+ *
+ * Built with PLOT_SOFTWARE defined, the renderers use the software rasteriser
+ * instead and nothing here touches GL.
+ */
+
+typedef enum BatchStage
+{
+    STAGE_LOAD,
+    STAGE_DOWNSAMPLE,
+    STAGE_MESH,
+    STAGE_RENDER,
+    STAGE_ENCODE,
+    STAGE_COUNT,
+} BatchStage;
+
+const char *batch_stage_names[STAGE_COUNT] = {
+    "load", "downsample", "mesh", "render", "encode",
+};
+
+typedef struct BatchJob
+{
+    char input[512];
+    char output[512];
+    int width, height;
+    Mesh mesh;
+    unsigned char *pixels;
+    double seconds[STAGE_COUNT];
+} BatchJob;
+
+typedef struct Batch
+{
+    Queue mesh_queue, render_queue, encode_queue;
+    pthread_mutex_t stats_mutex;
+    double seconds[STAGE_COUNT];
+    size_t done, failed;
+} Batch;
+
+void batch_fail(Batch *batch, BatchJob *job)
+{
+    pthread_mutex_lock(&batch->stats_mutex);
+    ++batch->failed;
+    pthread_mutex_unlock(&batch->stats_mutex);
+    free(job);
+}
+
+void *batch_mesh_worker(void *arg)
+{
+    Batch *batch = arg;
+    Arena scratch;
+    init_Arena(&scratch);
+    BatchJob *job;
+    while ((job = queue_pop(&batch->mesh_queue)) != NULL)
+    {
+        double t0 = now_seconds();
+        size_t n;
+        vec3 *points = stream_csv(job->input, 1, &n, NULL);
+        if (points == NULL || n < 2)
+        {
+            printf("error: %s: need at least two points\n", job->input);
+            free(points);
+            batch_fail(batch, job);
+            continue;
+        }
+
+        /* Two samples per pixel column is all a line this thin can show */
+        double t1 = now_seconds();
+        vec3 *reduced = arena_alloc(&scratch, downsample_capacity(n, job->width) * sizeof(vec3));
+        size_t m = downsample_into(n, points, job->width, reduced);
+        free(points);
+
+        double t2 = now_seconds();
+        normalize(m, reduced);
+        job->mesh = line(m, reduced, 1.5f / job->height);
+        arena_reset(&scratch);
+
+        double t3 = now_seconds();
+        job->seconds[STAGE_LOAD] = t1 - t0;
+        job->seconds[STAGE_DOWNSAMPLE] = t2 - t1;
+        job->seconds[STAGE_MESH] = t3 - t2;
+        queue_push(&batch->render_queue, job);
+    }
+    delete_Arena(&scratch);
+    return NULL;
+}
+
+void *batch_encode_worker(void *arg)
+{
+    Batch *batch = arg;
+    BatchJob *job;
+    while ((job = queue_pop(&batch->encode_queue)) != NULL)
+    {
+        double t0 = now_seconds();
+        bool ok = write_png(job->output, job->width, job->height, job->pixels);
+        free(job->pixels);
+        job->seconds[STAGE_ENCODE] = now_seconds() - t0;
+
+        pthread_mutex_lock(&batch->stats_mutex);
+        for (size_t i = 0; i < STAGE_COUNT; ++i)
+            batch->seconds[i] += job->seconds[i];
+        if (ok)
+            ++batch->done;
+        else
+            ++batch->failed;
+        pthread_mutex_unlock(&batch->stats_mutex);
+        free(job);
+    }
+    return NULL;
+}
+
+#ifndef PLOT_SOFTWARE
+
+typedef struct BatchRenderer
+{
+    GLFWwindow *window;
+    GameObject plot;
+    uint FBO, RBO, PBO[2];
+    int width, height;
+    Batch *batch;
+} BatchRenderer;
+
+void batch_resize(BatchRenderer *renderer, int width, int height)
+{
+    if (renderer->width == width && renderer->height == height)
+        return;
+    glBindRenderbuffer(GL_RENDERBUFFER, renderer->RBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    renderer->width = width;
+    renderer->height = height;
+}
+
+/* Maps a finished readback and hands the job to the encoders */
+void batch_retire(BatchRenderer *renderer, BatchJob *job, uint PBO)
+{
+    double t0 = now_seconds();
+    size_t size = (size_t) job->width * job->height * 4;
+    job->pixels = malloc(size);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, PBO);
+    void *mapped = glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+    memcpy(job->pixels, mapped, size);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    job->seconds[STAGE_RENDER] += now_seconds() - t0;
+    queue_push(&renderer->batch->encode_queue, job);
+}
+
+void *batch_render_worker(void *arg)
+{
+    /*
+     * 1. Take over this renderer's context
+     * 2. Set up the plot object, framebuffer and PBOs
+     * 3. For each job, draw and start an asynchronous readback, then retire
+     *    the previous job whose readback has had a whole frame to complete
+     */
+    BatchRenderer *renderer = arg;
+    Batch *batch = renderer->batch;
+    glfwMakeContextCurrent(renderer->window);
+
+    renderer->plot.vertex_shader_source = strdup(plot_vertex_shader_source);
+    renderer->plot.fragment_shader_source = strdup(plot_fragment_shader_source);
+    renderer->plot.mesh = (Mesh) {0};
+    setup(&renderer->plot);
+
+    glGenRenderbuffers(1, &renderer->RBO);
+    renderer->width = renderer->height = 0;
+    batch_resize(renderer, 1, 1);
+    glGenFramebuffers(1, &renderer->FBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, renderer->FBO);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderer->RBO);
+    glGenBuffers(2, renderer->PBO);
+
+    BatchJob *pending = NULL;
+    size_t current = 0;
+    BatchJob *job;
+    while ((job = queue_pop(&batch->render_queue)) != NULL)
+    {
+        double t0 = now_seconds();
+        batch_resize(renderer, job->width, job->height);
+        renderer->plot.mesh = job->mesh;
+        upload(&renderer->plot, GL_STREAM_DRAW);
+        delete_Mesh(&job->mesh);
+        /* The mesh went back to the pool; draw() only needs the index count */
+        renderer->plot.mesh = (Mesh) {0, renderer->plot.mesh.num_indices};
+
+        glViewport(0, 0, job->width, job->height);
+        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        draw(&renderer->plot);
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, renderer->PBO[current]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, (size_t) job->width * job->height * 4, NULL, GL_STREAM_READ);
+        glReadPixels(0, 0, job->width, job->height, GL_RGBA, GL_UNSIGNED_BYTE, (void *) 0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        glFlush();
+        job->seconds[STAGE_RENDER] = now_seconds() - t0;
+
+        if (pending != NULL)
+            batch_retire(renderer, pending, renderer->PBO[1 - current]);
+        pending = job;
+        current = 1 - current;
+    }
+    if (pending != NULL)
+        batch_retire(renderer, pending, renderer->PBO[1 - current]);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &renderer->FBO);
+    glDeleteRenderbuffers(1, &renderer->RBO);
+    glDeleteBuffers(2, renderer->PBO);
+    delete_GameObject(&renderer->plot);
+    glfwMakeContextCurrent(NULL);
+    return NULL;
+}
+
+/* Creates `count` hidden windows to use as offscreen contexts and loads GL */
+void init_glfw_offscreen(size_t count, GLFWwindow *windows[count])
+{
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        windows[i] = glfwCreateWindow(1, 1, "batch", NULL, NULL);
+        if (windows[i] == NULL)
+        {
+            printf("Failed to create offscreen GLFW context\n");
+            glfwTerminate();
+            exit(-1);
+        }
+    }
+
+    glfwMakeContextCurrent(windows[0]);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        printf("Failed to initialize GLAD\n");
+        exit(-1);
+    }
+    glfwMakeContextCurrent(NULL);
+}
+
+void init_batch_renderers(size_t count, BatchRenderer renderers[count], Batch *batch)
+{
+    GLFWwindow *windows[count];
+    init_glfw_offscreen(count, windows);
+    for (size_t i = 0; i < count; ++i)
+    {
+        renderers[i].window = windows[i];
+        renderers[i].batch = batch;
+    }
+}
+
+void delete_batch_renderers(size_t count, BatchRenderer renderers[count])
+{
+    for (size_t i = 0; i < count; ++i)
+        glfwDestroyWindow(renderers[i].window);
+    glfwTerminate();
+}
+
+#else
+
+typedef struct BatchRenderer
+{
+    Framebuffer fb;
+    Batch *batch;
+} BatchRenderer;
+
+void *batch_render_worker(void *arg)
+{
+    /* The framebuffer's pixels are handed to the job, so each frame gets a fresh one */
+    BatchRenderer *renderer = arg;
+    Batch *batch = renderer->batch;
+    BatchJob *job;
+    while ((job = queue_pop(&batch->render_queue)) != NULL)
+    {
+        double t0 = now_seconds();
+        init_Framebuffer(&renderer->fb, job->width, job->height);
+        clear_Framebuffer(&renderer->fb, (vec4) {0.2f, 0.3f, 0.3f, 1.0f});
+        rasterize(&renderer->fb, &job->mesh, (vec4) {1.0f, 0.5f, 0.2f, 1.0f}, 0);
+        delete_Mesh(&job->mesh);
+        job->pixels = renderer->fb.pixels;
+        renderer->fb.pixels = NULL;
+        job->seconds[STAGE_RENDER] = now_seconds() - t0;
+        queue_push(&batch->encode_queue, job);
+    }
+    return NULL;
+}
+
+void init_batch_renderers(size_t count, BatchRenderer renderers[count], Batch *batch)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        renderers[i].fb.pixels = NULL;
+        renderers[i].batch = batch;
+    }
+}
+
+void delete_batch_renderers(size_t count, BatchRenderer renderers[count])
+{
+}
+
+#endif
+
+int run_batch(const char *manifest_filename, size_t num_contexts, size_t num_threads)
+{
+    FILE *manifest = fopen(manifest_filename, "r");
+    if (manifest == NULL)
+    {
+        printf("error: could not open manifest %s\n", manifest_filename);
+        return 1;
+    }
+    if (num_threads == 0)
+        num_threads = num_cores();
+    if (num_contexts == 0)
+        num_contexts = 1;
+
+    Batch batch = {0};
+    init_Queue(&batch.mesh_queue, 2 * num_threads);
+    init_Queue(&batch.render_queue, 2 * num_contexts);
+    init_Queue(&batch.encode_queue, 2 * num_threads);
+    pthread_mutex_init(&batch.stats_mutex, NULL);
+
+    BatchRenderer renderers[num_contexts];
+    init_batch_renderers(num_contexts, renderers, &batch);
+    pthread_t render_threads[num_contexts];
+    pthread_t mesh_threads[num_threads];
+    pthread_t encode_threads[num_threads];
+
+    double start = now_seconds();
+    for (size_t i = 0; i < num_threads; ++i)
+    {
+        pthread_create(&mesh_threads[i], NULL, batch_mesh_worker, &batch);
+        pthread_create(&encode_threads[i], NULL, batch_encode_worker, &batch);
+    }
+    for (size_t i = 0; i < num_contexts; ++i)
+        pthread_create(&render_threads[i], NULL, batch_render_worker, &renderers[i]);
+
+    /* Feed the pipeline; blocks whenever the mesh workers fall behind */
+    char buffer[1200];
+    size_t line_number = 0;
+    while (fgets(buffer, sizeof(buffer), manifest) != NULL)
+    {
+        ++line_number;
+        if (buffer[0] == '#' || strspn(buffer, " \t\r\n") == strlen(buffer))
+            continue;
+        BatchJob *job = calloc(1, sizeof(BatchJob));
+        if (sscanf(buffer, "%511s %511s %d %d", job->input, job->output, &job->width, &job->height) != 4
+            || job->width <= 0 || job->height <= 0)
+        {
+            printf("error: %s:%zu: expected \"input output width height\"\n", manifest_filename, line_number);
+            batch_fail(&batch, job);
+            continue;
+        }
+        queue_push(&batch.mesh_queue, job);
+    }
+    fclose(manifest);
+
+    /* Drain stage by stage */
+    queue_close(&batch.mesh_queue);
+    for (size_t i = 0; i < num_threads; ++i)
+        pthread_join(mesh_threads[i], NULL);
+    queue_close(&batch.render_queue);
+    for (size_t i = 0; i < num_contexts; ++i)
+        pthread_join(render_threads[i], NULL);
+    queue_close(&batch.encode_queue);
+    for (size_t i = 0; i < num_threads; ++i)
+        pthread_join(encode_threads[i], NULL);
+    double elapsed = now_seconds() - start;
+
+    printf("batch: %zu files (%zu failed) in %.3f s, %.1f files/s\n",
+           batch.done, batch.failed, elapsed, batch.done / elapsed);
+    for (size_t i = 0; i < STAGE_COUNT; ++i)
+    {
+        printf("  %-10s %9.3f s total %9.3f ms/file\n", batch_stage_names[i], batch.seconds[i],
+               batch.done ? 1e3 * batch.seconds[i] / batch.done : 0.0);
+    }
+
+    delete_batch_renderers(num_contexts, renderers);
+    delete_Queue(&batch.mesh_queue);
+    delete_Queue(&batch.render_queue);
+    delete_Queue(&batch.encode_queue);
+    pthread_mutex_destroy(&batch.stats_mutex);
+
+    return batch.failed ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,304 @@
+#ifndef COLUMNS_H
+#define COLUMNS_H
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stream.h"
+#include "threads.h"
+#include "timestamps.h"
+
+/*
+ * Multi-column CSV: a header line naming the columns, then rows of numbers,
+ * plain or compressed. One column is x. Any number of others are series
+ * that share it. read_columns() selects them by name or 0-based index and
+ * reads them all in one streaming pass (stream.h) into one float array per
+ * column, structure of arrays.
+ *
+ * Unselected columns are stepped over without being converted, and each row
+ * is only read up to its last selected column, so the cost follows the
+ * bytes in the file, not the number of series taken from it. An empty field
+ * in a selected column reads as NaN, which draws as a gap. Anything else
+ * that is not a number ends the rows there, as in read_csv().
+ *
+ * An x column of times, ISO-8601 or nanoseconds since the epoch, can be
+ * read as such (timestamps.h) into int64 nanoseconds, which keep their
+ * precision where a float x would round them to minutes.
+ */
+
+typedef struct Columns
+{
+    size_t num_rows, num_series;
+    char *x_name;
+    char **names; /* of the series */
+    float *x; /* for a time x, seconds since the first row's time */
+    int64_t *t; /* a time x in nanoseconds since the epoch, or NULL */
+    float **y; /* y[series][row] */
+} Columns;
+
+/* Which file column goes where, from the header and the selection */
+typedef struct ColumnMap
+{
+    const char *filename, *x, *y;
+    bool time; /* x is a timestamp, which takes the first two floats of a row */
+    StreamFormat *format; /* whose row size the header sets */
+    int *role; /* per file column up to the last selected: -1 skipped, 0 for x, 1 + s for series s */
+    size_t num_fields, num_series;
+    char **header;
+    size_t num_header;
+} ColumnMap;
+
+void skip_blanks(const char **p)
+{
+    while (**p == ' ' || **p == '\t' || **p == '\r')
+        ++*p;
+}
+
+/* Splits the header into trimmed names, without any quotes around them */
+void split_header(ColumnMap *map, const char *line)
+{
+    size_t capacity = 16;
+    map->header = malloc(capacity * sizeof(char *));
+    map->num_header = 0;
+    for (const char *p = line;; ++p)
+    {
+        skip_blanks(&p);
+        const char *end = p;
+        while (*end != ',' && *end != '\0')
+            ++end;
+        const char *last = end;
+        while (last > p && isspace((unsigned char) last[-1]))
+            --last;
+        if (last - p >= 2 && *p == '"' && last[-1] == '"')
+        {
+            ++p;
+            --last;
+        }
+        if (map->num_header == capacity)
+        {
+            capacity *= 2;
+            map->header = realloc(map->header, capacity * sizeof(char *));
+        }
+        map->header[map->num_header++] = copy_text(p, last - p);
+        p = end;
+        if (*p == '\0')
+            break;
+    }
+}
+
+/* The column a selection names, by name first and then by index; -1 if none */
+long find_column(const ColumnMap *map, const char *name, size_t length)
+{
+    for (size_t i = 0; i < map->num_header; ++i)
+        if (strlen(map->header[i]) == length && strncmp(map->header[i], name, length) == 0)
+            return i;
+    char *end;
+    long index = strtol(name, &end, 10);
+    if (end == name + length && length > 0 && index >= 0 && (size_t) index < map->num_header)
+        return index;
+    return -1;
+}
+
+/* Maps the header's columns to x and the series; false, with an error, if a selected column is missing */
+bool column_header(void *ctx, const char *line)
+{
+    ColumnMap *map = ctx;
+    split_header(map, line);
+    map->role = malloc(map->num_header * sizeof(int));
+    for (size_t i = 0; i < map->num_header; ++i)
+        map->role[i] = -1;
+
+    long x = map->x != NULL ? find_column(map, map->x, strlen(map->x)) : 0;
+    if (x < 0)
+    {
+        printf("error: %s has no column %s\n", map->filename, map->x);
+        return false;
+    }
+    map->role[x] = 0;
+    map->num_fields = x + 1;
+    map->num_series = 0;
+    if (map->y == NULL)
+    {
+        for (size_t i = 0; i < map->num_header; ++i)
+            if ((long) i != x)
+                map->role[i] = 1 + map->num_series++;
+        map->num_fields = map->num_header;
+        map->format->row_size = (1 + map->time + map->num_series) * sizeof(float);
+        return true;
+    }
+    for (const char *p = map->y; *p != '\0';)
+    {
+        const char *end = strchr(p, ',');
+        size_t length = end != NULL ? (size_t) (end - p) : strlen(p);
+        long column = find_column(map, p, length);
+        if (column < 0 || map->role[column] >= 0)
+        {
+            printf("error: %s has no column %.*s, or it is selected twice\n", map->filename, (int) length, p);
+            return false;
+        }
+        map->role[column] = 1 + map->num_series++;
+        map->num_fields = (size_t) column + 1 > map->num_fields ? (size_t) column + 1 : map->num_fields;
+        p += length + (end != NULL);
+    }
+    map->format->row_size = (1 + map->time + map->num_series) * sizeof(float);
+    return true;
+}
+
+/* Reads a timestamp field, which may be quoted, into the first 8 bytes of a row; false if it is not one */
+bool column_time(const char **p, void *row)
+{
+    int64_t t;
+    const char *end;
+    bool quoted = **p == '"';
+    if (!parse_timestamp(*p + quoted, &end, &t) || (quoted && *end++ != '"'))
+        return false;
+    memcpy(row, &t, sizeof(t));
+    *p = end;
+    return true;
+}
+
+/* Reads a row's selected fields into x and the series, in that order; see RowParser */
+int column_row(void *ctx, const char *line, void *row)
+{
+    const ColumnMap *map = ctx;
+    float *out = row;
+    const char *p = line;
+    skip_blanks(&p);
+    if (*p == '\n' || *p == '\0')
+        return 0;
+    for (size_t i = 0; i < map->num_fields; ++i)
+    {
+        if (map->role[i] < 0)
+        {
+            while (*p != ',' && *p != '\n' && *p != '\0')
+                ++p;
+        }
+        else if (map->role[i] == 0 && map->time)
+        {
+            skip_blanks(&p);
+            if (!column_time(&p, row))
+                return -1;
+            skip_blanks(&p);
+        }
+        else
+        {
+            skip_blanks(&p);
+            char *end;
+            float value = strtof(p, &end);
+            if (end == p && *p != ',' && *p != '\n' && *p != '\0')
+                return -1;
+            out[map->role[i] + (map->role[i] > 0 && map->time)] = end == p ? NAN : value;
+            p = end;
+            skip_blanks(&p);
+        }
+        if (i + 1 < map->num_fields)
+        {
+            if (*p != ',')
+                return -1;
+            ++p;
+        }
+    }
+    return 1;
+}
+
+typedef struct ColumnSplit
+{
+    const float *rows;
+    Columns *columns;
+} ColumnSplit;
+
+/* Copies columns [begin, end) out of the rows; column 0 is x, whose time takes two floats */
+void column_split(void *ctx, size_t thread, size_t begin, size_t end)
+{
+    ColumnSplit *split = ctx;
+    Columns *columns = split->columns;
+    size_t time = columns->t != NULL, stride = columns->num_series + 1 + time;
+    for (size_t c = begin; c < end; ++c)
+    {
+        if (c == 0 && time)
+        {
+            for (size_t i = 0; i < columns->num_rows; ++i)
+                memcpy(&columns->t[i], &split->rows[i * stride], sizeof(int64_t));
+            for (size_t i = 0; i < columns->num_rows; ++i)
+                columns->x[i] = time_offset(columns->t[i], columns->t[0]);
+            continue;
+        }
+        float *out = c == 0 ? columns->x : columns->y[c - 1];
+        for (size_t i = 0; i < columns->num_rows; ++i)
+            out[i] = split->rows[i * stride + c + (c > 0 ? time : 0)];
+    }
+}
+
+/*
+ * Reads column `x` and the comma-separated columns `y` of a CSV file with a
+ * header, by name or index, on num_threads workers (0 for one per core).
+ * A NULL x is the first column, and a NULL y is every column but x. With
+ * `time`, x is read as timestamps into columns->t. False, with an error, if
+ * the file cannot be read or a column is missing.
+ */
+bool read_columns(const char *filename, const char *x, const char *y, bool time, size_t num_threads,
+                  Columns *columns)
+{
+    /* The row size comes from the header, which is read before any row */
+    StreamFormat format = {column_row, column_header, NULL, 0};
+    ColumnMap map = {filename, x, y, time, &format};
+    format.ctx = &map;
+    size_t n;
+    float *rows = stream_rows(filename, &format, num_threads, &n, NULL);
+    bool ok = rows != NULL && map.role != NULL;
+    if (ok)
+    {
+        *columns = (Columns) {n, map.num_series};
+        columns->names = malloc((map.num_series > 0 ? map.num_series : 1) * sizeof(char *));
+        columns->y = malloc((map.num_series > 0 ? map.num_series : 1) * sizeof(float *));
+        columns->x = malloc((n > 0 ? n : 1) * sizeof(float));
+        columns->t = time ? malloc((n > 0 ? n : 1) * sizeof(int64_t)) : NULL;
+        for (size_t i = 0; i < map.num_header; ++i)
+        {
+            if (map.role[i] == 0)
+                columns->x_name = map.header[i];
+            else if (map.role[i] > 0)
+            {
+                columns->names[map.role[i] - 1] = map.header[i];
+                columns->y[map.role[i] - 1] = malloc((n > 0 ? n : 1) * sizeof(float));
+            }
+        }
+        ColumnSplit split = {rows, columns};
+        parallel_for(num_threads > 0 ? num_threads : num_cores(), map.num_series + 1, column_split, &split);
+    }
+    for (size_t i = 0; i < map.num_header; ++i)
+        if (!ok || map.role[i] < 0)
+            free(map.header[i]);
+    free(map.header);
+    free(map.role);
+    free(rows);
+    return ok;
+}
+
+void delete_Columns(Columns *columns)
+{
+    free(columns->x_name);
+    for (size_t s = 0; s < columns->num_series; ++s)
+    {
+        free(columns->names[s]);
+        free(columns->y[s]);
+    }
+    free(columns->names);
+    free(columns->y);
+    free(columns->x);
+    free(columns->t);
+}
+
+/* One series as (x, y, 0) points, for everything that takes them */
+vec3 *column_points(const Columns *columns, size_t series)
+{
+    vec3 *points = malloc((columns->num_rows > 0 ? columns->num_rows : 1) * sizeof(vec3));
+    for (size_t i = 0; i < columns->num_rows; ++i)
+        points[i] = (vec3) {columns->x[i], columns->y[series][i], 0};
+    return points;
+}
+
+#endif
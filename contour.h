@@ -0,0 +1,565 @@
+#ifndef CONTOUR_H
+#define CONTOUR_H
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "grid.h"
+#include "mathlib.h"
+#include "mesh.h"
+#include "threads.h"
+
+/*
+ * Contour plots: level sets of a scalar field sampled on a grid, by
+ * marching squares.
+ *
+ * The grid is cut into one band of rows per thread. Each band walks its
+ * cells once for all levels: every sample is first given the number of
+ * levels at or below it, and a cell crosses exactly the levels between the
+ * smallest and largest count of its corners, so the many cells whose corners
+ * agree cost three integer comparisons. Every crossing is a segment between two cell edges, the point
+ * on an edge being interpolated the same way whichever cell computes it.
+ * Segments are then stitched into polylines within the band, joining ends
+ * that lie on the same edge at the same level. Polylines left open on a
+ * band's top or bottom row are stitched again across bands on the calling
+ * thread; there are only as many of those as contours crossing band edges.
+ *
+ * Saddle cells (opposite corners on the same side) are resolved by the mean
+ * of the corners. A corner exactly on a level counts as above it. Cells with
+ * a NaN corner are skipped, leaving gaps.
+ */
+
+typedef struct Contours
+{
+    vec3 *points;
+    size_t num_points;
+    size_t *starts;    /* line i is points[starts[i], starts[i + 1]) */
+    uint32_t *levels;  /* level index of each line */
+    size_t num_lines;
+} Contours;
+
+void delete_Contours(Contours *contours)
+{
+    free(contours->points);
+    free(contours->starts);
+    free(contours->levels);
+    *contours = (Contours) {0};
+}
+
+/*
+ * Stitching: pieces of polyline joined end to end where their end keys
+ * match. Each key is shared by at most two ends, so ends are paired off
+ * through a map holding only those still waiting for a partner; fed in row
+ * order that is one row's worth of crossings, which stays in cache.
+ */
+
+#define CONTOUR_NONE UINT64_MAX
+
+typedef struct ContourSlot
+{
+    uint64_t key;
+    size_t ref; /* 2 * piece + end */
+} ContourSlot;
+
+typedef struct ContourMap
+{
+    ContourSlot *slots;
+    size_t mask, count;
+} ContourMap;
+
+void init_ContourMap(ContourMap *map, size_t capacity)
+{
+    map->slots = malloc(capacity * sizeof(ContourSlot));
+    map->mask = capacity - 1;
+    map->count = 0;
+    for (size_t i = 0; i < capacity; ++i)
+        map->slots[i].key = CONTOUR_NONE;
+}
+
+size_t contour_home(const ContourMap *map, uint64_t key)
+{
+    return (key * 0x9e3779b97f4a7c15ull) >> 32 & map->mask;
+}
+
+void contour_put(ContourMap *map, uint64_t key, size_t ref)
+{
+    if (2 * (map->count + 1) > map->mask + 1)
+    {
+        ContourMap grown;
+        init_ContourMap(&grown, 2 * (map->mask + 1));
+        for (size_t i = 0; i <= map->mask; ++i)
+            if (map->slots[i].key != CONTOUR_NONE)
+                contour_put(&grown, map->slots[i].key, map->slots[i].ref);
+        free(map->slots);
+        *map = grown;
+    }
+    size_t i = contour_home(map, key);
+    while (map->slots[i].key != CONTOUR_NONE)
+        i = (i + 1) & map->mask;
+    map->slots[i] = (ContourSlot) {key, ref};
+    ++map->count;
+}
+
+/* Removes key and returns its ref, or returns SIZE_MAX if absent */
+size_t contour_take(ContourMap *map, uint64_t key)
+{
+    size_t i = contour_home(map, key);
+    while (map->slots[i].key != key)
+    {
+        if (map->slots[i].key == CONTOUR_NONE)
+            return SIZE_MAX;
+        i = (i + 1) & map->mask;
+    }
+    size_t ref = map->slots[i].ref;
+
+    /* Shift later entries of the run back so that no lookup stops short */
+    for (size_t j = (i + 1) & map->mask; map->slots[j].key != CONTOUR_NONE; j = (j + 1) & map->mask)
+    {
+        size_t home = contour_home(map, map->slots[j].key);
+        if (((j - home) & map->mask) >= ((j - i) & map->mask))
+        {
+            map->slots[i] = map->slots[j];
+            i = j;
+        }
+    }
+    map->slots[i].key = CONTOUR_NONE;
+    --map->count;
+    return ref;
+}
+
+/* partner[ref] = the other end with the same key, or SIZE_MAX, for the 2 * count ends */
+void contour_link(const uint64_t *keys, size_t count, size_t *partner)
+{
+    ContourMap map;
+    init_ContourMap(&map, 1024);
+    for (size_t ref = 0; ref < 2 * count; ++ref)
+    {
+        partner[ref] = SIZE_MAX;
+        if (keys[ref] == CONTOUR_NONE)
+            continue;
+        size_t other = contour_take(&map, keys[ref]);
+        if (other == SIZE_MAX)
+        {
+            contour_put(&map, keys[ref], ref);
+        }
+        else
+        {
+            partner[ref] = other;
+            partner[other] = ref;
+        }
+    }
+    free(map.slots);
+}
+
+/* Growable polyline output */
+typedef struct ContourBuffer
+{
+    vec3 *points;
+    size_t num_points, point_capacity;
+    size_t *starts;    /* num_lines + 1 once finished */
+    uint64_t *ends;    /* end keys of each line, CONTOUR_NONE on both if closed */
+    uint32_t *levels;
+    size_t num_lines, line_capacity;
+} ContourBuffer;
+
+void contour_push_point(ContourBuffer *out, vec3 p)
+{
+    /* Joined pieces share their end point; level values exactly at a corner can repeat one too */
+    size_t start = out->starts[out->num_lines];
+    if (out->num_points > start)
+    {
+        vec3 last = out->points[out->num_points - 1];
+        if (last.x == p.x && last.y == p.y)
+            return;
+    }
+    if (out->num_points == out->point_capacity)
+    {
+        out->point_capacity = out->point_capacity ? 2 * out->point_capacity : 1024;
+        out->points = realloc(out->points, out->point_capacity * sizeof(vec3));
+    }
+    out->points[out->num_points++] = p;
+}
+
+void contour_begin_line(ContourBuffer *out)
+{
+    if (out->num_lines + 1 >= out->line_capacity)
+    {
+        out->line_capacity = out->line_capacity ? 2 * out->line_capacity : 256;
+        out->starts = realloc(out->starts, (out->line_capacity + 1) * sizeof(size_t));
+        out->ends = realloc(out->ends, 2 * out->line_capacity * sizeof(uint64_t));
+        out->levels = realloc(out->levels, out->line_capacity * sizeof(uint32_t));
+    }
+    if (out->num_lines == 0)
+        out->starts[0] = out->num_points;
+}
+
+void contour_end_line(ContourBuffer *out, uint64_t first, uint64_t last, uint32_t level)
+{
+    /* A line that came down to one point is dropped */
+    if (out->num_points - out->starts[out->num_lines] < 2)
+    {
+        out->num_points = out->starts[out->num_lines];
+        return;
+    }
+    out->ends[2 * out->num_lines] = first;
+    out->ends[2 * out->num_lines + 1] = last;
+    out->levels[out->num_lines] = level;
+    out->starts[++out->num_lines] = out->num_points;
+}
+
+void delete_ContourBuffer(ContourBuffer *buffer)
+{
+    free(buffer->points);
+    free(buffer->starts);
+    free(buffer->ends);
+    free(buffer->levels);
+}
+
+typedef struct ContourPieces
+{
+    const vec3 *points;
+    const size_t *starts;  /* piece p is points[starts[p], starts[p + 1]); NULL: two points each */
+    const uint64_t *keys;  /* first and last end key of each piece */
+    const uint32_t *levels;
+    size_t count;
+} ContourPieces;
+
+size_t piece_start(const ContourPieces *pieces, size_t p)
+{
+    return pieces->starts != NULL ? pieces->starts[p] : 2 * p;
+}
+
+/* Appends piece p to the current line, from end `entry` to the other */
+void contour_emit(ContourBuffer *out, const ContourPieces *pieces, size_t p, size_t entry)
+{
+    size_t begin = piece_start(pieces, p), end = piece_start(pieces, p + 1);
+    if (entry == 0)
+        for (size_t i = begin; i < end; ++i)
+            contour_push_point(out, pieces->points[i]);
+    else
+        for (size_t i = end; i-- > begin;)
+            contour_push_point(out, pieces->points[i]);
+}
+
+/* Joins pieces into maximal chains and appends them to `out` as lines */
+void contour_stitch(const ContourPieces *pieces, ContourBuffer *out)
+{
+    size_t *partner = malloc(2 * pieces->count * sizeof(size_t));
+    contour_link(pieces->keys, pieces->count, partner);
+    bool *visited = calloc(pieces->count, sizeof(bool));
+
+    for (size_t p = 0; p < pieces->count; ++p)
+    {
+        if (visited[p])
+            continue;
+
+        /* Walk back to an open end, or all the way round a loop */
+        size_t start = p, entry = 0;
+        bool closed = false;
+        for (size_t steps = 0; steps < pieces->count; ++steps)
+        {
+            size_t other = partner[2 * start + entry];
+            if (other == SIZE_MAX)
+                break;
+            if (other / 2 == p)
+            {
+                closed = true;
+                start = p;
+                entry = 0;
+                break;
+            }
+            start = other / 2;
+            entry = 1 - other % 2;
+        }
+
+        /* Then forwards, emitting; a loop's last point comes back round to its first */
+        contour_begin_line(out);
+        uint64_t first = closed ? CONTOUR_NONE : pieces->keys[2 * start + entry];
+        uint64_t last = CONTOUR_NONE;
+        size_t cur = start, cur_entry = entry;
+        for (;;)
+        {
+            visited[cur] = true;
+            contour_emit(out, pieces, cur, cur_entry);
+            size_t exit = 2 * cur + 1 - cur_entry, other = partner[exit];
+            if (other == SIZE_MAX || visited[other / 2])
+            {
+                last = closed ? CONTOUR_NONE : pieces->keys[exit];
+                break;
+            }
+            cur = other / 2;
+            cur_entry = other % 2;
+        }
+        contour_end_line(out, first, last, pieces->levels[start]);
+    }
+    free(visited);
+    free(partner);
+}
+
+/* Marching squares */
+
+#define CONTOUR_NAN UINT16_MAX
+#define CONTOUR_MAX_LEVELS (UINT16_MAX - 1)
+
+/*
+ * The number of levels at or below each of n values, CONTOUR_NAN for NaN.
+ * Neighbouring samples of a smooth field mostly share a count, so the last
+ * one is tried before searching.
+ */
+void contour_buckets(const float *values, size_t n, const float *levels, size_t num_levels, uint16_t *out)
+{
+    size_t b = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        float v = values[i];
+        if (isnan(v))
+        {
+            out[i] = CONTOUR_NAN;
+            continue;
+        }
+        if ((b > 0 && v < levels[b - 1]) || (b < num_levels && v >= levels[b]))
+        {
+            size_t lo = 0, hi = num_levels;
+            while (lo < hi)
+            {
+                size_t mid = (lo + hi) / 2;
+                if (levels[mid] <= v)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            b = lo;
+        }
+        out[i] = b;
+    }
+}
+
+typedef struct ContourJob
+{
+    const Grid *grid;
+    const float *levels;
+    size_t num_levels, num_bands;
+    ContourBuffer *bands; /* stitched lines of each band */
+} ContourJob;
+
+typedef struct ContourSegments
+{
+    vec3 *points;      /* two per segment */
+    uint64_t *keys;    /* two per segment */
+    uint32_t *levels;
+    size_t count, capacity;
+} ContourSegments;
+
+/*
+ * Segments of each cell case as pairs of cell edges: 0 bottom, 1 right,
+ * 2 top, 3 left, with corner bits 1 bottom left, 2 bottom right, 4 top
+ * right and 8 top left set at or above the level. Saddles 5 and 10 list
+ * the pairing for a centre above the level; below it they swap.
+ */
+static const signed char contour_cases[16][4] = {
+    {-1}, {3, 0, -1}, {0, 1, -1}, {3, 1, -1}, {1, 2, -1}, {0, 1, 2, 3}, {0, 2, -1}, {3, 2, -1},
+    {2, 3, -1}, {0, 2, -1}, {3, 0, 1, 2}, {1, 2, -1}, {3, 1, -1}, {0, 1, -1}, {3, 0, -1}, {-1},
+};
+
+void contour_cells(void *ctx, size_t thread, size_t begin, size_t end)
+{
+    ContourJob *job = ctx;
+    const Grid *grid = job->grid;
+    size_t nx = grid->width, ny = grid->height;
+    uint64_t horizontal = (uint64_t) ny * (nx - 1), num_edges = horizontal + (uint64_t) (ny - 1) * nx;
+    float dx = (grid->x1 - grid->x0) / (nx - 1), dy = (grid->y1 - grid->y0) / (ny - 1);
+    float x0 = grid->x0, y0 = grid->y0;
+
+    uint16_t *buckets = malloc(2 * nx * sizeof(uint16_t));
+    for (size_t band = begin; band < end; ++band)
+    {
+        ContourSegments segments = {0};
+        size_t j0 = band * (ny - 1) / job->num_bands, j1 = (band + 1) * (ny - 1) / job->num_bands;
+        uint16_t *below = buckets, *top = buckets + nx;
+        contour_buckets(&grid->values[j0 * nx], nx, job->levels, job->num_levels, top);
+        for (size_t j = j0; j < j1; ++j)
+        {
+            const float *row = &grid->values[j * nx], *above = row + nx;
+            uint16_t *swap = below;
+            below = top;
+            top = swap;
+            contour_buckets(above, nx, job->levels, job->num_levels, top);
+            for (size_t i = 0; i + 1 < nx; ++i)
+            {
+                /* All four corners between the same two levels: nothing crosses */
+                uint16_t b[4] = {below[i], below[i + 1], top[i + 1], top[i]};
+                if (b[0] == b[1] && b[0] == b[2] && b[0] == b[3])
+                    continue;
+                if (b[0] == CONTOUR_NAN || b[1] == CONTOUR_NAN || b[2] == CONTOUR_NAN || b[3] == CONTOUR_NAN)
+                    continue;
+                float v[4] = {row[i], row[i + 1], above[i + 1], above[i]};
+
+                /* Level k crosses if it is above one corner and at or below another */
+                size_t k = b[0], k1 = b[0];
+                for (int c = 1; c < 4; ++c)
+                {
+                    k = b[c] < k ? b[c] : k;
+                    k1 = b[c] > k1 ? b[c] : k1;
+                }
+                for (; k < k1; ++k)
+                {
+                    float level = job->levels[k];
+                    int index = (v[0] >= level) | (v[1] >= level) << 1 | (v[2] >= level) << 2 | (v[3] >= level) << 3;
+                    const signed char *edges = contour_cases[index];
+                    bool swap = (index == 5 || index == 10) && (v[0] + v[1] + v[2] + v[3]) / 4 < level;
+
+                    for (int s = 0; s < 4 && edges[s] >= 0; s += 2)
+                    {
+                        if (segments.count == segments.capacity)
+                        {
+                            segments.capacity = segments.capacity ? 2 * segments.capacity : 4096;
+                            segments.points = realloc(segments.points, 2 * segments.capacity * sizeof(vec3));
+                            segments.keys = realloc(segments.keys, 2 * segments.capacity * sizeof(uint64_t));
+                            segments.levels = realloc(segments.levels, segments.capacity * sizeof(uint32_t));
+                        }
+                        size_t at = 2 * segments.count;
+                        for (int e = 0; e < 2; ++e)
+                        {
+                            /* Swapping a saddle pairs each edge with its other neighbour */
+                            int edge = edges[swap ? (s + e + 3) % 4 : s + e];
+                            /* Edges run left to right and bottom to top, so both cells interpolate alike */
+                            float from, to;
+                            size_t ei = i + (edge == 1), ej = j + (edge == 2);
+                            uint64_t id;
+                            if (edge == 0 || edge == 2)
+                            {
+                                from = edge == 0 ? v[0] : v[3];
+                                to = edge == 0 ? v[1] : v[2];
+                                float t = (level - from) / (to - from);
+                                segments.points[at + e] = (vec3) {x0 + (ei + t) * dx, y0 + ej * dy, 0};
+                                id = (uint64_t) ej * (nx - 1) + ei;
+                            }
+                            else
+                            {
+                                from = edge == 3 ? v[0] : v[1];
+                                to = edge == 3 ? v[3] : v[2];
+                                float t = (level - from) / (to - from);
+                                segments.points[at + e] = (vec3) {x0 + ei * dx, y0 + (ej + t) * dy, 0};
+                                id = horizontal + (uint64_t) ej * nx + ei;
+                            }
+                            segments.keys[at + e] = k * num_edges + id;
+                        }
+                        segments.levels[segments.count++] = k;
+                    }
+                }
+            }
+        }
+
+        ContourPieces pieces = {segments.points, NULL, segments.keys, segments.levels, segments.count};
+        contour_stitch(&pieces, &job->bands[band]);
+        free(segments.points);
+        free(segments.keys);
+        free(segments.levels);
+    }
+    free(buckets);
+}
+
+/* n levels evenly spaced strictly between the grid's smallest and largest values */
+void contour_levels(const Grid *grid, size_t n, float levels[n])
+{
+    float lo = INFINITY, hi = -INFINITY;
+    for (size_t c = 0; c < grid->width * grid->height; ++c)
+    {
+        lo = grid->values[c] < lo ? grid->values[c] : lo;
+        hi = grid->values[c] > hi ? grid->values[c] : hi;
+    }
+    for (size_t k = 0; k < n; ++k)
+        levels[k] = lo + (k + 1) * (hi - lo) / (n + 1);
+}
+
+/*
+ * Contours the grid at each of num_levels ascending levels on num_threads
+ * threads (0 for every core) into `out`, whose lines are each one
+ * continuous polyline, closed ones ending on their first point. Returns
+ * false if the levels are not ascending.
+ */
+bool contour_grid(const Grid *grid, size_t num_levels, const float levels[num_levels], size_t num_threads,
+                  Contours *out)
+{
+    *out = (Contours) {0};
+    for (size_t k = 1; k < num_levels; ++k)
+    {
+        if (!(levels[k] > levels[k - 1]))
+        {
+            printf("error: contour levels must be ascending\n");
+            return false;
+        }
+    }
+    if (num_levels > CONTOUR_MAX_LEVELS)
+    {
+        printf("error: at most %d contour levels\n", CONTOUR_MAX_LEVELS);
+        return false;
+    }
+    if (grid->width < 2 || grid->height < 2)
+    {
+        printf("error: contouring needs a grid of at least 2 x 2\n");
+        return false;
+    }
+
+    /* One band per thread, but never less than a row of cells */
+    num_threads = num_threads ? num_threads : num_cores();
+    size_t num_bands = num_threads < grid->height - 1 ? num_threads : grid->height - 1;
+    ContourBuffer *bands = calloc(num_bands, sizeof(ContourBuffer));
+    ContourJob job = {grid, levels, num_levels, num_bands, bands};
+    parallel_for(num_threads, num_bands, contour_cells, &job);
+
+    /* Closed lines are done; open ones are pieces to join across bands */
+    ContourBuffer joined = {0}, open = {0};
+    for (size_t b = 0; b < num_bands; ++b)
+    {
+        ContourBuffer *band = &bands[b];
+        for (size_t l = 0; l < band->num_lines; ++l)
+        {
+            ContourBuffer *to = band->ends[2 * l] == CONTOUR_NONE ? &joined : &open;
+            contour_begin_line(to);
+            for (size_t i = band->starts[l]; i < band->starts[l + 1]; ++i)
+                contour_push_point(to, band->points[i]);
+            contour_end_line(to, band->ends[2 * l], band->ends[2 * l + 1], band->levels[l]);
+        }
+        delete_ContourBuffer(band);
+    }
+    free(bands);
+    ContourPieces pieces = {open.points, open.starts, open.ends, open.levels, open.num_lines};
+    contour_stitch(&pieces, &joined);
+    delete_ContourBuffer(&open);
+
+    free(joined.ends);
+    *out = (Contours) {joined.points, joined.num_points, joined.starts, joined.levels, joined.num_lines};
+    return true;
+}
+
+/* All the lines as one thick-line mesh, `width` thick, each line built by line() */
+Mesh contour_mesh(const Contours *contours, float width)
+{
+    size_t num_vertices = 0, num_indices = 0;
+    for (size_t l = 0; l < contours->num_lines; ++l)
+    {
+        size_t n = contours->starts[l + 1] - contours->starts[l];
+        num_vertices += 2 * n;
+        num_indices += 6 * (n - 1);
+    }
+    Mesh out = new_Mesh(num_vertices, num_indices);
+    size_t vertex = 0, index = 0;
+    for (size_t l = 0; l < contours->num_lines; ++l)
+    {
+        size_t n = contours->starts[l + 1] - contours->starts[l];
+        Mesh part = line(n, &contours->points[contours->starts[l]], width);
+        memcpy(&out.vertices[vertex], part.vertices, part.num_vertices * sizeof(vec3));
+        for (size_t i = 0; i < part.num_indices; ++i)
+            out.indices[index + i] = part.indices[i] + vertex;
+        vertex += part.num_vertices;
+        index += part.num_indices;
+        delete_Mesh(&part);
+    }
+    return out;
+}
+
+#endif
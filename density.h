@@ -0,0 +1,304 @@
+#ifndef DENSITY_H
+#define DENSITY_H
+
+#include <math.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "heatmap.h"
+#include "render.h"
+#include "sampler.h"
+#include "scale.h"
+
+/*
+ * Density plots on the GPU, the alternative to binning on the CPU.
+ *
+ * Series are drawn straight from their full-resolution points, as 1-pixel
+ * points or line strips, with additive blending into an R32F framebuffer, so
+ * each pixel ends up holding how many points or segments cover it. That is
+ * one draw per series and no CPU work per point; panning and zooming only
+ * change the `view` uniform, and switching axis scale (scale.h) only the
+ * `scale` one. Points a log scale cannot show get a clip distance so far
+ * below zero that segments to them are cut off at their other end. A second pass draws a full-screen quad that
+ * tone maps the counts, by log(1 + count) or by histogram equalisation of
+ * that, through the viridis colormap, leaving empty pixels alone.
+ *
+ * Both tone maps need statistics of the whole picture: the largest count,
+ * and for equalisation the distribution of counts. Rather than stall on a
+ * read, density_end() copies the counts into a pixel pack buffer and fences,
+ * and density_poll() maps it once the fence has passed, usually by the next
+ * frame. Each frame is therefore tone mapped with the previous frame's
+ * statistics, and the poll says when they moved enough to be worth a redraw.
+ */
+
+#define DENSITY_LEVELS 256
+/* Relative change in the statistics worth redrawing for */
+#define DENSITY_SETTLE 0.01f
+
+typedef enum DensityToneMap
+{
+    DENSITY_LOG,
+    DENSITY_EQ_HIST,
+} DensityToneMap;
+
+const char density_vertex_shader_source[] =
+    "#version 330 core\n"
+    "layout (location = 0) in vec3 aPos;\n"
+    "uniform vec4 view; /* x0, x1, y0, y1, scaled */\n"
+    "uniform ivec2 scale;\n"
+    "uniform vec2 threshold;\n"
+    "\n"
+    AXIS_SCALE_GLSL
+    "void main()\n"
+    "{\n"
+    "   bool shown = axis_valid(aPos.x, scale.x) && axis_valid(aPos.y, scale.y);\n"
+    "   vec2 s = vec2(axis_scale(aPos.x, scale.x, threshold.x), axis_scale(aPos.y, scale.y, threshold.y));\n"
+    "   vec2 ndc = 2.0 * (s - view.xz) / (view.yw - view.xz) - 1.0;\n"
+    "   gl_ClipDistance[0] = shown ? 1.0 : -1e30;\n"
+    "   gl_Position = vec4(shown ? ndc : vec2(0.0), 0.0, 1.0);\n"
+    "}\n\0";
+const char density_fragment_shader_source[] =
+    "#version 330 core\n"
+    "uniform float weight;\n"
+    "out vec4 FragColor;\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "    FragColor = vec4(weight, 0.0, 0.0, 0.0);\n"
+    "}\n\0";
+const char density_tone_shader_source[] =
+    "#version 330 core\n"
+    "uniform sampler2D density;\n"
+    "uniform sampler2D levels;\n"
+    "uniform float max_density;\n"
+    "uniform bool equalise;\n"
+    "in vec2 uv;\n"
+    "out vec4 FragColor;\n"
+    "\n"
+    VIRIDIS_GLSL
+    "void main()\n"
+    "{\n"
+    "    float count = texture(density, uv).r;\n"
+    "    if (count <= 0.0)\n"
+    "        discard;\n"
+    "    float t = clamp(log(1.0 + count) / log(1.0 + max(max_density, 1.0)), 0.0, 1.0);\n"
+    "    if (equalise)\n"
+    "    {\n"
+    "        float n = float(textureSize(levels, 0).x);\n"
+    "        t = texture(levels, vec2((t * (n - 1.0) + 0.5) / n, 0.5)).r;\n"
+    "    }\n"
+    "    FragColor = vec4(viridis(t), 1.0);\n"
+    "}\n\0";
+
+typedef struct Density
+{
+    uint tone;               /* tone mapping program; series bring their own */
+    uint FBO, counts, VAO;   /* counts: R32F texture */
+    uint levels;             /* DENSITY_LEVELS x 1 equalisation table */
+    uint PBO;
+    GLsync fence;
+    bool pending;
+    int width, height;       /* of `counts` */
+    int read_width, read_height;
+    int previous;            /* framebuffer bound before density_begin() */
+    float max;
+    float table[DENSITY_LEVELS];
+    DensityToneMap tone_map;
+} Density;
+
+void init_Density(Density *density, DensityToneMap tone_map)
+{
+    density->tone = setup_shader_program(heatmap_vertex_shader_source, density_tone_shader_source);
+
+    glGenFramebuffers(1, &density->FBO);
+    glGenVertexArrays(1, &density->VAO);
+    glGenBuffers(1, &density->PBO);
+    uint textures[2];
+    glGenTextures(2, textures);
+    density->counts = textures[0];
+    density->levels = textures[1];
+    for (size_t i = 0; i < 2; ++i)
+    {
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, i ? GL_LINEAR : GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, i ? GL_LINEAR : GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+
+    /* Until the first statistics arrive: counts up to 1, equalisation the identity */
+    density->max = 1;
+    for (size_t i = 0; i < DENSITY_LEVELS; ++i)
+        density->table[i] = (float) i / (DENSITY_LEVELS - 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, DENSITY_LEVELS, 1, 0, GL_RED, GL_FLOAT, density->table);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    density->pending = false;
+    density->width = density->height = 0;
+    density->tone_map = tone_map;
+}
+
+void delete_Density(Density *density)
+{
+    if (density->pending)
+        glDeleteSync(density->fence);
+    glDeleteBuffers(1, &density->PBO);
+    glDeleteTextures(2, (uint[]) {density->counts, density->levels});
+    glDeleteVertexArrays(1, &density->VAO);
+    glDeleteFramebuffers(1, &density->FBO);
+    glDeleteProgram(density->tone);
+}
+
+/* Binds the count framebuffer, (re)sized to the viewport's width x height, clears it and turns on additive blending */
+void density_begin(Density *density, int width, int height)
+{
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &density->previous);
+    glBindFramebuffer(GL_FRAMEBUFFER, density->FBO);
+    if (width != density->width || height != density->height)
+    {
+        density->width = width;
+        density->height = height;
+        glBindTexture(GL_TEXTURE_2D, density->counts);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, width, height, 0, GL_RED, GL_FLOAT, NULL);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, density->counts, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            printf("error: density framebuffer is incomplete\n");
+            exit(1);
+        }
+    }
+    glClearBufferfv(GL_COLOR, 0, (float[]) {0, 0, 0, 0});
+    glEnable(GL_BLEND);
+    glBlendEquation(GL_FUNC_ADD);
+    glBlendFunc(GL_ONE, GL_ONE);
+}
+
+/*
+ * Adds an object's vertices to the counts, as GL_POINTS or GL_LINE_STRIP
+ * over its whole vertex buffer, each fragment adding `weight`. The object
+ * must be set up with the density shaders; its mesh needs no indices.
+ */
+void density_draw(GameObject *rend, GLenum primitive, View view, Scale x, Scale y, float weight)
+{
+    glUseProgram(rend->program);
+    glUniform4f(glGetUniformLocation(rend->program, "view"), view.x0, view.x1, view.y0, view.y1);
+    glUniform2i(glGetUniformLocation(rend->program, "scale"), x.type, y.type);
+    glUniform2f(glGetUniformLocation(rend->program, "threshold"), x.threshold, y.threshold);
+    glUniform1f(glGetUniformLocation(rend->program, "weight"), weight);
+    glBindVertexArray(rend->VAO);
+    glEnable(GL_CLIP_DISTANCE0);
+    glDrawArrays(primitive, 0, rend->mesh.num_vertices);
+    glDisable(GL_CLIP_DISTANCE0);
+    glBindVertexArray(0);
+    glUseProgram(0);
+    rend->dirty = false;
+}
+
+/* Tone maps the counts into the framebuffer that was bound before density_begin(), then reads them back */
+void density_end(Density *density)
+{
+    glDisable(GL_BLEND);
+    glBindFramebuffer(GL_FRAMEBUFFER, density->previous);
+
+    glUseProgram(density->tone);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, density->counts);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, density->levels);
+    glUniform1i(glGetUniformLocation(density->tone, "density"), 0);
+    glUniform1i(glGetUniformLocation(density->tone, "levels"), 1);
+    glUniform1f(glGetUniformLocation(density->tone, "max_density"), density->max);
+    glUniform1i(glGetUniformLocation(density->tone, "equalise"), density->tone_map == DENSITY_EQ_HIST);
+    glBindVertexArray(density->VAO);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glUseProgram(0);
+
+    /* One read in flight at a time; a frame drawn meanwhile just goes without */
+    if (density->pending)
+        return;
+    density->read_width = density->width;
+    density->read_height = density->height;
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, density->FBO);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, density->PBO);
+    glBufferData(GL_PIXEL_PACK_BUFFER, (size_t) density->width * density->height * sizeof(float), NULL,
+                 GL_STREAM_READ);
+    glReadPixels(0, 0, density->width, density->height, GL_RED, GL_FLOAT, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, density->previous);
+    density->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    density->pending = true;
+}
+
+/*
+ * Without waiting: if the last read has arrived, updates the statistics from
+ * it and returns true if they changed by more than DENSITY_SETTLE, in which
+ * case the picture should be drawn again.
+ */
+bool density_poll(Density *density)
+{
+    if (!density->pending)
+        return false;
+    GLenum status = glClientWaitSync(density->fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+        return false;
+    glDeleteSync(density->fence);
+    density->pending = false;
+
+    size_t n = (size_t) density->read_width * density->read_height;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, density->PBO);
+    const float *counts = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, n * sizeof(float), GL_MAP_READ_BIT);
+    if (counts == NULL)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        return false;
+    }
+
+    float max = 0;
+    for (size_t i = 0; i < n; ++i)
+        max = counts[i] > max ? counts[i] : max;
+    max = max > 1 ? max : 1;
+
+    /* Equalisation: the cumulative share of covered pixels at each level of log(1 + count) */
+    size_t histogram[DENSITY_LEVELS] = {0}, covered = 0;
+    if (density->tone_map == DENSITY_EQ_HIST)
+    {
+        float scale = (DENSITY_LEVELS - 1) / logf(1 + max);
+        for (size_t i = 0; i < n; ++i)
+        {
+            if (counts[i] > 0)
+            {
+                size_t level = logf(1 + counts[i]) * scale;
+                ++histogram[level < DENSITY_LEVELS ? level : DENSITY_LEVELS - 1];
+                ++covered;
+            }
+        }
+    }
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    bool changed = fabsf(max - density->max) > DENSITY_SETTLE * density->max;
+    density->max = max;
+    if (density->tone_map == DENSITY_EQ_HIST && covered > 0)
+    {
+        size_t sum = 0;
+        for (size_t i = 0; i < DENSITY_LEVELS; ++i)
+        {
+            sum += histogram[i];
+            float level = (float) sum / covered;
+            changed = changed || fabsf(level - density->table[i]) > DENSITY_SETTLE;
+            density->table[i] = level;
+        }
+        glBindTexture(GL_TEXTURE_2D, density->levels);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, DENSITY_LEVELS, 1, GL_RED, GL_FLOAT, density->table);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    return changed;
+}
+
+#endif
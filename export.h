@@ -0,0 +1,347 @@
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "mathlib.h"
+#include "mesh.h"
+
+/*
+ * Vector export of a series as one SVG path or PDF content stream.
+ *
+ * Nothing is built in memory besides the simplified points: output goes
+ * through a fixed-size write buffer straight to the file. Points are first
+ * mapped to output units (pixels for SVG, points for PDF) and simplified at
+ * that resolution, so the tolerance means the same thing at any data scale:
+ *
+ * 1. Min/max decimation (downsample_into()) into one bucket per output
+ *    pixel column, which leaves the drawn line as it was and at most two
+ *    points per column whatever n is. This is O(n) and bounds the next two
+ *    passes by the output width.
+ * 2. Radial pass: drop points closer than the tolerance to the last kept one.
+ * 3. Ramer-Douglas-Peucker on what is left, with an explicit stack so long
+ *    series cannot overflow the call stack. It is O(m^2) at worst, as on a
+ *    sawtooth the radial pass cannot thin, which is why m must be small.
+ *
+ * Coordinates are quantised to 1/100 of a unit and printed as the shortest
+ * decimal at that precision ("12", "3.5", ".25", "-.5"), which is both much
+ * faster than printf and smaller on disk.
+ */
+
+#define WRITER_CAPACITY (1 << 16)
+
+typedef struct Writer
+{
+    FILE *file;
+    char buffer[WRITER_CAPACITY];
+    size_t size;
+    size_t bytes_written;
+} Writer;
+
+void writer_flush(Writer *w)
+{
+    fwrite(w->buffer, 1, w->size, w->file);
+    w->bytes_written += w->size;
+    w->size = 0;
+}
+
+void write_bytes(Writer *w, const char *bytes, size_t n)
+{
+    if (w->size + n > WRITER_CAPACITY)
+        writer_flush(w);
+    if (n > WRITER_CAPACITY)
+    {
+        fwrite(bytes, 1, n, w->file);
+        w->bytes_written += n;
+        return;
+    }
+    memcpy(&w->buffer[w->size], bytes, n);
+    w->size += n;
+}
+
+void write_str(Writer *w, const char *s)
+{
+    write_bytes(w, s, strlen(s));
+}
+
+/* Offset of the next byte in the file, for PDF cross references */
+size_t writer_offset(Writer *w)
+{
+    return w->bytes_written + w->size;
+}
+
+/* Writes a value stored in hundredths as the shortest decimal at that precision */
+void write_hundredths(Writer *w, int64_t q)
+{
+    char digits[24];
+    size_t n = 0;
+    if (q < 0)
+    {
+        digits[n++] = '-';
+        q = -q;
+    }
+    int64_t whole = q / 100;
+    int frac = q % 100;
+
+    if (whole != 0 || frac == 0)
+    {
+        char tmp[20];
+        size_t k = 0;
+        do
+        {
+            tmp[k++] = '0' + whole % 10;
+            whole /= 10;
+        } while (whole != 0);
+        while (k > 0)
+            digits[n++] = tmp[--k];
+    }
+    if (frac != 0)
+    {
+        digits[n++] = '.';
+        digits[n++] = '0' + frac / 10;
+        if (frac % 10 != 0)
+            digits[n++] = '0' + frac % 10;
+    }
+    write_bytes(w, digits, n);
+}
+
+void write_coord(Writer *w, float value)
+{
+    write_hundredths(w, llrintf(value * 100));
+}
+
+/* Squared distance from p to the segment ab */
+float segment_distance_sq(vec3 p, vec3 a, vec3 b)
+{
+    float dx = b.x - a.x, dy = b.y - a.y;
+    float len_sq = dx * dx + dy * dy;
+    float t = len_sq > 0 ? ((p.x - a.x) * dx + (p.y - a.y) * dy) / len_sq : 0;
+    t = clamp(t, 1, 0);
+    float ex = a.x + t * dx - p.x, ey = a.y + t * dy - p.y;
+    return ex * ex + ey * ey;
+}
+
+/*
+ * Maps the series into a width x height box (y down when flip_y is set) and
+ * simplifies it to `tolerance` output units. Returns the kept points.
+ */
+vec3 *simplify(size_t n, vec3 vertices[n], float width, float height, bool flip_y, float tolerance, size_t *out_n)
+{
+    float xmin = INFINITY, xmax = -INFINITY, ymin = INFINITY, ymax = -INFINITY;
+    for (size_t i = 0; i < n; ++i)
+    {
+        xmin = min(xmin, vertices[i].x);
+        xmax = max(xmax, vertices[i].x);
+        ymin = min(ymin, vertices[i].y);
+        ymax = max(ymax, vertices[i].y);
+    }
+    float sx = xmax > xmin ? width / (xmax - xmin) : 0;
+    float sy = ymax > ymin ? height / (ymax - ymin) : 0;
+
+    /* Min/max per column of the output, then the radial pass, mapping as we go */
+    size_t columns = tolerance > 0 ? ceil(width) : 0;
+    vec3 *points = malloc(downsample_capacity(n, columns) * sizeof(vec3));
+    size_t reduced = downsample_into(n, vertices, columns, points);
+    size_t m = 0;
+    float tol_sq = tolerance * tolerance;
+    for (size_t i = 0; i < reduced; ++i)
+    {
+        vec3 p = {(points[i].x - xmin) * sx, (points[i].y - ymin) * sy, 0};
+        if (flip_y)
+            p.y = height - p.y;
+        if (m > 0 && i + 1 < reduced && norm_sq(sub(p, points[m - 1])) < tol_sq)
+            continue;
+        points[m++] = p;
+    }
+
+    /* Douglas-Peucker */
+    if (m > 2)
+    {
+        bool *keep = calloc(m, sizeof(bool));
+        size_t *stack = malloc(2 * m * sizeof(size_t));
+        size_t top = 0;
+        keep[0] = keep[m - 1] = true;
+        stack[top++] = 0;
+        stack[top++] = m - 1;
+        while (top > 0)
+        {
+            size_t last = stack[--top];
+            size_t first = stack[--top];
+            float worst = 0;
+            size_t index = first;
+            for (size_t i = first + 1; i < last; ++i)
+            {
+                float d = segment_distance_sq(points[i], points[first], points[last]);
+                if (d > worst)
+                {
+                    worst = d;
+                    index = i;
+                }
+            }
+            if (worst > tol_sq)
+            {
+                keep[index] = true;
+                stack[top++] = first;
+                stack[top++] = index;
+                stack[top++] = index;
+                stack[top++] = last;
+            }
+        }
+
+        size_t k = 0;
+        for (size_t i = 0; i < m; ++i)
+            if (keep[i])
+                points[k++] = points[i];
+        m = k;
+        free(stack);
+        free(keep);
+    }
+
+    *out_n = m;
+    return points;
+}
+
+/*
+ * Relative path data, "M x y l dx dy dx dy ...". Deltas are taken between
+ * quantised absolute positions so rounding never accumulates along the path.
+ */
+void write_svg_path_data(Writer *w, size_t n, vec3 points[n])
+{
+    int64_t px = llrintf(points[0].x * 100), py = llrintf(points[0].y * 100);
+    write_str(w, "M");
+    write_hundredths(w, px);
+    write_str(w, " ");
+    write_hundredths(w, py);
+    write_str(w, "l");
+    for (size_t i = 1; i < n; ++i)
+    {
+        int64_t qx = llrintf(points[i].x * 100), qy = llrintf(points[i].y * 100);
+        if (i > 1)
+            write_str(w, " ");
+        write_hundredths(w, qx - px);
+        /* A minus sign already separates the pair */
+        if (qy - py >= 0)
+            write_str(w, " ");
+        write_hundredths(w, qy - py);
+        px = qx;
+        py = qy;
+    }
+}
+
+/* Returns the number of bytes written, or 0 on failure */
+size_t export_svg(const char *filename, size_t n, vec3 vertices[n], int width, int height, float tolerance)
+{
+    Writer *w = malloc(sizeof(Writer));
+    w->file = fopen(filename, "wb");
+    if (w->file == NULL)
+    {
+        printf("error: could not open %s for writing\n", filename);
+        free(w);
+        return 0;
+    }
+    w->size = 0;
+    w->bytes_written = 0;
+
+    char header[256];
+    snprintf(header, sizeof(header),
+             "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%d\" height=\"%d\" viewBox=\"0 0 %d %d\">\n"
+             "<rect width=\"100%%\" height=\"100%%\" fill=\"#334d4d\"/>\n",
+             width, height, width, height);
+    write_str(w, header);
+
+    if (n >= 2)
+    {
+        size_t m;
+        vec3 *points = simplify(n, vertices, width, height, true, tolerance, &m);
+        write_str(w, "<path fill=\"none\" stroke=\"#ff8033\" stroke-width=\"1.5\" stroke-linejoin=\"round\" d=\"");
+        write_svg_path_data(w, m, points);
+        write_str(w, "\"/>\n");
+        free(points);
+    }
+    write_str(w, "</svg>\n");
+
+    writer_flush(w);
+    size_t bytes = w->bytes_written;
+    fclose(w->file);
+    free(w);
+    return bytes;
+}
+
+/*
+ * Single-page PDF with an uncompressed content stream. The stream's length is
+ * an indirect object written after it, so the stream can go out in one pass.
+ */
+size_t export_pdf(const char *filename, size_t n, vec3 vertices[n], int width, int height, float tolerance)
+{
+    Writer *w = malloc(sizeof(Writer));
+    w->file = fopen(filename, "wb");
+    if (w->file == NULL)
+    {
+        printf("error: could not open %s for writing\n", filename);
+        free(w);
+        return 0;
+    }
+    w->size = 0;
+    w->bytes_written = 0;
+
+    char text[256];
+    size_t offsets[6];
+    write_str(w, "%PDF-1.4\n");
+    offsets[1] = writer_offset(w);
+    write_str(w, "1 0 obj\n<< /Type /Catalog /Pages 2 0 R >>\nendobj\n");
+    offsets[2] = writer_offset(w);
+    write_str(w, "2 0 obj\n<< /Type /Pages /Kids [3 0 R] /Count 1 >>\nendobj\n");
+    offsets[3] = writer_offset(w);
+    snprintf(text, sizeof(text),
+             "3 0 obj\n<< /Type /Page /Parent 2 0 R /MediaBox [0 0 %d %d] /Contents 4 0 R >>\nendobj\n",
+             width, height);
+    write_str(w, text);
+    offsets[4] = writer_offset(w);
+    write_str(w, "4 0 obj\n<< /Length 5 0 R >>\nstream\n");
+
+    size_t stream_start = writer_offset(w);
+    snprintf(text, sizeof(text), ".2 .302 .302 rg 0 0 %d %d re f\n1 .502 .2 RG 1.5 w 1 j\n", width, height);
+    write_str(w, text);
+    if (n >= 2)
+    {
+        size_t m;
+        vec3 *points = simplify(n, vertices, width, height, false, tolerance, &m);
+        for (size_t i = 0; i < m; ++i)
+        {
+            write_coord(w, points[i].x);
+            write_str(w, " ");
+            write_coord(w, points[i].y);
+            write_str(w, i == 0 ? " m\n" : " l\n");
+        }
+        write_str(w, "S\n");
+        free(points);
+    }
+    size_t stream_length = writer_offset(w) - stream_start;
+    write_str(w, "endstream\nendobj\n");
+
+    offsets[5] = writer_offset(w);
+    snprintf(text, sizeof(text), "5 0 obj\n%zu\nendobj\n", stream_length);
+    write_str(w, text);
+
+    size_t xref = writer_offset(w);
+    write_str(w, "xref\n0 6\n0000000000 65535 f \n");
+    for (size_t i = 1; i < 6; ++i)
+    {
+        snprintf(text, sizeof(text), "%010zu 00000 n \n", offsets[i]);
+        write_str(w, text);
+    }
+    snprintf(text, sizeof(text), "trailer\n<< /Size 6 /Root 1 0 R >>\nstartxref\n%zu\n%%%%EOF\n", xref);
+    write_str(w, text);
+
+    writer_flush(w);
+    size_t bytes = w->bytes_written;
+    fclose(w->file);
+    free(w);
+    return bytes;
+}
+
+#endif
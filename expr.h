@@ -0,0 +1,645 @@
+#ifndef EXPR_H
+#define EXPR_H
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mathlib.h"
+#include "threads.h"
+
+/*
+ * Formula plots: an expression such as "exp(-x^2) * sin(10*x)" is parsed
+ * once into a short register program, which is then run over blocks of
+ * EXPR_BLOCK points at a time, each instruction looping over the block in
+ * EXPR_LANES-wide GCC vectors. Dispatch costs one switch per instruction per
+ * block rather than per point, and the transcendental functions are vector
+ * polynomial approximations (about 1e-7 relative error for exp and log,
+ * 1e-7 absolute for sin and cos with moderate arguments) instead of per-lane
+ * libm calls. There is no JIT.
+ *
+ * Grammar, usual precedence, ^ binding tighter than unary minus and to the
+ * right:
+ *
+ *     numbers, x, y, pi, e, + - * / ^ ( ),
+ *     exp log ln log10 sqrt sin cos tan tanh abs
+ *
+ * `y` is the y of an existing series, for derived series such as "log(y)".
+ * Constant subexpressions are folded at compile time, x^n for small integer
+ * n becomes repeated multiplication, and registers are reused once their
+ * value is dead so the working set of a block stays in L1.
+ *
+ * expr_function() evaluates one point in double precision with libm, for the
+ * adaptive sampler; the block evaluators are for whole series.
+ */
+
+#define EXPR_LANES 16
+#define EXPR_BLOCK 256
+#define EXPR_MAX_CODE 128
+
+typedef float expr_f __attribute__((vector_size(EXPR_LANES * sizeof(float))));
+typedef int32_t expr_i __attribute__((vector_size(EXPR_LANES * sizeof(int32_t))));
+
+typedef enum ExprOp
+{
+    EXPR_CONST,
+    EXPR_X,
+    EXPR_Y,
+    EXPR_ADD,
+    EXPR_SUB,
+    EXPR_MUL,
+    EXPR_DIV,
+    EXPR_NEG,
+    EXPR_POW,
+    EXPR_POWI,
+    EXPR_EXP,
+    EXPR_LOG,
+    EXPR_LOG10,
+    EXPR_SQRT,
+    EXPR_SIN,
+    EXPR_COS,
+    EXPR_TAN,
+    EXPR_TANH,
+    EXPR_ABS,
+} ExprOp;
+
+typedef struct ExprInstr
+{
+    ExprOp op;
+    uint8_t dst, a, b;
+    double value; /* EXPR_CONST: the constant, EXPR_POWI: the exponent */
+} ExprInstr;
+
+typedef struct Expr
+{
+    ExprInstr code[EXPR_MAX_CODE];
+    size_t length;
+    size_t num_registers;
+    bool uses_y;
+} Expr;
+
+/* Parsing: emits one instruction per node, its position being its value until registers are assigned */
+
+typedef struct ExprParser
+{
+    const char *source, *at;
+    Expr *expr;
+    bool failed;
+} ExprParser;
+
+void expr_fail(ExprParser *parser, const char *message)
+{
+    if (!parser->failed)
+        printf("error: %s at column %zu in \"%s\"\n", message, (size_t) (parser->at - parser->source) + 1,
+               parser->source);
+    parser->failed = true;
+}
+
+size_t expr_emit(ExprParser *parser, ExprOp op, size_t a, size_t b, double value)
+{
+    Expr *expr = parser->expr;
+    if (expr->length == EXPR_MAX_CODE)
+    {
+        expr_fail(parser, "expression too long");
+        return 0;
+    }
+    expr->code[expr->length] = (ExprInstr) {op, 0, a, b, value};
+    return expr->length++;
+}
+
+void expr_skip_space(ExprParser *parser)
+{
+    while (*parser->at == ' ' || *parser->at == '\t')
+        ++parser->at;
+}
+
+bool expr_accept(ExprParser *parser, char c)
+{
+    expr_skip_space(parser);
+    if (*parser->at != c)
+        return false;
+    ++parser->at;
+    return true;
+}
+
+size_t expr_parse_sum(ExprParser *parser);
+size_t expr_parse_unary(ExprParser *parser);
+
+typedef struct ExprName
+{
+    const char *name;
+    ExprOp op;
+} ExprName;
+
+ExprName expr_functions[] = {
+    {"exp", EXPR_EXP}, {"log", EXPR_LOG}, {"ln", EXPR_LOG}, {"log10", EXPR_LOG10}, {"sqrt", EXPR_SQRT},
+    {"sin", EXPR_SIN}, {"cos", EXPR_COS}, {"tan", EXPR_TAN}, {"tanh", EXPR_TANH}, {"abs", EXPR_ABS},
+};
+
+size_t expr_parse_primary(ExprParser *parser)
+{
+    expr_skip_space(parser);
+    const char *start = parser->at;
+    if ((*start >= '0' && *start <= '9') || *start == '.')
+    {
+        char *end;
+        double value = strtod(start, &end);
+        parser->at = end;
+        return expr_emit(parser, EXPR_CONST, 0, 0, value);
+    }
+    if (expr_accept(parser, '('))
+    {
+        size_t inner = expr_parse_sum(parser);
+        if (!expr_accept(parser, ')'))
+            expr_fail(parser, "expected ')'");
+        return inner;
+    }
+
+    size_t length = 0;
+    while ((start[length] >= 'a' && start[length] <= 'z') || (start[length] >= '0' && start[length] <= '9' && length))
+        ++length;
+    parser->at += length;
+    if (length == 1 && *start == 'x')
+        return expr_emit(parser, EXPR_X, 0, 0, 0);
+    if (length == 1 && *start == 'y')
+    {
+        parser->expr->uses_y = true;
+        return expr_emit(parser, EXPR_Y, 0, 0, 0);
+    }
+    if (length == 1 && *start == 'e')
+        return expr_emit(parser, EXPR_CONST, 0, 0, M_E);
+    if (length == 2 && strncmp(start, "pi", 2) == 0)
+        return expr_emit(parser, EXPR_CONST, 0, 0, M_PI);
+    for (size_t i = 0; i < sizeof(expr_functions) / sizeof(expr_functions[0]); ++i)
+    {
+        if (strlen(expr_functions[i].name) == length && strncmp(start, expr_functions[i].name, length) == 0)
+        {
+            if (!expr_accept(parser, '('))
+                expr_fail(parser, "expected '(' after function name");
+            size_t argument = expr_parse_sum(parser);
+            if (!expr_accept(parser, ')'))
+                expr_fail(parser, "expected ')'");
+            return expr_emit(parser, expr_functions[i].op, argument, 0, 0);
+        }
+    }
+    parser->at = start;
+    expr_fail(parser, length ? "unknown name" : "expected a number, variable or '('");
+    return 0;
+}
+
+size_t expr_parse_power(ExprParser *parser)
+{
+    size_t base = expr_parse_primary(parser);
+    if (!expr_accept(parser, '^'))
+        return base;
+    size_t exponent = expr_parse_unary(parser);
+    return expr_emit(parser, EXPR_POW, base, exponent, 0);
+}
+
+size_t expr_parse_unary(ExprParser *parser)
+{
+    if (expr_accept(parser, '-'))
+        return expr_emit(parser, EXPR_NEG, expr_parse_unary(parser), 0, 0);
+    if (expr_accept(parser, '+'))
+        return expr_parse_unary(parser);
+    return expr_parse_power(parser);
+}
+
+size_t expr_parse_product(ExprParser *parser)
+{
+    size_t left = expr_parse_unary(parser);
+    while (!parser->failed)
+    {
+        if (expr_accept(parser, '*'))
+            left = expr_emit(parser, EXPR_MUL, left, expr_parse_unary(parser), 0);
+        else if (expr_accept(parser, '/'))
+            left = expr_emit(parser, EXPR_DIV, left, expr_parse_unary(parser), 0);
+        else
+            break;
+    }
+    return left;
+}
+
+size_t expr_parse_sum(ExprParser *parser)
+{
+    size_t left = expr_parse_product(parser);
+    while (!parser->failed)
+    {
+        if (expr_accept(parser, '+'))
+            left = expr_emit(parser, EXPR_ADD, left, expr_parse_product(parser), 0);
+        else if (expr_accept(parser, '-'))
+            left = expr_emit(parser, EXPR_SUB, left, expr_parse_product(parser), 0);
+        else
+            break;
+    }
+    return left;
+}
+
+/* Scalar evaluation */
+
+bool expr_unary(ExprOp op)
+{
+    return op >= EXPR_NEG && op != EXPR_POW;
+}
+
+bool expr_binary(ExprOp op)
+{
+    return (op >= EXPR_ADD && op <= EXPR_DIV) || op == EXPR_POW;
+}
+
+double expr_apply(ExprOp op, double a, double b, double value)
+{
+    switch (op)
+    {
+    case EXPR_ADD: return a + b;
+    case EXPR_SUB: return a - b;
+    case EXPR_MUL: return a * b;
+    case EXPR_DIV: return a / b;
+    case EXPR_NEG: return -a;
+    case EXPR_POW: return pow(a, b);
+    case EXPR_POWI: return pow(a, value);
+    case EXPR_EXP: return exp(a);
+    case EXPR_LOG: return log(a);
+    case EXPR_LOG10: return log10(a);
+    case EXPR_SQRT: return sqrt(a);
+    case EXPR_SIN: return sin(a);
+    case EXPR_COS: return cos(a);
+    case EXPR_TAN: return tan(a);
+    case EXPR_TANH: return tanh(a);
+    case EXPR_ABS: return fabs(a);
+    default: return value;
+    }
+}
+
+/* f(x) in double precision with libm; matches PlotFunction, with `ctx` the Expr */
+double expr_function(void *ctx, double x)
+{
+    const Expr *expr = ctx;
+    double regs[EXPR_MAX_CODE];
+    for (size_t i = 0; i < expr->length; ++i)
+    {
+        const ExprInstr *in = &expr->code[i];
+        regs[in->dst] = in->op == EXPR_X ? x : in->op == EXPR_Y ? NAN
+                                         : expr_apply(in->op, regs[in->a], regs[in->b], in->value);
+    }
+    return regs[expr->code[expr->length - 1].dst];
+}
+
+/* Compilation */
+
+/* Folds constants and strength-reduces powers; operands still refer to instruction positions */
+void expr_simplify(Expr *expr)
+{
+    for (size_t i = 0; i < expr->length; ++i)
+    {
+        ExprInstr *in = &expr->code[i];
+        bool a_const = expr->code[in->a].op == EXPR_CONST, b_const = expr->code[in->b].op == EXPR_CONST;
+        if ((expr_unary(in->op) && a_const) || (expr_binary(in->op) && a_const && b_const))
+        {
+            in->value = expr_apply(in->op, expr->code[in->a].value, expr->code[in->b].value, in->value);
+            in->op = EXPR_CONST;
+        }
+        else if (in->op == EXPR_POW && b_const)
+        {
+            double n = expr->code[in->b].value;
+            if (n == rint(n) && fabs(n) <= 16)
+            {
+                in->op = EXPR_POWI;
+                in->value = n;
+            }
+        }
+    }
+}
+
+/*
+ * Drops instructions the result does not depend on (left behind by folding)
+ * and gives the rest registers, reusing those whose value is dead. Constants
+ * get registers of their own up front, since they are only written once per
+ * thread.
+ */
+void expr_allocate(Expr *expr)
+{
+    bool live[EXPR_MAX_CODE] = {false};
+    live[expr->length - 1] = true;
+    for (size_t i = expr->length; i-- > 0;)
+    {
+        const ExprInstr *in = &expr->code[i];
+        if (live[i] && (expr_unary(in->op) || expr_binary(in->op)))
+            live[in->a] = true;
+        if (live[i] && expr_binary(in->op))
+            live[in->b] = true;
+    }
+    size_t position[EXPR_MAX_CODE], length = 0;
+    for (size_t i = 0; i < expr->length; ++i)
+    {
+        if (!live[i])
+            continue;
+        /* Operands that are not used point at the first instruction, so they are always valid registers */
+        ExprInstr in = expr->code[i];
+        in.a = expr_unary(in.op) || expr_binary(in.op) ? position[in.a] : 0;
+        in.b = expr_binary(in.op) ? position[in.b] : 0;
+        position[i] = length;
+        expr->code[length++] = in;
+    }
+    expr->length = length;
+
+    size_t last_use[EXPR_MAX_CODE];
+    for (size_t i = 0; i < length; ++i)
+    {
+        const ExprInstr *in = &expr->code[i];
+        last_use[i] = in->op == EXPR_CONST ? EXPR_MAX_CODE : i;
+        if ((expr_unary(in->op) || expr_binary(in->op)) && last_use[in->a] != EXPR_MAX_CODE)
+            last_use[in->a] = i;
+        if (expr_binary(in->op) && last_use[in->b] != EXPR_MAX_CODE)
+            last_use[in->b] = i;
+    }
+
+    uint8_t assigned[EXPR_MAX_CODE];
+    bool busy[EXPR_MAX_CODE] = {false};
+    expr->num_registers = 0;
+    for (size_t i = 0; i < length; ++i)
+        if (expr->code[i].op == EXPR_CONST)
+            busy[assigned[i] = expr->code[i].dst = expr->num_registers++] = true;
+    for (size_t i = 0; i < length; ++i)
+    {
+        ExprInstr *in = &expr->code[i];
+        if (in->op == EXPR_CONST)
+            continue;
+        if (expr_unary(in->op) || expr_binary(in->op))
+            in->a = assigned[in->a];
+        if (expr_binary(in->op))
+            in->b = assigned[in->b];
+
+        /* Operands dying here free their registers, which the result may then take */
+        for (size_t j = 0; j < i; ++j)
+            if (last_use[j] == i)
+                busy[assigned[j]] = false;
+        size_t r = 0;
+        while (busy[r])
+            ++r;
+        busy[r] = true;
+        assigned[i] = in->dst = r;
+        if (r + 1 > expr->num_registers)
+            expr->num_registers = r + 1;
+    }
+}
+
+/* Parses and compiles `source`; prints the problem and returns false if it is not a valid formula */
+bool compile_expr(Expr *expr, const char *source)
+{
+    memset(expr, 0, sizeof(Expr));
+    ExprParser parser = {source, source, expr, false};
+    expr_parse_sum(&parser);
+    expr_skip_space(&parser);
+    if (!parser.failed && *parser.at != '\0')
+        expr_fail(&parser, "unexpected character");
+    if (parser.failed)
+        return false;
+    expr_simplify(expr);
+    expr_allocate(expr);
+    return true;
+}
+
+/*
+ * Vector maths. Each function fills a whole block; vectors are never passed
+ * by value, as 64-byte vector arguments change the ABI without AVX-512.
+ */
+
+#define EXPR_VECTORS (EXPR_BLOCK / EXPR_LANES)
+#define EXPR_SPLAT(v) ((expr_f) {} + (v))
+#define EXPR_SELECT(mask, a, b) ((expr_f) (((mask) & (expr_i) (a)) | (~(mask) & (expr_i) (b))))
+/* Round to nearest by the 1.5 * 2^23 trick; exact for |v| < 2^22 */
+#define EXPR_ROUND(v) (((v) + 12582912.0f) - 12582912.0f)
+
+void expr_exp(expr_f *dst, const expr_f *a)
+{
+    for (size_t k = 0; k < EXPR_VECTORS; ++k)
+    {
+        expr_f v = a[k];
+        v = EXPR_SELECT(v > 88.7f, EXPR_SPLAT(88.7f), v);
+        v = EXPR_SELECT(v < -87.3f, EXPR_SPLAT(-87.3f), v);
+        expr_f n = EXPR_ROUND(v * 1.44269504f);
+        expr_f r = v - n * 0.693145752f - n * 1.42860677e-6f;
+        expr_f p = 1.98756912e-4f * r + 1.39819994e-3f;
+        p = p * r + 8.33345205e-3f;
+        p = p * r + 4.16657962e-2f;
+        p = p * r + 1.66666657e-1f;
+        p = p * r + 0.5f;
+        p = 1 + r + r * r * p;
+        expr_i scale = (__builtin_convertvector(n, expr_i) + 127) << 23;
+        dst[k] = EXPR_SELECT(a[k] != a[k], a[k], p * (expr_f) scale);
+    }
+}
+
+void expr_log(expr_f *dst, const expr_f *a)
+{
+    for (size_t k = 0; k < EXPR_VECTORS; ++k)
+    {
+        expr_f v = a[k];
+        expr_i bits = (expr_i) v;
+        expr_i exponent = ((bits >> 23) & 0xff) - 127;
+        expr_f m = (expr_f) ((bits & 0x007fffff) | 0x3f800000); /* [1, 2) */
+        expr_i big = m > 1.41421356f;
+        m = EXPR_SELECT(big, m * 0.5f, m);
+        expr_f e = __builtin_convertvector(exponent - big, expr_f);
+
+        expr_f t = (m - 1) / (m + 1), t2 = t * t;
+        expr_f s = 1.0f / 9 + t2 * (1.0f / 11);
+        s = 1.0f / 7 + t2 * s;
+        s = 1.0f / 5 + t2 * s;
+        s = 1.0f / 3 + t2 * s;
+        s = 1 + t2 * s;
+        expr_f result = e * 0.693147181f + 2 * t * s;
+
+        result = EXPR_SELECT(v == 0, EXPR_SPLAT(-INFINITY), result);
+        result = EXPR_SELECT((v < 0) | (v != v), EXPR_SPLAT(NAN), result);
+        dst[k] = EXPR_SELECT(v == INFINITY, v, result);
+    }
+}
+
+/* sin, or cos with `cosine` 1: polynomials on the argument reduced by pi/2, picked by quadrant */
+void expr_sincos(expr_f *dst, const expr_f *a, int cosine)
+{
+    for (size_t k = 0; k < EXPR_VECTORS; ++k)
+    {
+        expr_f q = EXPR_ROUND(a[k] * 0.636619772f);
+        expr_f r = a[k] - q * 1.5703125f - q * 4.83751297e-4f - q * 7.54978995e-8f;
+        expr_f r2 = r * r;
+        expr_f s = -1.95152959e-4f * r2 + 8.33216087e-3f;
+        s = s * r2 - 1.66666546e-1f;
+        s = r + s * r2 * r;
+        expr_f c = 2.44331571e-5f * r2 - 1.38873163e-3f;
+        c = c * r2 + 4.16666457e-2f;
+        c = 1 - 0.5f * r2 + c * r2 * r2;
+        expr_i quadrant = __builtin_convertvector(q, expr_i) + cosine;
+        expr_f result = EXPR_SELECT((quadrant & 1) != 0, c, s);
+        dst[k] = EXPR_SELECT((quadrant & 2) != 0, -result, result);
+    }
+}
+
+/* One instruction over a block; dst may be a or b */
+void expr_run(const ExprInstr *in, expr_f *dst, const expr_f *a, const expr_f *b)
+{
+    const expr_i sign = (expr_i) {} + INT32_MIN;
+    expr_f t[EXPR_VECTORS], u[EXPR_VECTORS];
+    switch (in->op)
+    {
+    case EXPR_ADD: for (size_t k = 0; k < EXPR_VECTORS; ++k) dst[k] = a[k] + b[k]; break;
+    case EXPR_SUB: for (size_t k = 0; k < EXPR_VECTORS; ++k) dst[k] = a[k] - b[k]; break;
+    case EXPR_MUL: for (size_t k = 0; k < EXPR_VECTORS; ++k) dst[k] = a[k] * b[k]; break;
+    case EXPR_DIV: for (size_t k = 0; k < EXPR_VECTORS; ++k) dst[k] = a[k] / b[k]; break;
+    case EXPR_NEG: for (size_t k = 0; k < EXPR_VECTORS; ++k) dst[k] = -a[k]; break;
+    case EXPR_ABS: for (size_t k = 0; k < EXPR_VECTORS; ++k) dst[k] = (expr_f) ((expr_i) a[k] & ~sign); break;
+    case EXPR_EXP: expr_exp(dst, a); break;
+    case EXPR_LOG: expr_log(dst, a); break;
+    case EXPR_LOG10:
+        expr_log(dst, a);
+        for (size_t k = 0; k < EXPR_VECTORS; ++k)
+            dst[k] *= 0.434294482f;
+        break;
+    case EXPR_SIN: expr_sincos(dst, a, 0); break;
+    case EXPR_COS: expr_sincos(dst, a, 1); break;
+    case EXPR_TAN:
+        expr_sincos(t, a, 0);
+        expr_sincos(u, a, 1);
+        for (size_t k = 0; k < EXPR_VECTORS; ++k)
+            dst[k] = t[k] / u[k];
+        break;
+    case EXPR_TANH:
+        /* sign(x) (1 - e^-2|x|) / (1 + e^-2|x|) */
+        for (size_t k = 0; k < EXPR_VECTORS; ++k)
+            t[k] = -2 * (expr_f) ((expr_i) a[k] & ~sign);
+        expr_exp(t, t);
+        for (size_t k = 0; k < EXPR_VECTORS; ++k)
+            dst[k] = (expr_f) ((expr_i) ((1 - t[k]) / (1 + t[k])) | ((expr_i) a[k] & sign));
+        break;
+    case EXPR_POW:
+        expr_log(t, a);
+        for (size_t k = 0; k < EXPR_VECTORS; ++k)
+            t[k] *= b[k];
+        expr_exp(dst, t);
+        break;
+    case EXPR_POWI:
+    {
+        unsigned n = fabs(in->value);
+        for (size_t k = 0; k < EXPR_VECTORS; ++k)
+        {
+            expr_f base = a[k], result = EXPR_SPLAT(1);
+            for (unsigned e = n; e; e >>= 1, base *= base)
+                if (e & 1)
+                    result *= base;
+            dst[k] = in->value < 0 ? 1 / result : result;
+        }
+        break;
+    }
+    case EXPR_SQRT:
+        for (size_t k = 0; k < EXPR_VECTORS; ++k)
+            for (size_t l = 0; l < EXPR_LANES; ++l)
+                dst[k][l] = sqrtf(a[k][l]);
+        break;
+    default:
+        break;
+    }
+}
+
+/* Block evaluation */
+
+typedef struct ExprJob
+{
+    const Expr *expr;
+    size_t n;
+    const float *x, *y; /* SoA input, or NULL */
+    float *out;         /* SoA output, or NULL */
+    vec3 *points;       /* interleaved output, or NULL */
+    bool derive;        /* take x and y from `points` */
+    double x0, dx;      /* otherwise x = x0 + i * dx when x is NULL */
+} ExprJob;
+
+void expr_evaluate(void *ctx, size_t thread, size_t begin, size_t end)
+{
+    ExprJob *job = ctx;
+    const Expr *expr = job->expr;
+    expr_f *regs = aligned_alloc(sizeof(expr_f), expr->num_registers * sizeof(expr_f[EXPR_VECTORS]));
+    expr_f xs[EXPR_VECTORS] = {}, ys[EXPR_VECTORS] = {};
+    float *x = (float *) xs, *y = (float *) ys;
+    const float *result = (const float *) &regs[expr->code[expr->length - 1].dst * EXPR_VECTORS];
+
+    /* Constants never change, so they are broadcast once */
+    for (size_t i = 0; i < expr->length; ++i)
+        if (expr->code[i].op == EXPR_CONST)
+            for (size_t k = 0; k < EXPR_VECTORS; ++k)
+                regs[expr->code[i].dst * EXPR_VECTORS + k] = EXPR_SPLAT((float) expr->code[i].value);
+
+    for (size_t base = begin; base < end; base += EXPR_BLOCK)
+    {
+        /* A short last block leaves stale lanes, which are computed and dropped */
+        size_t count = end - base < EXPR_BLOCK ? end - base : EXPR_BLOCK;
+        if (job->derive)
+        {
+            for (size_t l = 0; l < count; ++l)
+            {
+                x[l] = job->points[base + l].x;
+                y[l] = job->points[base + l].y;
+            }
+        }
+        else if (job->x != NULL)
+        {
+            memcpy(x, &job->x[base], count * sizeof(float));
+            if (job->y != NULL)
+                memcpy(y, &job->y[base], count * sizeof(float));
+        }
+        else
+        {
+            /* Offsets within the block are small, so float steps from a double start lose nothing visible */
+            float start = job->x0 + base * job->dx, step = job->dx;
+            for (size_t l = 0; l < EXPR_BLOCK; ++l)
+                x[l] = start + l * step;
+        }
+
+        for (size_t i = 0; i < expr->length; ++i)
+        {
+            const ExprInstr *in = &expr->code[i];
+            expr_f *dst = &regs[in->dst * EXPR_VECTORS];
+            if (in->op == EXPR_X)
+                memcpy(dst, xs, sizeof(xs));
+            else if (in->op == EXPR_Y)
+                memcpy(dst, ys, sizeof(ys));
+            else if (in->op != EXPR_CONST)
+                expr_run(in, dst, &regs[in->a * EXPR_VECTORS], &regs[in->b * EXPR_VECTORS]);
+        }
+
+        if (job->out != NULL)
+            memcpy(&job->out[base], result, count * sizeof(float));
+        else
+            for (size_t l = 0; l < count; ++l)
+                job->points[base + l] = (vec3) {x[l], result[l], 0};
+    }
+    free(regs);
+}
+
+/* out[i] = f(x[i], y[i]) over SoA arrays; y may be NULL if the formula does not use it */
+void expr_eval(const Expr *expr, size_t n, const float *x, const float *y, float *out, size_t num_threads)
+{
+    ExprJob job = {expr, n, x, y, out, NULL, false, 0, 0};
+    parallel_for(num_threads ? num_threads : num_cores(), n, expr_evaluate, &job);
+}
+
+/* n points of y = f(x) evenly spaced over [x0, x1], ready for the mesh builders (malloc'd) */
+vec3 *expr_sample(const Expr *expr, double x0, double x1, size_t n, size_t num_threads)
+{
+    vec3 *points = malloc(n * sizeof(vec3));
+    ExprJob job = {expr, n, NULL, NULL, NULL, points, false, x0, n > 1 ? (x1 - x0) / (n - 1) : 0};
+    parallel_for(num_threads ? num_threads : num_cores(), n, expr_evaluate, &job);
+    return points;
+}
+
+/* Derived series: replaces each point's y with f(x, y), in place */
+void expr_derive(const Expr *expr, size_t n, vec3 points[n], size_t num_threads)
+{
+    ExprJob job = {expr, n, NULL, NULL, NULL, points, true, 0, 0};
+    parallel_for(num_threads ? num_threads : num_cores(), n, expr_evaluate, &job);
+}
+
+#endif
@@ -0,0 +1,234 @@
+#ifndef FONT_H
+#define FONT_H
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Text for axis labels: a built-in 5x7 bitmap font for printable ASCII,
+ * rasterised once into an atlas of 8x8 cells, and batches of glyph
+ * instances laid out on the CPU, each a quad to be drawn in one instanced
+ * call. Laying out into a batch that has seen as many glyphs before does
+ * not allocate, so labels can be rebuilt every frame; text_addf() formats
+ * on the stack.
+ *
+ * Positions are in pixels from the top left of the viewport. Characters
+ * outside printable ASCII come out as '?'.
+ */
+
+#define FONT_FIRST 32
+#define FONT_GLYPHS 95
+#define FONT_WIDTH 5
+#define FONT_HEIGHT 7
+#define FONT_CELL 8
+#define FONT_ADVANCE 6
+#define FONT_COLUMNS 16
+#define FONT_ATLAS_WIDTH (FONT_COLUMNS * FONT_CELL)
+#define FONT_ATLAS_HEIGHT ((FONT_GLYPHS + FONT_COLUMNS - 1) / FONT_COLUMNS * FONT_CELL)
+/* Longest label text_addf() formats */
+#define TEXT_MAX_LABEL 64
+
+/* Rows top to bottom, the leftmost pixel in bit 4 */
+static const uint8_t font_5x7[FONT_GLYPHS][FONT_HEIGHT] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, /* ' ' */
+    {0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04}, /* '!' */
+    {0x0a, 0x0a, 0x0a, 0x00, 0x00, 0x00, 0x00}, /* '"' */
+    {0x0a, 0x0a, 0x1f, 0x0a, 0x1f, 0x0a, 0x0a}, /* '#' */
+    {0x04, 0x0f, 0x14, 0x0e, 0x05, 0x1e, 0x04}, /* '$' */
+    {0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03}, /* '%' */
+    {0x0c, 0x12, 0x14, 0x08, 0x15, 0x12, 0x0d}, /* '&' */
+    {0x04, 0x04, 0x08, 0x00, 0x00, 0x00, 0x00}, /* '\'' */
+    {0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02}, /* '(' */
+    {0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08}, /* ')' */
+    {0x00, 0x04, 0x15, 0x0e, 0x15, 0x04, 0x00}, /* '*' */
+    {0x00, 0x04, 0x04, 0x1f, 0x04, 0x04, 0x00}, /* '+' */
+    {0x00, 0x00, 0x00, 0x00, 0x0c, 0x04, 0x08}, /* ',' */
+    {0x00, 0x00, 0x00, 0x1f, 0x00, 0x00, 0x00}, /* '-' */
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x0c}, /* '.' */
+    {0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00}, /* '/' */
+    {0x0e, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0e}, /* '0' */
+    {0x04, 0x0c, 0x04, 0x04, 0x04, 0x04, 0x0e}, /* '1' */
+    {0x0e, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1f}, /* '2' */
+    {0x1f, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0e}, /* '3' */
+    {0x02, 0x06, 0x0a, 0x12, 0x1f, 0x02, 0x02}, /* '4' */
+    {0x1f, 0x10, 0x1e, 0x01, 0x01, 0x11, 0x0e}, /* '5' */
+    {0x06, 0x08, 0x10, 0x1e, 0x11, 0x11, 0x0e}, /* '6' */
+    {0x1f, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08}, /* '7' */
+    {0x0e, 0x11, 0x11, 0x0e, 0x11, 0x11, 0x0e}, /* '8' */
+    {0x0e, 0x11, 0x11, 0x0f, 0x01, 0x02, 0x0c}, /* '9' */
+    {0x00, 0x0c, 0x0c, 0x00, 0x0c, 0x0c, 0x00}, /* ':' */
+    {0x00, 0x0c, 0x0c, 0x00, 0x0c, 0x04, 0x08}, /* ';' */
+    {0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02}, /* '<' */
+    {0x00, 0x00, 0x1f, 0x00, 0x1f, 0x00, 0x00}, /* '=' */
+    {0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08}, /* '>' */
+    {0x0e, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04}, /* '?' */
+    {0x0e, 0x11, 0x01, 0x0d, 0x15, 0x15, 0x0e}, /* '@' */
+    {0x0e, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11}, /* 'A' */
+    {0x1e, 0x11, 0x11, 0x1e, 0x11, 0x11, 0x1e}, /* 'B' */
+    {0x0e, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0e}, /* 'C' */
+    {0x1c, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1c}, /* 'D' */
+    {0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x1f}, /* 'E' */
+    {0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x10}, /* 'F' */
+    {0x0e, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0f}, /* 'G' */
+    {0x11, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11}, /* 'H' */
+    {0x0e, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0e}, /* 'I' */
+    {0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0c}, /* 'J' */
+    {0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11}, /* 'K' */
+    {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1f}, /* 'L' */
+    {0x11, 0x1b, 0x15, 0x15, 0x11, 0x11, 0x11}, /* 'M' */
+    {0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11}, /* 'N' */
+    {0x0e, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e}, /* 'O' */
+    {0x1e, 0x11, 0x11, 0x1e, 0x10, 0x10, 0x10}, /* 'P' */
+    {0x0e, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0d}, /* 'Q' */
+    {0x1e, 0x11, 0x11, 0x1e, 0x14, 0x12, 0x11}, /* 'R' */
+    {0x0f, 0x10, 0x10, 0x0e, 0x01, 0x01, 0x1e}, /* 'S' */
+    {0x1f, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04}, /* 'T' */
+    {0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e}, /* 'U' */
+    {0x11, 0x11, 0x11, 0x11, 0x11, 0x0a, 0x04}, /* 'V' */
+    {0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0a}, /* 'W' */
+    {0x11, 0x11, 0x0a, 0x04, 0x0a, 0x11, 0x11}, /* 'X' */
+    {0x11, 0x11, 0x0a, 0x04, 0x04, 0x04, 0x04}, /* 'Y' */
+    {0x1f, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1f}, /* 'Z' */
+    {0x0e, 0x08, 0x08, 0x08, 0x08, 0x08, 0x0e}, /* '[' */
+    {0x00, 0x10, 0x08, 0x04, 0x02, 0x01, 0x00}, /* '\\' */
+    {0x0e, 0x02, 0x02, 0x02, 0x02, 0x02, 0x0e}, /* ']' */
+    {0x04, 0x0a, 0x11, 0x00, 0x00, 0x00, 0x00}, /* '^' */
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1f}, /* '_' */
+    {0x08, 0x04, 0x02, 0x00, 0x00, 0x00, 0x00}, /* '`' */
+    {0x00, 0x00, 0x0e, 0x01, 0x0f, 0x11, 0x0f}, /* 'a' */
+    {0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x1e}, /* 'b' */
+    {0x00, 0x00, 0x0e, 0x10, 0x10, 0x11, 0x0e}, /* 'c' */
+    {0x01, 0x01, 0x0d, 0x13, 0x11, 0x11, 0x0f}, /* 'd' */
+    {0x00, 0x00, 0x0e, 0x11, 0x1f, 0x10, 0x0e}, /* 'e' */
+    {0x06, 0x09, 0x08, 0x1c, 0x08, 0x08, 0x08}, /* 'f' */
+    {0x00, 0x0f, 0x11, 0x11, 0x0f, 0x01, 0x0e}, /* 'g' */
+    {0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x11}, /* 'h' */
+    {0x04, 0x00, 0x0c, 0x04, 0x04, 0x04, 0x0e}, /* 'i' */
+    {0x02, 0x00, 0x06, 0x02, 0x02, 0x12, 0x0c}, /* 'j' */
+    {0x10, 0x10, 0x12, 0x14, 0x18, 0x14, 0x12}, /* 'k' */
+    {0x0c, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0e}, /* 'l' */
+    {0x00, 0x00, 0x1a, 0x15, 0x15, 0x11, 0x11}, /* 'm' */
+    {0x00, 0x00, 0x16, 0x19, 0x11, 0x11, 0x11}, /* 'n' */
+    {0x00, 0x00, 0x0e, 0x11, 0x11, 0x11, 0x0e}, /* 'o' */
+    {0x00, 0x00, 0x1e, 0x11, 0x1e, 0x10, 0x10}, /* 'p' */
+    {0x00, 0x00, 0x0d, 0x13, 0x0f, 0x01, 0x01}, /* 'q' */
+    {0x00, 0x00, 0x16, 0x19, 0x10, 0x10, 0x10}, /* 'r' */
+    {0x00, 0x00, 0x0e, 0x10, 0x0e, 0x01, 0x1e}, /* 's' */
+    {0x08, 0x08, 0x1c, 0x08, 0x08, 0x09, 0x06}, /* 't' */
+    {0x00, 0x00, 0x11, 0x11, 0x11, 0x13, 0x0d}, /* 'u' */
+    {0x00, 0x00, 0x11, 0x11, 0x11, 0x0a, 0x04}, /* 'v' */
+    {0x00, 0x00, 0x11, 0x11, 0x15, 0x15, 0x0a}, /* 'w' */
+    {0x00, 0x00, 0x11, 0x0a, 0x04, 0x0a, 0x11}, /* 'x' */
+    {0x00, 0x00, 0x11, 0x11, 0x0f, 0x01, 0x0e}, /* 'y' */
+    {0x00, 0x00, 0x1f, 0x02, 0x04, 0x08, 0x1f}, /* 'z' */
+    {0x02, 0x04, 0x04, 0x08, 0x04, 0x04, 0x02}, /* '{' */
+    {0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04}, /* '|' */
+    {0x08, 0x04, 0x04, 0x02, 0x04, 0x04, 0x08}, /* '}' */
+    {0x00, 0x00, 0x08, 0x15, 0x02, 0x00, 0x00}, /* '~' */
+};
+
+/* One quad per glyph, 16 bytes: top left in pixels, atlas index, integer scale and RGBA */
+typedef struct GlyphInstance
+{
+    float x, y;
+    uint16_t glyph, scale;
+    uint32_t color;
+} GlyphInstance;
+
+typedef struct TextBatch
+{
+    GlyphInstance *glyphs;
+    size_t count, capacity;
+} TextBatch;
+
+/* Fills a FONT_ATLAS_WIDTH x FONT_ATLAS_HEIGHT coverage image, glyph i in cell (i % FONT_COLUMNS, i / FONT_COLUMNS) */
+void font_atlas(uint8_t *pixels)
+{
+    memset(pixels, 0, FONT_ATLAS_WIDTH * FONT_ATLAS_HEIGHT);
+    for (size_t g = 0; g < FONT_GLYPHS; ++g)
+    {
+        size_t x0 = g % FONT_COLUMNS * FONT_CELL, y0 = g / FONT_COLUMNS * FONT_CELL;
+        for (size_t y = 0; y < FONT_HEIGHT; ++y)
+            for (size_t x = 0; x < FONT_WIDTH; ++x)
+                if (font_5x7[g][y] >> (FONT_WIDTH - 1 - x) & 1)
+                    pixels[(y0 + y) * FONT_ATLAS_WIDTH + x0 + x] = 255;
+    }
+}
+
+uint32_t rgba(float r, float g, float b, float a)
+{
+    return (uint32_t) (r * 255 + 0.5f) | (uint32_t) (g * 255 + 0.5f) << 8 | (uint32_t) (b * 255 + 0.5f) << 16
+        | (uint32_t) (a * 255 + 0.5f) << 24;
+}
+
+void init_TextBatch(TextBatch *batch, size_t capacity)
+{
+    batch->glyphs = malloc(capacity * sizeof(GlyphInstance));
+    batch->count = 0;
+    batch->capacity = capacity;
+}
+
+void delete_TextBatch(TextBatch *batch)
+{
+    free(batch->glyphs);
+    *batch = (TextBatch) {0};
+}
+
+void text_clear(TextBatch *batch)
+{
+    batch->count = 0;
+}
+
+/* Size in pixels of a line of text at an integer scale */
+float text_width(const char *text, int scale)
+{
+    size_t n = strlen(text);
+    return n ? (n * FONT_ADVANCE - (FONT_ADVANCE - FONT_WIDTH)) * scale : 0;
+}
+
+float text_height(int scale)
+{
+    return FONT_HEIGHT * scale;
+}
+
+/*
+ * Adds one line of text with its box anchored at (x, y): ax and ay are 0
+ * to put the left or top edge there, 0.5 for the centre and 1 for the right
+ * or bottom edge. Positions are rounded to whole pixels so glyphs stay sharp.
+ */
+void text_add(TextBatch *batch, float x, float y, float ax, float ay, int scale, uint32_t color, const char *text)
+{
+    size_t n = strlen(text);
+    if (batch->count + n > batch->capacity)
+    {
+        batch->capacity = 2 * (batch->count + n);
+        batch->glyphs = realloc(batch->glyphs, batch->capacity * sizeof(GlyphInstance));
+    }
+    x = roundf(x - ax * text_width(text, scale));
+    y = roundf(y - ay * text_height(scale));
+    GlyphInstance *out = &batch->glyphs[batch->count];
+    for (size_t i = 0; i < n; ++i)
+    {
+        unsigned c = (unsigned char) text[i];
+        c = c >= FONT_FIRST && c < FONT_FIRST + FONT_GLYPHS ? c : '?';
+        out[i] = (GlyphInstance) {x + i * FONT_ADVANCE * scale, y, c - FONT_FIRST, scale, color};
+    }
+    batch->count += n;
+}
+
+void text_addf(TextBatch *batch, float x, float y, float ax, float ay, int scale, uint32_t color, const char *format,
+               ...)
+{
+    char text[TEXT_MAX_LABEL];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    text_add(batch, x, y, ax, ay, scale, color, text);
+}
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef GRID_H
+#define GRID_H
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Scalar fields sampled on a regular grid, for contour and surface plots */
+
+typedef struct Grid
+{
+    float *values;         /* width * height, row 0 at y0 */
+    size_t width, height;
+    double x0, x1, y0, y1; /* where the first and last samples sit */
+} Grid;
+
+void delete_Grid(Grid *grid)
+{
+    free(grid->values);
+    *grid = (Grid) {0};
+}
+
+/*
+ * Reads a grid with one row of comma-separated values per line, the first
+ * line at y = -1 and the last at y = 1, x running from -1 to 1 along each
+ * row. Returns false if it cannot be read or its rows differ in length.
+ */
+bool read_grid(const char *filename, Grid *grid)
+{
+    FILE *file = fopen(filename, "r");
+    if (file == NULL)
+    {
+        printf("error: could not open %s\n", filename);
+        return false;
+    }
+    size_t capacity = 1024, count = 0, width = 0, row = 0;
+    float *values = malloc(capacity * sizeof(float));
+    char *line = NULL;
+    size_t line_capacity = 0;
+    while (getline(&line, &line_capacity, file) > 0)
+    {
+        size_t before = count;
+        for (char *at = line, *end; ; at = end + (*end == ','))
+        {
+            float v = strtof(at, &end);
+            if (end == at)
+                break;
+            if (count == capacity)
+            {
+                capacity *= 2;
+                values = realloc(values, capacity * sizeof(float));
+            }
+            values[count++] = v;
+        }
+        if (count == before)
+            continue;
+        if (row == 0)
+            width = count;
+        if (count - before != width)
+        {
+            printf("error: row %zu of %s has %zu values, not %zu\n", row + 1, filename, count - before, width);
+            free(values);
+            free(line);
+            fclose(file);
+            return false;
+        }
+        ++row;
+    }
+    free(line);
+    fclose(file);
+    if (row < 2 || width < 2)
+    {
+        printf("error: %s needs at least two rows of two values\n", filename);
+        free(values);
+        return false;
+    }
+    *grid = (Grid) {values, width, row, -1, 1, -1, 1};
+    return true;
+}
+
+/*
+ * Fills the grid with overlapping waves and a bump, standing in for a
+ * simulated field in benchmarks: its contours come in loops, saddles and
+ * lines crossing the edges.
+ */
+void example_grid(Grid *grid)
+{
+    for (size_t j = 0; j < grid->height; ++j)
+    {
+        float y = grid->y0 + (grid->y1 - grid->y0) * j / (grid->height - 1);
+        for (size_t i = 0; i < grid->width; ++i)
+        {
+            float x = grid->x0 + (grid->x1 - grid->x0) * i / (grid->width - 1);
+            grid->values[j * grid->width + i] = sinf(7 * x) * cosf(5 * y) + 0.5f * sinf(23 * x + 17 * y)
+                + 2 * expf(-8 * ((x - 0.3f) * (x - 0.3f) + (y + 0.2f) * (y + 0.2f))) + 0.3f * x;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef HEATMAP_H
+#define HEATMAP_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "histogram.h"
+#include "render.h"
+
+/*
+ * Heatmap plots: a Histogram uploaded as an R32F texture with one texel per
+ * pixel and drawn as a single full-screen quad, the fragment shader mapping
+ * log(1 + count) / log(1 + max) through a viridis colormap. Empty pixels are
+ * discarded so the background shows through. The quad's corners come from
+ * gl_VertexID, so there is no vertex buffer, only the empty VAO the core
+ * profile requires.
+ */
+
+/* Polynomial fit to matplotlib's viridis, for pasting into fragment shaders */
+#define VIRIDIS_GLSL \
+    "vec3 viridis(float t)\n" \
+    "{\n" \
+    "    const vec3 c0 = vec3(0.2777273272234177, 0.005407344544966578, 0.3340998053353061);\n" \
+    "    const vec3 c1 = vec3(0.1050930431085774, 1.404613529898575, 1.384590162594685);\n" \
+    "    const vec3 c2 = vec3(-0.3308618287255563, 0.214847559468213, 0.09509516302823659);\n" \
+    "    const vec3 c3 = vec3(-4.634230498983486, -5.799100973351585, -19.33244095627987);\n" \
+    "    const vec3 c4 = vec3(6.228269936347081, 14.17993336680509, 56.69055260068105);\n" \
+    "    const vec3 c5 = vec3(4.776384997670288, -13.74514537774601, -65.35303263337234);\n" \
+    "    const vec3 c6 = vec3(-5.435455855934631, 4.645852612178535, 26.3124352495832);\n" \
+    "    return c0 + t * (c1 + t * (c2 + t * (c3 + t * (c4 + t * (c5 + t * c6)))));\n" \
+    "}\n" \
+    "\n"
+
+/* Full-screen quad from gl_VertexID, drawn as a 4-vertex triangle strip; uv runs from 0 to 1 */
+const char heatmap_vertex_shader_source[] =
+    "#version 330 core\n"
+    "out vec2 uv;\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "   uv = vec2(gl_VertexID & 1, gl_VertexID >> 1);\n"
+    "   gl_Position = vec4(2.0 * uv - 1.0, 0.0, 1.0);\n"
+    "}\n\0";
+const char heatmap_fragment_shader_source[] =
+    "#version 330 core\n"
+    "uniform sampler2D density;\n"
+    "uniform float max_density;\n"
+    "in vec2 uv;\n"
+    "out vec4 FragColor;\n"
+    "\n"
+    VIRIDIS_GLSL
+    "void main()\n"
+    "{\n"
+    "    float count = texture(density, uv).r;\n"
+    "    if (count <= 0.0)\n"
+    "        discard;\n"
+    "    float t = log(1.0 + count) / log(1.0 + max(max_density, 1.0));\n"
+    "    FragColor = vec4(viridis(clamp(t, 0.0, 1.0)), 1.0);\n"
+    "}\n\0";
+
+typedef struct Heatmap
+{
+    uint program, VAO, texture;
+    int width, height; /* of the texture */
+    float max;
+} Heatmap;
+
+void init_Heatmap(Heatmap *heatmap)
+{
+    heatmap->program = setup_shader_program(heatmap_vertex_shader_source, heatmap_fragment_shader_source);
+    glGenVertexArrays(1, &heatmap->VAO);
+    glGenTextures(1, &heatmap->texture);
+    glBindTexture(GL_TEXTURE_2D, heatmap->texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    heatmap->width = heatmap->height = 0;
+    heatmap->max = 0;
+}
+
+void delete_Heatmap(Heatmap *heatmap)
+{
+    glDeleteTextures(1, &heatmap->texture);
+    glDeleteVertexArrays(1, &heatmap->VAO);
+    glDeleteProgram(heatmap->program);
+}
+
+/* Replaces the texture with the histogram, reallocating it only when the size changes */
+void heatmap_upload(Heatmap *heatmap, const Histogram *hist)
+{
+    glBindTexture(GL_TEXTURE_2D, heatmap->texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if (hist->width != heatmap->width || hist->height != heatmap->height)
+    {
+        heatmap->width = hist->width;
+        heatmap->height = hist->height;
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, hist->width, hist->height, 0, GL_RED, GL_FLOAT, hist->values);
+    }
+    else
+    {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, hist->width, hist->height, GL_RED, GL_FLOAT, hist->values);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    heatmap->max = hist->max;
+}
+
+void heatmap_draw(Heatmap *heatmap)
+{
+    if (heatmap->width == 0 || heatmap->height == 0)
+        return;
+    glUseProgram(heatmap->program);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, heatmap->texture);
+    glUniform1i(glGetUniformLocation(heatmap->program, "density"), 0);
+    glUniform1f(glGetUniformLocation(heatmap->program, "max_density"), heatmap->max);
+    glBindVertexArray(heatmap->VAO);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glUseProgram(0);
+}
+
+#endif
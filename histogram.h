@@ -0,0 +1,315 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mathlib.h"
+#include "sampler.h"
+#include "threads.h"
+
+/*
+ * 2D histograms of a series for heatmap plots, where dense scatter would
+ * overplot into a blob.
+ *
+ * Binning runs on every thread, each counting its share of the points into a
+ * private grid so that no increment is ever shared, and the grids are then
+ * summed cell by cell, also in parallel. A Binner does this once over the
+ * whole series at HISTOGRAM_BASE x HISTOGRAM_BASE; a view whose pixels are at
+ * least as big as a base cell is then resampled from that grid, costing the
+ * number of visible cells rather than the number of points, so zooming out
+ * and panning at that level never touch the points again. Views zoomed in
+ * past the base resolution bin the points afresh, and if the series is
+ * sorted by x only the visible x range is read.
+ *
+ * The output is an estimated count per pixel as floats, ready to upload as a
+ * texture: resampled pixels get the sum of the base cells whose centres they
+ * contain, scaled by the pixel's area over those cells' area so that pixels
+ * covering one cell and pixels covering two come out alike.
+ */
+
+#define HISTOGRAM_BASE 2048
+
+typedef struct Histogram
+{
+    float *values; /* width * height, row 0 at the bottom of the view */
+    int width, height;
+    float max;
+} Histogram;
+
+typedef struct Binner
+{
+    const vec3 *points; /* the caller's, not copied */
+    size_t n;
+    bool sorted;            /* by x */
+    double x0, x1, y0, y1;  /* bounds of the points */
+    uint32_t *base;         /* HISTOGRAM_BASE^2 counts over the bounds */
+    uint32_t *scratch;      /* one private grid per thread */
+    size_t scratch_cells;   /* per thread */
+    size_t num_threads;
+} Binner;
+
+void delete_Histogram(Histogram *hist)
+{
+    free(hist->values);
+    *hist = (Histogram) {0};
+}
+
+/* Binning */
+
+typedef struct BinJob
+{
+    const vec3 *points;
+    float x0, y0, sx, sy;   /* grid coordinate = (p - origin) * scale */
+    size_t width, height;
+    uint32_t *grids;        /* per thread, width * height each */
+    uint32_t *counts;       /* merged counts, or NULL */
+    float *values;          /* or merged as floats */
+    size_t num_grids;
+    bool sorted;
+    float *bounds;          /* per thread: x min, x max, y min, y max */
+} BinJob;
+
+void bin_points(void *ctx, size_t thread, size_t begin, size_t end)
+{
+    BinJob *job = ctx;
+    size_t cells = job->width * job->height;
+    uint32_t *grid = &job->grids[thread * cells];
+    memset(grid, 0, cells * sizeof(uint32_t));
+
+    /* Points on the far edges belong to the last row or column */
+    const vec3 *points = job->points;
+    float w = job->width, h = job->height;
+    for (size_t i = begin; i < end; ++i)
+    {
+        float fx = (points[i].x - job->x0) * job->sx, fy = (points[i].y - job->y0) * job->sy;
+        if (fx >= 0 && fx <= w && fy >= 0 && fy <= h)
+        {
+            size_t cx = fx < w ? (size_t) fx : job->width - 1, cy = fy < h ? (size_t) fy : job->height - 1;
+            ++grid[cy * job->width + cx];
+        }
+    }
+}
+
+void bin_merge(void *ctx, size_t thread, size_t begin, size_t end)
+{
+    BinJob *job = ctx;
+    size_t cells = job->width * job->height;
+    for (size_t c = begin; c < end; ++c)
+    {
+        uint32_t sum = 0;
+        for (size_t t = 0; t < job->num_grids; ++t)
+            sum += job->grids[t * cells + c];
+        if (job->counts != NULL)
+            job->counts[c] = sum;
+        else
+            job->values[c] = sum;
+    }
+}
+
+void bin_bounds(void *ctx, size_t thread, size_t begin, size_t end)
+{
+    BinJob *job = ctx;
+    float *bounds = &job->bounds[4 * thread];
+    bounds[0] = bounds[2] = INFINITY;
+    bounds[1] = bounds[3] = -INFINITY;
+    for (size_t i = begin; i < end; ++i)
+    {
+        vec3 p = job->points[i];
+        if (i > 0 && p.x < job->points[i - 1].x)
+            __atomic_store_n(&job->sorted, false, __ATOMIC_RELAXED);
+        bounds[0] = p.x < bounds[0] ? p.x : bounds[0];
+        bounds[1] = p.x > bounds[1] ? p.x : bounds[1];
+        bounds[2] = p.y < bounds[2] ? p.y : bounds[2];
+        bounds[3] = p.y > bounds[3] ? p.y : bounds[3];
+    }
+}
+
+/* Counts points[begin, end) into a width x height grid over [x0, x1] x [y0, y1] on every thread */
+void bin_range(Binner *binner, size_t begin, size_t end, double x0, double x1, double y0, double y1,
+               size_t width, size_t height, uint32_t *counts, float *values)
+{
+    size_t cells = width * height;
+    if (binner->scratch_cells < cells)
+    {
+        free(binner->scratch);
+        binner->scratch = malloc(binner->num_threads * cells * sizeof(uint32_t));
+        binner->scratch_cells = cells;
+        if (binner->scratch == NULL)
+        {
+            printf("error: out of memory binning into %zu x %zu cells\n", width, height);
+            exit(1);
+        }
+    }
+    BinJob job = {binner->points + begin, x0, y0, width / (x1 - x0), height / (y1 - y0), width, height,
+                  binner->scratch, counts, values, binner->num_threads};
+    parallel_for(binner->num_threads, end - begin, bin_points, &job);
+    parallel_for(binner->num_threads, cells, bin_merge, &job);
+}
+
+/*
+ * Bounds of n points, widened to a unit (or [-1, 1] with no points) on axes
+ * where they have no extent, as x0, x1, y0, y1; returns true if they are
+ * sorted by x.
+ */
+bool histogram_bounds(const vec3 *points, size_t n, size_t num_threads, double bounds[4])
+{
+    float partial[4 * num_threads];
+    BinJob job = {points};
+    job.sorted = true;
+    job.bounds = partial;
+    parallel_for(num_threads, n, bin_bounds, &job);
+    bounds[0] = bounds[2] = INFINITY;
+    bounds[1] = bounds[3] = -INFINITY;
+    for (size_t t = 0; t < num_threads; ++t)
+    {
+        bounds[0] = fmin(bounds[0], partial[4 * t]);
+        bounds[1] = fmax(bounds[1], partial[4 * t + 1]);
+        bounds[2] = fmin(bounds[2], partial[4 * t + 2]);
+        bounds[3] = fmax(bounds[3], partial[4 * t + 3]);
+    }
+    for (size_t axis = 0; axis < 4; axis += 2)
+    {
+        if (!(bounds[axis + 1] > bounds[axis]))
+        {
+            bounds[axis] = n ? bounds[axis] - 0.5 : -1;
+            bounds[axis + 1] = bounds[axis] + (n ? 1 : 2);
+        }
+    }
+    return job.sorted;
+}
+
+/*
+ * Bins all n points at the base resolution. The points must stay valid
+ * until delete_Binner(); num_threads 0 uses every core.
+ */
+void init_Binner(Binner *binner, const vec3 *points, size_t n, size_t num_threads)
+{
+    *binner = (Binner) {points, n, true};
+    binner->num_threads = num_threads ? num_threads : num_cores();
+    double bounds[4];
+    binner->sorted = histogram_bounds(points, n, binner->num_threads, bounds);
+    binner->x0 = bounds[0];
+    binner->x1 = bounds[1];
+    binner->y0 = bounds[2];
+    binner->y1 = bounds[3];
+
+    binner->base = malloc(HISTOGRAM_BASE * HISTOGRAM_BASE * sizeof(uint32_t));
+    bin_range(binner, 0, n, binner->x0, binner->x1, binner->y0, binner->y1, HISTOGRAM_BASE, HISTOGRAM_BASE,
+              binner->base, NULL);
+}
+
+void delete_Binner(Binner *binner)
+{
+    free(binner->base);
+    free(binner->scratch);
+    *binner = (Binner) {0};
+}
+
+/* Resampling from the base grid */
+
+typedef struct Resample
+{
+    const Binner *binner;
+    Histogram *hist;
+    long *columns, *rows; /* first base cell whose centre is in each pixel, unclamped; one extra at the end */
+    double scale;         /* pixel area in base cells */
+} Resample;
+
+/* First base cell whose centre is at or after each of the n + 1 pixel edges from v0 in steps of dv */
+void resample_edges(long *edges, size_t n, double v0, double dv, double b0, double db)
+{
+    for (size_t i = 0; i <= n; ++i)
+        edges[i] = (long) ceil((v0 + i * dv - b0) / db - 0.5);
+}
+
+void resample_rows(void *ctx, size_t thread, size_t begin, size_t end)
+{
+    Resample *r = ctx;
+    const uint32_t *base = r->binner->base;
+    const long last = HISTOGRAM_BASE;
+    for (size_t y = begin; y < end; ++y)
+    {
+        long y0 = r->rows[y], y1 = r->rows[y + 1];
+        long cy0 = y0 < 0 ? 0 : y0 > last ? last : y0, cy1 = y1 < 0 ? 0 : y1 > last ? last : y1;
+        for (int x = 0; x < r->hist->width; ++x)
+        {
+            long x0 = r->columns[x], x1 = r->columns[x + 1];
+            long cx0 = x0 < 0 ? 0 : x0 > last ? last : x0, cx1 = x1 < 0 ? 0 : x1 > last ? last : x1;
+            uint64_t sum = 0;
+            for (long by = cy0; by < cy1; ++by)
+                for (long bx = cx0; bx < cx1; ++bx)
+                    sum += base[by * HISTOGRAM_BASE + bx];
+            long cells = (x1 - x0) * (y1 - y0);
+            r->hist->values[y * r->hist->width + x] = cells > 0 ? sum * r->scale / cells : 0;
+        }
+    }
+}
+
+/*
+ * Fills `hist` with the points' counts over the view, one cell per pixel,
+ * from the base grid if its cells are no bigger than the view's pixels and
+ * from the points otherwise. Returns true if it went back to the points.
+ */
+bool binner_view(Binner *binner, View view, Histogram *hist)
+{
+    if (hist->width != view.width || hist->height != view.height)
+    {
+        free(hist->values);
+        hist->values = malloc((size_t) view.width * view.height * sizeof(float));
+        hist->width = view.width;
+        hist->height = view.height;
+    }
+    double pw = (view.x1 - view.x0) / view.width, ph = (view.y1 - view.y0) / view.height;
+    double bw = (binner->x1 - binner->x0) / HISTOGRAM_BASE, bh = (binner->y1 - binner->y0) / HISTOGRAM_BASE;
+    bool rebin = pw < bw || ph < bh;
+
+    if (!rebin)
+    {
+        long columns[view.width + 1], rows[view.height + 1];
+        resample_edges(columns, view.width, view.x0, pw, binner->x0, bw);
+        resample_edges(rows, view.height, view.y0, ph, binner->y0, bh);
+        Resample r = {binner, hist, columns, rows, (pw * ph) / (bw * bh)};
+        parallel_for(binner->num_threads, view.height, resample_rows, &r);
+    }
+    else
+    {
+        /* Sorted points: only those in the visible x range can land in the view */
+        size_t begin = 0, end = binner->n;
+        if (binner->sorted)
+        {
+            size_t lo = 0, hi = binner->n;
+            while (lo < hi)
+            {
+                size_t mid = lo + (hi - lo) / 2;
+                if (binner->points[mid].x < view.x0)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            begin = lo;
+            hi = binner->n;
+            while (lo < hi)
+            {
+                size_t mid = lo + (hi - lo) / 2;
+                if (binner->points[mid].x <= view.x1)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            end = lo;
+        }
+        bin_range(binner, begin, end, view.x0, view.x1, view.y0, view.y1, view.width, view.height, NULL,
+                  hist->values);
+    }
+
+    hist->max = 0;
+    for (size_t c = 0; c < (size_t) view.width * view.height; ++c)
+        hist->max = hist->values[c] > hist->max ? hist->values[c] : hist->max;
+    return rebin;
+}
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <png.h>
+
+/*
+ * Writes a tightly packed RGBA8 image to a PNG file. Rows are expected
+ * bottom-up, the way glReadPixels returns them. Uses a fast zlib level since
+ * thumbnails are written far more often than they are read.
+ */
+bool write_png(const char *filename, int width, int height, const unsigned char *rgba)
+{
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL)
+    {
+        printf("error: could not open %s for writing\n", filename);
+        return false;
+    }
+
+    png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    png_infop info = png_create_info_struct(png);
+    if (setjmp(png_jmpbuf(png)))
+    {
+        printf("error: could not encode %s\n", filename);
+        png_destroy_write_struct(&png, &info);
+        fclose(file);
+        return false;
+    }
+
+    png_init_io(png, file);
+    png_set_IHDR(png, info, width, height, 8, PNG_COLOR_TYPE_RGBA, PNG_INTERLACE_NONE,
+                 PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    png_set_compression_level(png, 1);
+    png_set_filter(png, 0, PNG_FILTER_SUB);
+    png_write_info(png, info);
+    for (int y = height - 1; y >= 0; --y)
+        png_write_row(png, (png_const_bytep) &rgba[(size_t) y * width * 4]);
+    png_write_end(png, NULL);
+
+    png_destroy_write_struct(&png, &info);
+    fclose(file);
+    return true;
+}
+
+#endif
@@ -1,5 +1,9 @@
+#ifndef MATHLIB_H
+#define MATHLIB_H
+
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 float min(float a, float b)
 {
@@ -164,6 +168,60 @@ vec4 col(mat4 a, size_t i)
 
 mat4 matmul(mat4 a, mat4 b)
 {
-    printf("error: not implemented\n");
-    exit(1);
+    mat4 out;
+    for (size_t i = 0; i < 4; ++i)
+    {
+        for (size_t j = 0; j < 4; ++j)
+        {
+            out.x[i][j] = 0;
+            for (size_t k = 0; k < 4; ++k)
+                out.x[i][j] += a.x[i][k] * b.x[k][j];
+        }
+    }
+    return out;
+}
+
+vec4 matvec(mat4 a, vec4 v)
+{
+    vec4 out;
+    out.x = a.x[0][0] * v.x + a.x[0][1] * v.y + a.x[0][2] * v.z + a.x[0][3] * v.w;
+    out.y = a.x[1][0] * v.x + a.x[1][1] * v.y + a.x[1][2] * v.z + a.x[1][3] * v.w;
+    out.z = a.x[2][0] * v.x + a.x[2][1] * v.y + a.x[2][2] * v.z + a.x[2][3] * v.w;
+    out.w = a.x[3][0] * v.x + a.x[3][1] * v.y + a.x[3][2] * v.z + a.x[3][3] * v.w;
+    return out;
+}
+
+mat4 identity(void)
+{
+    mat4 out = {{{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}, {0, 0, 0, 1}}};
+    return out;
+}
+
+/*
+ * Camera matrices act on column vectors, x[row][col], so they go to GL
+ * with transpose = GL_TRUE. Both follow gluPerspective and gluLookAt: the
+ * camera looks down -z, and depth maps to [-1, 1] between near and far.
+ */
+mat4 perspective(float fovy, float aspect, float near, float far)
+{
+    float f = 1 / tanf(fovy / 2);
+    mat4 out = {{{f / aspect, 0, 0, 0},
+                 {0, f, 0, 0},
+                 {0, 0, (far + near) / (near - far), 2 * far * near / (near - far)},
+                 {0, 0, -1, 0}}};
+    return out;
 }
+
+mat4 look_at(vec3 eye, vec3 target, vec3 up)
+{
+    vec3 f = unit(sub(target, eye));
+    vec3 s = unit(cross(f, up));
+    vec3 u = cross(s, f);
+    mat4 out = {{{s.x, s.y, s.z, -dot(s, eye)},
+                 {u.x, u.y, u.z, -dot(u, eye)},
+                 {-f.x, -f.y, -f.z, dot(f, eye)},
+                 {0, 0, 0, 1}}};
+    return out;
+}
+
+#endif
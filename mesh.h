@@ -0,0 +1,406 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include "mathlib.h"
+#include "alloc.h"
+#include "scale.h"
+
+typedef uint uint;
+
+/* Done */
+vec3 *read_to_vertices(const char *filename)
+{
+    vec3 *vertices = (vec3 *) calloc(50, sizeof(vec3));
+    FILE *file;
+    file = fopen(filename, "r");
+    for (int i = 0; i < 50; ++i)
+    {
+        vec3 *curr = &vertices[i];
+        fscanf(file, "%20f, %20f, %20f", &curr->x, &curr->y, &curr->z);
+    }
+    return vertices;
+}
+
+/* Reads every "x, y, z" row of a CSV file; returns NULL if it cannot be opened */
+vec3 *read_csv(const char *filename, size_t *n)
+{
+    FILE *file = fopen(filename, "r");
+    if (file == NULL)
+    {
+        printf("error: could not open %s\n", filename);
+        *n = 0;
+        return NULL;
+    }
+
+    size_t capacity = 1024;
+    vec3 *vertices = malloc(capacity * sizeof(vec3));
+    *n = 0;
+    vec3 curr;
+    while (fscanf(file, "%f, %f, %f", &curr.x, &curr.y, &curr.z) == 3)
+    {
+        if (*n == capacity)
+        {
+            capacity *= 2;
+            vertices = realloc(vertices, capacity * sizeof(vec3));
+        }
+        vertices[(*n)++] = curr;
+    }
+    fclose(file);
+
+    return vertices;
+}
+
+/* Done */
+void normalize(size_t n, vec3 vertices[n])
+{
+    float xmin = INFINITY, xmax = -INFINITY, ymin = INFINITY, ymax = -INFINITY;
+    for (size_t i = 0; i < n; ++i)
+    {
+        xmin = min(xmin, vertices[i].x);
+        xmax = max(xmax, vertices[i].x);
+        ymin = min(ymin, vertices[i].y);
+        ymax = max(ymax, vertices[i].y);
+    }
+
+    if (xmax == xmin)
+        xmax = xmin + 1;
+    if (ymax == ymin)
+        ymax = ymin + 1;
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        vertices[i].x = 2 * (vertices[i].x - xmin) / (xmax - xmin) - 1;
+        vertices[i].y = 2 * (vertices[i].y - ymin) / (ymax - ymin) - 1;
+    }
+}
+
+/*
+ * Min/max decimation: split the series into `buckets` equal index ranges and
+ * keep the lowest and highest sample of each, in their original order. With
+ * one bucket per output pixel column the rendered line is unchanged.
+ *
+ * `out` must have room for min(n, 2 * buckets) points; returns the count.
+ */
+size_t downsample_into(size_t n, vec3 vertices[n], size_t buckets, vec3 *out)
+{
+    if (buckets == 0 || n <= 2 * buckets)
+    {
+        memcpy(out, vertices, n * sizeof(vec3));
+        return n;
+    }
+
+    size_t out_n = 0;
+    for (size_t b = 0; b < buckets; ++b)
+    {
+        size_t begin = b * n / buckets;
+        size_t end = (b + 1) * n / buckets;
+        size_t lo = begin, hi = begin;
+        for (size_t i = begin + 1; i < end; ++i)
+        {
+            if (vertices[i].y < vertices[lo].y)
+                lo = i;
+            if (vertices[i].y > vertices[hi].y)
+                hi = i;
+        }
+        if (lo > hi)
+        {
+            size_t tmp = lo;
+            lo = hi;
+            hi = tmp;
+        }
+        out[out_n++] = vertices[lo];
+        if (lo != hi)
+            out[out_n++] = vertices[hi];
+    }
+
+    return out_n;
+}
+
+size_t downsample_capacity(size_t n, size_t buckets)
+{
+    return buckets == 0 || n <= 2 * buckets ? n : 2 * buckets;
+}
+
+vec3 *downsample(size_t n, vec3 vertices[n], size_t buckets, size_t *out_n)
+{
+    vec3 *out = malloc(downsample_capacity(n, buckets) * sizeof(vec3));
+    *out_n = downsample_into(n, vertices, buckets, out);
+    return out;
+}
+
+/* Room needed by downsample_scaled_into(): up to three points in each of 3 * buckets buckets */
+size_t downsample_scaled_capacity(size_t n, size_t buckets)
+{
+    return buckets == 0 || n <= 9 * buckets ? n : 9 * buckets;
+}
+
+/* Updates a bucket's lowest, highest and lowest positive y with point i */
+void bucket_pick(const vec3 *vertices, size_t i, size_t picks[3])
+{
+    float y = vertices[i].y;
+    if (picks[0] == SIZE_MAX || y < vertices[picks[0]].y)
+        picks[0] = i;
+    if (picks[1] == SIZE_MAX || y > vertices[picks[1]].y)
+        picks[1] = i;
+    if (y > 0 && (picks[2] == SIZE_MAX || y < vertices[picks[2]].y))
+        picks[2] = i;
+}
+
+/* x under a log or symlog scale, up to a constant factor, which equal ranges do not see; ln is the cheapest log */
+double bucket_key(Scale scale, double x)
+{
+    return scale.type == SCALE_SYMLOG ? copysign(log(1 + fabs(x) / scale.threshold), x) : log(x);
+}
+
+/* Marks the picks of `buckets` equal ranges of x under a log or symlog `scale`, over the x values it can show */
+void pick_scaled_buckets(size_t n, const vec3 vertices[n], size_t buckets, Scale scale, size_t *picks,
+                         uint8_t *picked)
+{
+    /* The scales are increasing, so the ends of the shown x are the ends of the range */
+    float x0 = INFINITY, x1 = -INFINITY;
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (scale_valid(scale, vertices[i].x))
+        {
+            x0 = vertices[i].x < x0 ? vertices[i].x : x0;
+            x1 = vertices[i].x > x1 ? vertices[i].x : x1;
+        }
+    }
+    if (!(x1 > x0) || !isfinite(x0) || !isfinite(x1))
+        return;
+    double s0 = bucket_key(scale, x0), s1 = bucket_key(scale, x1);
+    for (size_t k = 0; k < 3 * buckets; ++k)
+        picks[k] = SIZE_MAX;
+    double to_bucket = buckets / (s1 - s0);
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (scale_valid(scale, vertices[i].x))
+        {
+            size_t b = (bucket_key(scale, vertices[i].x) - s0) * to_bucket;
+            bucket_pick(vertices, i, &picks[3 * (b < buckets ? b : buckets - 1)]);
+        }
+    }
+    for (size_t k = 0; k < 3 * buckets; ++k)
+        if (picks[k] != SIZE_MAX)
+            picked[picks[k]] = 1;
+}
+
+/*
+ * Min/max decimation that holds under any axis scale of scale.h, for
+ * series drawn with the scale applied on the GPU, so that switching scale
+ * needs no new reduction. Points are picked in `buckets` equal index
+ * ranges, as downsample_into() does, again in `buckets` equal ranges of
+ * log x over the positive x values, which keeps a bucket per pixel column
+ * at the low end of a log x axis too, and again in `buckets` equal ranges
+ * of symlog x, which does the same for negative x and for the linear part
+ * around zero. Every bucket keeps its lowest and highest y, which any
+ * increasing scale leaves lowest and highest, and its lowest positive y,
+ * which is the lowest a log y axis can show.
+ *
+ * Picked points are written once each, in their original order; `out` must
+ * have room for downsample_scaled_capacity(n, buckets) points.
+ */
+size_t downsample_scaled_into(size_t n, vec3 vertices[n], size_t buckets, vec3 *out)
+{
+    if (buckets == 0 || n <= 9 * buckets)
+    {
+        memcpy(out, vertices, n * sizeof(vec3));
+        return n;
+    }
+
+    uint8_t *picked = calloc(n, 1);
+    size_t *picks = malloc(3 * buckets * sizeof(size_t));
+    for (size_t b = 0; b < buckets; ++b)
+    {
+        size_t bucket[3] = {SIZE_MAX, SIZE_MAX, SIZE_MAX};
+        for (size_t i = b * n / buckets; i < (b + 1) * n / buckets; ++i)
+            bucket_pick(vertices, i, bucket);
+        for (size_t k = 0; k < 3; ++k)
+            if (bucket[k] != SIZE_MAX)
+                picked[bucket[k]] = 1;
+    }
+    pick_scaled_buckets(n, vertices, buckets, (Scale) {SCALE_LN, SCALE_THRESHOLD}, picks, picked);
+    pick_scaled_buckets(n, vertices, buckets, (Scale) {SCALE_SYMLOG, SCALE_THRESHOLD}, picks, picked);
+
+    size_t out_n = 0;
+    for (size_t i = 0; i < n; ++i)
+        if (picked[i])
+            out[out_n++] = vertices[i];
+    free(picks);
+    free(picked);
+    return out_n;
+}
+
+/*
+ * Meshes made by new_Mesh() keep vertices and indices in one block from
+ * mesh_pool and are `pooled`; meshes pointing at static or stack arrays
+ * leave it false and delete_Mesh() leaves them alone.
+ */
+typedef struct Mesh
+{
+    size_t num_vertices;
+    size_t num_indices;
+    vec3 *vertices;
+    uint *indices;
+    bool pooled;
+} Mesh;
+
+/* Vertices are zeroed, indices are left for the builder to fill */
+Mesh new_Mesh(size_t num_vertices, size_t num_indices)
+{
+    Mesh out;
+    size_t vertex_bytes = (num_vertices * sizeof(vec3) + POOL_ALIGN - 1) / POOL_ALIGN * POOL_ALIGN;
+    unsigned char *block = pool_alloc(&mesh_pool, vertex_bytes + num_indices * sizeof(uint));
+    out.num_vertices = num_vertices;
+    out.num_indices = num_indices;
+    out.vertices = (vec3 *) block;
+    out.indices = (uint *) (block + vertex_bytes);
+    out.pooled = true;
+    memset(out.vertices, 0, num_vertices * sizeof(vec3));
+    return out;
+}
+
+void delete_Mesh(Mesh *mesh)
+{
+    if (mesh->pooled)
+        pool_free(&mesh_pool, mesh->vertices);
+    mesh->vertices = NULL;
+    mesh->indices = NULL;
+    mesh->num_vertices = 0;
+    mesh->num_indices = 0;
+    mesh->pooled = false;
+}
+
+/* Done */
+Mesh line(size_t n, vec3 vertices[n], float width)
+{
+    if (n < 2)
+    {
+        printf("error: must have at least two points to form a line\n");
+        exit(1);
+    }
+
+    float dx, dy, norm;
+
+    // Allocate mesh
+    Mesh out = new_Mesh(2 * n, 6 * (n - 1));
+
+    // Left boundary
+    dx = vertices[1].x - vertices[0].x;
+    dy = vertices[1].y - vertices[0].y;
+    norm = sqrt(dx * dx + dy * dy);
+    dx = width * dx / norm;
+    dy = width * dy / norm;
+    out.vertices[0].x = vertices[0].x - dy;
+    out.vertices[0].y = vertices[0].y + dx;
+    out.vertices[1].x = vertices[0].x + dy;
+    out.vertices[1].y = vertices[0].y - dx;
+
+    // Right boundary
+    dx = vertices[n - 1].x - vertices[n - 2].x;
+    dy = vertices[n - 1].y - vertices[n - 2].y;
+    norm = sqrt(dx * dx + dy * dy);
+    dx = width * dx / norm;
+    dy = width * dy / norm;
+    out.vertices[2 * n - 2].x = vertices[n - 1].x - dy;
+    out.vertices[2 * n - 2].y = vertices[n - 1].y + dx;
+    out.vertices[2 * n - 1].x = vertices[n - 1].x + dy;
+    out.vertices[2 * n - 1].y = vertices[n - 1].y - dx;
+
+    // Interior
+    for (size_t i = 1; i < n - 1; ++i)
+    {
+        dx = vertices[i + 1].x + vertices[i].x - vertices[i - 1].x;
+        dy = vertices[i + 1].y + vertices[i].y - vertices[i - 1].y;
+        norm = sqrt(dx * dx + dy * dy);
+        dx = width * dx / norm;
+        dy = width * dy / norm;
+        out.vertices[2 * i].x = vertices[i].x - dy;
+        out.vertices[2 * i].y = vertices[i].y + dx;
+        out.vertices[2 * i + 1].x = vertices[i].x + dy;
+        out.vertices[2 * i + 1].y = vertices[i].y - dx;
+    }
+
+    // Indices
+    for (size_t i = 0; i < n - 1; ++i)
+    {
+        out.indices[6 * i] = 2 * i;
+        out.indices[6 * i + 1] = 2 * i + 1;
+        out.indices[6 * i + 2] = 2 * i + 2;
+        out.indices[6 * i + 3] = 2 * i + 3;
+        out.indices[6 * i + 4] = 2 * i + 2;
+        out.indices[6 * i + 5] = 2 * i + 1;
+    }
+
+    return out;
+}
+
+Mesh line_naive(size_t n, vec3 vertices[n], float width)
+{
+    // Allocate
+    Mesh out = new_Mesh(2 * n, 6 * (n - 1));
+
+    // Vertices
+    for (size_t i = 0; i < n; ++i)
+    {
+        out.vertices[2 * i].x = vertices[i].x;
+        out.vertices[2 * i + 1].x = vertices[i].x;
+        out.vertices[2 * i].y = vertices[i].y + width;
+        out.vertices[2 * i + 1].y = vertices[i].y - width;
+    }
+
+    // Indices
+    for (size_t i = 0; i < n - 1; ++i)
+    {
+        out.indices[6 * i] = 2 * i;
+        out.indices[6 * i + 1] = 2 * i + 1;
+        out.indices[6 * i + 2] = 2 * (i + 1);
+        out.indices[6 * i + 3] = 2 * (i + 1);
+        out.indices[6 * i + 4] = 2 * i + 1;
+        out.indices[6 * i + 5] = 2 * (i + 1) + 1;
+    }
+
+    return out;
+}
+
+Mesh diamond(vec3 point, float offset)
+{
+    Mesh out = new_Mesh(4, 6);
+
+    out.vertices[0] = (vec3) {point.x - offset, point.y, point.z};
+    out.vertices[1] = (vec3) {point.x, point.y - offset, point.z};
+    out.vertices[2] = (vec3) {point.x + offset, point.y, point.z};
+    out.vertices[3] = (vec3) {point.x, point.y + offset, point.z};
+
+    memcpy(out.indices, (uint[]) {0, 1, 2, 2, 3, 0}, 6 * sizeof(uint));
+
+    return out;
+}
+
+/* One diamond() marker per point in a single mesh, four vertices each */
+Mesh scatter(size_t n, vec3 points[n], float offset)
+{
+    Mesh out = new_Mesh(4 * n, 6 * n);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        vec3 point = points[i];
+        vec3 *v = &out.vertices[4 * i];
+        v[0] = (vec3) {point.x - offset, point.y, point.z};
+        v[1] = (vec3) {point.x, point.y - offset, point.z};
+        v[2] = (vec3) {point.x + offset, point.y, point.z};
+        v[3] = (vec3) {point.x, point.y + offset, point.z};
+
+        uint base = 4 * i;
+        memcpy(&out.indices[6 * i], (uint[]) {base, base + 1, base + 2, base + 2, base + 3, base}, 6 * sizeof(uint));
+    }
+
+    return out;
+}
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef MULTIWINDOW_H
+#define MULTIWINDOW_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "render.h"
+#include "sampler.h"
+#include "polyline.h"
+
+/*
+ * Several windows drawing the same data, one per monitor where there are
+ * enough. Every window's context shares objects with the first one's, so
+ * a series' vertex buffer and its shader program are created and uploaded
+ * once and drawn in every window. What each window owns is a VAO, since
+ * VAOs are not shared between contexts, and its own view, input state,
+ * vsync setting and redraw flag. A window with nothing new to show is
+ * neither drawn nor swapped, so panning in one window does not redraw the
+ * others.
+ *
+ * All windows are driven from one thread, so every swap that waits for a
+ * vertical blank holds up the windows after it. With several vsynced
+ * windows each loop pays one wait per window, so by default only the first
+ * window waits and paces the loop.
+ */
+
+#define WINDOWS_MAX 8
+
+typedef struct PlotWindow
+{
+    GLFWwindow *window;
+    uint VAO; /* this context's view of the shared buffer */
+    View view;
+    bool vsync;
+    bool redraw;         /* set by this window's callbacks */
+    double scroll_steps; /* wheel steps not yet applied to the view */
+    double last_x, last_y;
+    size_t frames;
+} PlotWindow;
+
+void plot_window_redraw(GLFWwindow *window)
+{
+    PlotWindow *plot = glfwGetWindowUserPointer(window);
+    plot->redraw = true;
+}
+
+void plot_window_input_callback(GLFWwindow *window, double x, double y)
+{
+    plot_window_redraw(window);
+}
+
+void plot_window_button_callback(GLFWwindow *window, int button, int action, int mods)
+{
+    plot_window_redraw(window);
+}
+
+void plot_window_scroll_callback(GLFWwindow *window, double dx, double dy)
+{
+    PlotWindow *plot = glfwGetWindowUserPointer(window);
+    plot->scroll_steps += dy;
+    plot->redraw = true;
+}
+
+void plot_window_size_callback(GLFWwindow *window, int width, int height)
+{
+    plot_window_redraw(window);
+}
+
+/* Moves a window onto the i-th monitor, wrapping around, near its top left corner */
+void place_on_monitor(GLFWwindow *window, size_t i)
+{
+    int count;
+    GLFWmonitor **monitors = glfwGetMonitors(&count);
+    if (count == 0)
+        return;
+    int x, y;
+    glfwGetMonitorPos(monitors[i % count], &x, &y);
+    glfwSetWindowPos(window, x + 40 + 40 * (i / count), y + 40 + 40 * (i / count));
+}
+
+/*
+ * Opens a window showing `view`, sharing objects with `share` if it is not
+ * NULL, and leaves its context current. The PlotWindow must not move while
+ * the window is open; its callbacks find it through the user pointer.
+ */
+void open_PlotWindow(PlotWindow *plot, const char *title, int width, int height, GLFWwindow *share, View view,
+                     bool vsync)
+{
+    plot->window = open_window(title, width, height, share);
+    plot->view = view;
+    plot->vsync = vsync;
+    plot->redraw = true;
+    plot->scroll_steps = 0;
+    plot->last_x = plot->last_y = 0;
+    plot->frames = 0;
+    glfwSwapInterval(vsync ? 1 : 0);
+    glGenVertexArrays(1, &plot->VAO);
+    glfwSetWindowUserPointer(plot->window, plot);
+    glfwSetFramebufferSizeCallback(plot->window, plot_window_size_callback);
+    glfwSetWindowRefreshCallback(plot->window, plot_window_redraw);
+    glfwSetCursorPosCallback(plot->window, plot_window_input_callback);
+    glfwSetMouseButtonCallback(plot->window, plot_window_button_callback);
+    glfwSetScrollCallback(plot->window, plot_window_scroll_callback);
+}
+
+/* Deletes the window's own objects in its context, then the window */
+void close_PlotWindow(PlotWindow *plot)
+{
+    glfwMakeContextCurrent(plot->window);
+    glDeleteVertexArrays(1, &plot->VAO);
+    glfwMakeContextCurrent(NULL);
+    glfwDestroyWindow(plot->window);
+}
+
+/*
+ * Draws a series set up with the polyline vertex shader in one window,
+ * through the window's VAO, and swaps. `series` holds the shared program
+ * and buffer; only its VAO is swapped for the window's.
+ */
+void plot_window_draw(PlotWindow *plot, const GameObject *series, Scale x, Scale y, float width)
+{
+    glfwMakeContextCurrent(plot->window);
+    int fb_width, fb_height;
+    glfwGetFramebufferSize(plot->window, &fb_width, &fb_height);
+    glViewport(0, 0, fb_width, fb_height);
+    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    GameObject view = *series;
+    view.VAO = plot->VAO;
+    polyline_draw(&view, plot->view, x, y, width * fb_height, fb_width, fb_height);
+    glfwSwapBuffers(plot->window);
+    plot->redraw = false;
+    ++plot->frames;
+}
+
+#endif
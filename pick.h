@@ -0,0 +1,253 @@
+#ifndef PICK_H
+#define PICK_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "render.h"
+#include "timing.h"
+
+/*
+ * GPU picking: which series and point is drawn on top at a pixel.
+ *
+ * With picking on, the scene is drawn into an offscreen framebuffer with two
+ * attachments, the usual colour and an RG32UI attachment that the pick
+ * shaders fill with (series, point) per fragment, series 0 being the
+ * background. picker_end() blits the colour to the window. Later draws
+ * overwrite earlier ones in both attachments, so the ID buffer always agrees
+ * with what is visible.
+ *
+ * The point is the mesh vertex number divided by the object's vertices per
+ * point (2 for line() and line_naive(), 4 for scatter()), taken from the
+ * first vertex of each triangle. A line segment's two triangles therefore
+ * report its two end points.
+ *
+ * picker_request() reads a PICK_SIZE square around the cursor into a pixel
+ * pack buffer and fences; nothing waits for it. picker_poll() maps buffers
+ * whose fence has passed, usually a frame later, and reports the hit nearest
+ * to the cursor. PICK_BUFFERS reads can be in flight; further requests are
+ * dropped until one comes back.
+ */
+
+#define PICK_RADIUS 4
+#define PICK_SIZE (2 * PICK_RADIUS + 1)
+#define PICK_BUFFERS 3
+
+const char pick_vertex_shader_source[] =
+    "#version 330 core\n"
+    "layout (location = 0) in vec3 aPos;\n"
+    "uniform uint vertices_per_point;\n"
+    "flat out uint point;\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "   gl_Position = vec4(aPos.x, aPos.y, aPos.z, 1.0);\n"
+    "   point = uint(gl_VertexID) / vertices_per_point;\n"
+    "}\n\0";
+const char pick_fragment_shader_source[] =
+    "#version 330 core\n"
+    "uniform uint series;\n"
+    "flat in uint point;\n"
+    "layout (location = 0) out vec4 FragColor;\n"
+    "layout (location = 1) out uvec2 pick;\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "    FragColor = vec4(1.0f, 0.5f, 0.2f, 1.0f);\n"
+    "    pick = uvec2(series, point);\n"
+    "}\n\0";
+
+typedef struct PickResult
+{
+    uint series, point; /* series 0: nothing under the cursor */
+    double latency;     /* seconds from request to result */
+} PickResult;
+
+typedef struct PickRead
+{
+    uint PBO;
+    GLsync fence;
+    int x, y;          /* cursor, relative to the region read */
+    double issued;
+    bool pending;
+} PickRead;
+
+typedef struct Picker
+{
+    uint FBO, color, ids;
+    int width, height;
+    PickRead reads[PICK_BUFFERS];
+    size_t next;
+} Picker;
+
+void init_Picker(Picker *picker)
+{
+    glGenFramebuffers(1, &picker->FBO);
+    glGenRenderbuffers(1, &picker->color);
+    glGenRenderbuffers(1, &picker->ids);
+    picker->width = picker->height = 0;
+    picker->next = 0;
+    for (size_t i = 0; i < PICK_BUFFERS; ++i)
+    {
+        PickRead *read = &picker->reads[i];
+        glGenBuffers(1, &read->PBO);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, read->PBO);
+        glBufferData(GL_PIXEL_PACK_BUFFER, PICK_SIZE * PICK_SIZE * 2 * sizeof(uint), NULL, GL_STREAM_READ);
+        read->pending = false;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void delete_Picker(Picker *picker)
+{
+    for (size_t i = 0; i < PICK_BUFFERS; ++i)
+    {
+        if (picker->reads[i].pending)
+            glDeleteSync(picker->reads[i].fence);
+        glDeleteBuffers(1, &picker->reads[i].PBO);
+    }
+    glDeleteRenderbuffers(1, &picker->color);
+    glDeleteRenderbuffers(1, &picker->ids);
+    glDeleteFramebuffers(1, &picker->FBO);
+}
+
+/* Binds the offscreen framebuffer, (re)sized to width x height, and clears it */
+void picker_begin(Picker *picker, int width, int height, vec4 background)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, picker->FBO);
+    if (width != picker->width || height != picker->height)
+    {
+        picker->width = width;
+        picker->height = height;
+        glBindRenderbuffer(GL_RENDERBUFFER, picker->color);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, picker->ids);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RG32UI, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, picker->color);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_RENDERBUFFER, picker->ids);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            printf("error: pick framebuffer is incomplete\n");
+            exit(1);
+        }
+    }
+    glDrawBuffers(2, (GLenum[]) {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1});
+    glProvokingVertex(GL_FIRST_VERTEX_CONVENTION);
+    glClearBufferfv(GL_COLOR, 0, (float[]) {background.x, background.y, background.z, background.w});
+    glClearBufferuiv(GL_COLOR, 1, (GLuint[]) {0, 0, 0, 0});
+}
+
+/* Draws an object made with the pick shaders */
+void pick_draw(GameObject *rend, uint series, uint vertices_per_point)
+{
+    glUseProgram(rend->program);
+    glUniform1ui(glGetUniformLocation(rend->program, "series"), series);
+    glUniform1ui(glGetUniformLocation(rend->program, "vertices_per_point"), vertices_per_point);
+    draw(rend);
+}
+
+/*
+ * Queues a read of the IDs around framebuffer pixel (x, y), bottom-up, while
+ * the pick framebuffer is bound. Returns false if all reads are in flight.
+ */
+bool picker_request(Picker *picker, int x, int y)
+{
+    PickRead *read = &picker->reads[picker->next];
+    if (read->pending || picker->width < PICK_SIZE || picker->height < PICK_SIZE)
+        return false;
+    picker->next = (picker->next + 1) % PICK_BUFFERS;
+
+    /* Keep the square inside the framebuffer; the cursor may sit off its centre */
+    int x0 = x - PICK_RADIUS, y0 = y - PICK_RADIUS;
+    x0 = x0 < 0 ? 0 : x0 > picker->width - PICK_SIZE ? picker->width - PICK_SIZE : x0;
+    y0 = y0 < 0 ? 0 : y0 > picker->height - PICK_SIZE ? picker->height - PICK_SIZE : y0;
+    read->x = x - x0;
+    read->y = y - y0;
+
+    glReadBuffer(GL_COLOR_ATTACHMENT1);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, read->PBO);
+    glReadPixels(x0, y0, PICK_SIZE, PICK_SIZE, GL_RG_INTEGER, GL_UNSIGNED_INT, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    read->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    read->issued = now_seconds();
+    read->pending = true;
+    return true;
+}
+
+/* Copies the picture to the window's framebuffer and binds that again */
+void picker_end(Picker *picker)
+{
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, picker->FBO);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, picker->width, picker->height, 0, 0, picker->width, picker->height,
+                      GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glProvokingVertex(GL_LAST_VERTEX_CONVENTION);
+}
+
+bool picker_pending(Picker *picker)
+{
+    for (size_t i = 0; i < PICK_BUFFERS; ++i)
+        if (picker->reads[i].pending)
+            return true;
+    return false;
+}
+
+/*
+ * Collects every read whose fence has passed, without waiting. Returns true
+ * and fills *result with the newest one if there was any.
+ */
+bool picker_poll(Picker *picker, PickResult *result)
+{
+    bool found = false;
+    for (size_t i = 0; i < PICK_BUFFERS; ++i)
+    {
+        /* Oldest first, so the newest read is reported */
+        PickRead *read = &picker->reads[(picker->next + i) % PICK_BUFFERS];
+        if (!read->pending)
+            continue;
+        GLenum status = glClientWaitSync(read->fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            break;
+        glDeleteSync(read->fence);
+        read->pending = false;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, read->PBO);
+        const uint *ids = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, PICK_SIZE * PICK_SIZE * 2 * sizeof(uint),
+                                           GL_MAP_READ_BIT);
+        *result = (PickResult) {0, 0, now_seconds() - read->issued};
+        int best = PICK_SIZE * PICK_SIZE * 2;
+        for (int y = 0; ids != NULL && y < PICK_SIZE; ++y)
+        {
+            for (int x = 0; x < PICK_SIZE; ++x)
+            {
+                const uint *id = &ids[2 * (y * PICK_SIZE + x)];
+                int d = (x - read->x) * (x - read->x) + (y - read->y) * (y - read->y);
+                if (id[0] != 0 && d < best)
+                {
+                    best = d;
+                    result->series = id[0];
+                    result->point = id[1];
+                }
+            }
+        }
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        found = true;
+    }
+    return found;
+}
+
+/* Centre of a picked point's vertices in the object's mesh */
+vec3 pick_position(const GameObject *rend, uint vertices_per_point, uint point)
+{
+    vec3 sum = zero;
+    for (uint i = 0; i < vertices_per_point && (size_t) point * vertices_per_point + i < rend->mesh.num_vertices; ++i)
+        sum = add(sum, rend->mesh.vertices[point * vertices_per_point + i]);
+    return divf(sum, vertices_per_point);
+}
+
+#endif
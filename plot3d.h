@@ -0,0 +1,196 @@
+#ifndef PLOT3D_H
+#define PLOT3D_H
+
+#include <math.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "heatmap.h"
+#include "mathlib.h"
+#include "render.h"
+#include "surface.h"
+
+/*
+ * 3D surface plots: a Surface uploaded once and drawn with a perspective
+ * camera orbiting the centre of its box. The camera is a single mat4 from
+ * mathlib, projection times view, so moving it only changes a uniform.
+ * Surfaces are shaded by height through the viridis colormap with a
+ * headlight-style diffuse term; wireframes are drawn flat over them or on
+ * their own, depth-tested either way.
+ */
+
+typedef enum SurfaceStyle
+{
+    SURFACE_FILLED,
+    SURFACE_WIREFRAME,
+    SURFACE_BOTH,
+} SurfaceStyle;
+
+const char surface_vertex_shader_source[] =
+    "#version 330 core\n"
+    "layout (location = 0) in vec3 aPos;\n"
+    "layout (location = 1) in vec3 aNormal;\n"
+    "uniform mat4 camera;\n"
+    "out vec3 normal;\n"
+    "out float height;\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "   normal = aNormal;\n"
+    "   height = aPos.z;\n"
+    "   gl_Position = camera * vec4(aPos, 1.0);\n"
+    "}\n\0";
+const char surface_fragment_shader_source[] =
+    "#version 330 core\n"
+    "uniform vec3 light;\n"
+    "uniform float half_height;\n"
+    "uniform bool wire;\n"
+    "in vec3 normal;\n"
+    "in float height;\n"
+    "out vec4 FragColor;\n"
+    "\n"
+    VIRIDIS_GLSL
+    "void main()\n"
+    "{\n"
+    "    if (wire)\n"
+    "    {\n"
+    "        FragColor = vec4(1.0, 0.5, 0.2, 1.0);\n"
+    "        return;\n"
+    "    }\n"
+    "    vec3 base = viridis(clamp(0.5 + 0.5 * height / half_height, 0.0, 1.0));\n"
+    "    float diffuse = abs(dot(normalize(normal), light));\n"
+    "    FragColor = vec4(base * (0.3 + 0.7 * diffuse), 1.0);\n"
+    "}\n\0";
+
+typedef struct Camera
+{
+    float yaw, pitch; /* radians; yaw about z, pitch above the xy plane */
+    float distance;   /* from the centre of the surface's box */
+    float fovy;
+} Camera;
+
+typedef struct SurfacePlot
+{
+    uint program, VAO, VBO, normals, triangles, lines;
+    size_t num_triangle_indices, num_line_indices;
+} SurfacePlot;
+
+Camera default_camera(void)
+{
+    return (Camera) {-0.6f, 0.5f, 3.5f, 45 * M_PI / 180};
+}
+
+vec3 camera_eye(Camera camera)
+{
+    return (vec3) {camera.distance * cosf(camera.pitch) * sinf(camera.yaw),
+                   -camera.distance * cosf(camera.pitch) * cosf(camera.yaw),
+                   camera.distance * sinf(camera.pitch)};
+}
+
+/* Projection times view for a viewport of the given aspect ratio */
+mat4 camera_matrix(Camera camera, float aspect)
+{
+    mat4 projection = perspective(camera.fovy, aspect, 0.05f * camera.distance, 4 * camera.distance);
+    mat4 view = look_at(camera_eye(camera), zero, (vec3) {0, 0, 1});
+    return matmul(projection, view);
+}
+
+/* Turns the camera by dx, dy pixels of drag and moves it in by `steps` wheel steps */
+void camera_orbit(Camera *camera, double dx, double dy, double steps)
+{
+    camera->yaw -= 0.01f * dx;
+    camera->pitch += 0.01f * dy;
+    camera->pitch = camera->pitch > 1.5f ? 1.5f : camera->pitch < -1.5f ? -1.5f : camera->pitch;
+    camera->distance *= pow(0.9, steps);
+}
+
+void init_SurfacePlot(SurfacePlot *plot)
+{
+    plot->program = setup_shader_program(surface_vertex_shader_source, surface_fragment_shader_source);
+    glGenVertexArrays(1, &plot->VAO);
+    glGenBuffers(1, &plot->VBO);
+    glGenBuffers(1, &plot->normals);
+    glGenBuffers(1, &plot->triangles);
+    glGenBuffers(1, &plot->lines);
+
+    glBindVertexArray(plot->VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, plot->VBO);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), (void *) 0);
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, plot->normals);
+    glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(uint32_t), (void *) 0);
+    glEnableVertexAttribArray(1);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    plot->num_triangle_indices = plot->num_line_indices = 0;
+}
+
+void delete_SurfacePlot(SurfacePlot *plot)
+{
+    glDeleteBuffers(4, (uint[]){plot->VBO, plot->normals, plot->triangles, plot->lines});
+    glDeleteVertexArrays(1, &plot->VAO);
+    glDeleteProgram(plot->program);
+}
+
+/* Copies the surface to the GPU; the Surface can be deleted afterwards */
+void surface_upload(SurfacePlot *plot, const Surface *surface)
+{
+    size_t n = surface->width * surface->height;
+    glBindBuffer(GL_ARRAY_BUFFER, plot->VBO);
+    glBufferData(GL_ARRAY_BUFFER, n * sizeof(vec3), surface->vertices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, plot->normals);
+    glBufferData(GL_ARRAY_BUFFER, n * sizeof(uint32_t), surface->normals, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    /* Not through the VAO, which would keep whichever was bound last */
+    glBindBuffer(GL_COPY_WRITE_BUFFER, plot->triangles);
+    glBufferData(GL_COPY_WRITE_BUFFER, surface->num_triangle_indices * sizeof(uint32_t), surface->triangles,
+                 GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, plot->lines);
+    glBufferData(GL_COPY_WRITE_BUFFER, surface->num_line_indices * sizeof(uint32_t), surface->lines, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    plot->num_triangle_indices = surface->num_triangle_indices;
+    plot->num_line_indices = surface->num_line_indices;
+}
+
+/* Draws into the bound framebuffer, which needs a depth buffer */
+void surface_draw(SurfacePlot *plot, Camera camera, float aspect, SurfaceStyle style)
+{
+    if (plot->num_triangle_indices == 0)
+        return;
+    mat4 matrix = camera_matrix(camera, aspect);
+    vec3 light = unit(camera_eye(camera));
+
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_PRIMITIVE_RESTART);
+    glPrimitiveRestartIndex(SURFACE_RESTART);
+    glUseProgram(plot->program);
+    glUniformMatrix4fv(glGetUniformLocation(plot->program, "camera"), 1, GL_TRUE, &matrix.x[0][0]);
+    glUniform3f(glGetUniformLocation(plot->program, "light"), light.x, light.y, light.z);
+    glUniform1f(glGetUniformLocation(plot->program, "half_height"), SURFACE_HEIGHT);
+    glBindVertexArray(plot->VAO);
+
+    if (style != SURFACE_WIREFRAME)
+    {
+        /* Pushed back a little so that a wireframe over it wins the depth test */
+        glEnable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(1, 1);
+        glUniform1i(glGetUniformLocation(plot->program, "wire"), false);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, plot->triangles);
+        glDrawElements(GL_TRIANGLE_STRIP, plot->num_triangle_indices, GL_UNSIGNED_INT, 0);
+        glDisable(GL_POLYGON_OFFSET_FILL);
+    }
+    if (style != SURFACE_FILLED)
+    {
+        glUniform1i(glGetUniformLocation(plot->program, "wire"), true);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, plot->lines);
+        glDrawElements(GL_LINE_STRIP, plot->num_line_indices, GL_UNSIGNED_INT, 0);
+    }
+
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glDisable(GL_PRIMITIVE_RESTART);
+    glDisable(GL_DEPTH_TEST);
+}
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef POLYLINE_H
+#define POLYLINE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "render.h"
+#include "sampler.h"
+#include "scale.h"
+
+/*
+ * Thick lines through raw data points, scaled and extruded in the vertex
+ * shader. The vertex buffer holds the points themselves, unprojected; each
+ * segment is one instance of a 4-vertex strip that reads its two ends as
+ * consecutive instances of two attributes over the same buffer, maps them
+ * through the axis scales and the view to pixels, and offsets its corners
+ * half the width to either side. Panning, zooming, resizing and switching
+ * scale therefore only change uniforms. Segments with an end a log scale
+ * cannot show are collapsed, leaving a gap, as are any on non-finite values.
+ *
+ * Lines are as wide in pixels at any zoom, and joints are left unmitered,
+ * as line_naive() leaves them.
+ */
+
+const char polyline_vertex_shader_source[] =
+    "#version 330 core\n"
+    "layout (location = 0) in vec3 a;\n"
+    "layout (location = 1) in vec3 b;\n"
+    "uniform vec4 view; /* x0, x1, y0, y1, scaled */\n"
+    "uniform ivec2 scale;\n"
+    "uniform vec2 threshold;\n"
+    "uniform vec2 viewport;\n"
+    "uniform float width;\n"
+    "\n"
+    AXIS_SCALE_GLSL
+    "vec2 to_pixels(vec3 p)\n"
+    "{\n"
+    "    vec2 s = vec2(axis_scale(p.x, scale.x, threshold.x), axis_scale(p.y, scale.y, threshold.y));\n"
+    "    return (s - view.xz) / (view.yw - view.xz) * viewport;\n"
+    "}\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "   vec2 pa = to_pixels(a), pb = to_pixels(b), d = pb - pa;\n"
+    "   bool shown = axis_valid(a.x, scale.x) && axis_valid(a.y, scale.y) && axis_valid(b.x, scale.x)\n"
+    "       && axis_valid(b.y, scale.y) && !any(isinf(d)) && !any(isnan(d));\n"
+    "   if (!shown)\n"
+    "   {\n"
+    "       gl_Position = vec4(2.0, 2.0, 0.0, 1.0);\n"
+    "       return;\n"
+    "   }\n"
+    "   vec2 normal = dot(d, d) > 0.0 ? normalize(vec2(-d.y, d.x)) : vec2(0.0, 1.0);\n"
+    "   vec2 p = ((gl_VertexID >> 1) == 0 ? pa : pb) + normal * width * (float(gl_VertexID & 1) - 0.5);\n"
+    "   gl_Position = vec4(2.0 * p / viewport - 1.0, 0.0, 1.0);\n"
+    "}\n\0";
+
+/* The points as they are, for a SeriesWorker to hand to a polyline */
+Mesh polyline_points(size_t n, vec3 vertices[n], float width)
+{
+    Mesh out = new_Mesh(n, 0);
+    memcpy(out.vertices, vertices, n * sizeof(vec3));
+    return out;
+}
+
+/*
+ * Draws an object's whole vertex buffer as one polyline `width` pixels
+ * wide, over a viewport of viewport_width x viewport_height pixels showing
+ * `view` in scaled units. The object must be set up with the polyline
+ * vertex shader; its mesh needs no indices.
+ */
+void polyline_draw(GameObject *rend, View view, Scale x, Scale y, float width, int viewport_width,
+                   int viewport_height)
+{
+    if (rend->mesh.num_vertices < 2)
+        return;
+    glUseProgram(rend->program);
+    glUniform4f(glGetUniformLocation(rend->program, "view"), view.x0, view.x1, view.y0, view.y1);
+    glUniform2i(glGetUniformLocation(rend->program, "scale"), x.type, y.type);
+    glUniform2f(glGetUniformLocation(rend->program, "threshold"), x.threshold, y.threshold);
+    glUniform2f(glGetUniformLocation(rend->program, "viewport"), viewport_width, viewport_height);
+    glUniform1f(glGetUniformLocation(rend->program, "width"), width);
+
+    /*
+     * Set and enabled on every draw, since an asynchronous upload swaps in a
+     * new buffer with only attribute 0, and a window's own VAO (multiwindow.h)
+     * starts with none
+     */
+    glBindVertexArray(rend->VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, rend->VBO);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), (void *) 0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), (void *) sizeof(vec3));
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribDivisor(0, 1);
+    glVertexAttribDivisor(1, 1);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, rend->mesh.num_vertices - 1);
+    glBindVertexArray(0);
+    glUseProgram(0);
+    rend->dirty = false;
+}
+
+#endif
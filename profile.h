@@ -0,0 +1,336 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "render.h"
+#include "timing.h"
+
+/*
+ * Frame profiler, compiled in with -DPLOT_PROFILE.
+ *
+ *     PROFILE_CPU(&profiler, "processInput", processInput(window));
+ *     PROFILE_DRAW(&profiler, "plot2", draw(&plot2));
+ *     profile_frame(&profiler, window);
+ *
+ * PROFILE_CPU times a statement on the CPU. PROFILE_DRAW also wraps it in a
+ * GL_TIME_ELAPSED query; queries live in a small ring per stage and are only
+ * read once GL reports them available, so the CPU never waits on the GPU (a
+ * stage whose ring is full simply skips GPU timing for that frame). Draw
+ * stages must not nest, since GL allows one elapsed-time query at a time.
+ *
+ * Each stage keeps its last PROFILE_SAMPLES samples. Once a second
+ * profile_frame() computes rolling p50/p95/p99, shows them as bars in the
+ * top-left corner (one thick CPU bar and one thin GPU bar per stage, full
+ * width = PROFILE_SCALE_MS) plus the frame times in the window title, and
+ * appends one JSON line to the file given to profile_open(), along with the
+ * mesh pool's allocation counters.
+ *
+ * Without PLOT_PROFILE the macros expand to just the statement and the
+ * functions are empty, so profiling costs nothing.
+ */
+
+#define PROFILE_STAGES 32
+#define PROFILE_SAMPLES 256
+#define PROFILE_QUERIES 4
+#define PROFILE_SCALE_MS 33.3
+
+#ifdef PLOT_PROFILE
+
+typedef struct ProfileSeries
+{
+    double samples[PROFILE_SAMPLES];
+    size_t count;
+} ProfileSeries;
+
+typedef struct ProfileStage
+{
+    const char *name;
+    ProfileSeries cpu, gpu;
+    uint queries[PROFILE_QUERIES];
+    size_t issued, resolved;
+} ProfileStage;
+
+typedef struct Profiler
+{
+    ProfileStage stages[PROFILE_STAGES];
+    size_t num_stages;
+    ProfileStage *active_query;
+    double frame_start, last_report;
+    FILE *dump;
+    GameObject overlay;
+    bool overlay_ready;
+} Profiler;
+
+void profile_open(Profiler *profiler, const char *dump_filename)
+{
+    memset(profiler, 0, sizeof(Profiler));
+    profiler->frame_start = profiler->last_report = now_seconds();
+    if (dump_filename != NULL)
+    {
+        profiler->dump = fopen(dump_filename, "w");
+        if (profiler->dump == NULL)
+            printf("error: could not open %s for writing\n", dump_filename);
+    }
+}
+
+/* Stage names are expected to be string literals, so pointers are compared first */
+ProfileStage *profile_stage(Profiler *profiler, const char *name)
+{
+    for (size_t i = 0; i < profiler->num_stages; ++i)
+        if (profiler->stages[i].name == name || strcmp(profiler->stages[i].name, name) == 0)
+            return &profiler->stages[i];
+    if (profiler->num_stages == PROFILE_STAGES)
+        return NULL;
+    ProfileStage *stage = &profiler->stages[profiler->num_stages++];
+    stage->name = name;
+    return stage;
+}
+
+void profile_record(ProfileSeries *series, double ms)
+{
+    series->samples[series->count % PROFILE_SAMPLES] = ms;
+    ++series->count;
+}
+
+void profile_cpu(Profiler *profiler, const char *name, double seconds)
+{
+    ProfileStage *stage = profile_stage(profiler, name);
+    if (stage != NULL)
+        profile_record(&stage->cpu, 1e3 * seconds);
+}
+
+void profile_gpu_begin(Profiler *profiler, const char *name)
+{
+    ProfileStage *stage = profile_stage(profiler, name);
+    if (stage == NULL || profiler->active_query != NULL || stage->issued - stage->resolved == PROFILE_QUERIES)
+        return;
+    if (stage->issued == 0)
+        glGenQueries(PROFILE_QUERIES, stage->queries);
+    glBeginQuery(GL_TIME_ELAPSED, stage->queries[stage->issued % PROFILE_QUERIES]);
+    profiler->active_query = stage;
+}
+
+void profile_gpu_end(Profiler *profiler)
+{
+    if (profiler->active_query == NULL)
+        return;
+    glEndQuery(GL_TIME_ELAPSED);
+    ++profiler->active_query->issued;
+    profiler->active_query = NULL;
+}
+
+int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+/* Fills p[0..2] with p50, p95 and p99; returns false if there are no samples */
+bool profile_percentiles(const ProfileSeries *series, double p[3])
+{
+    size_t n = series->count < PROFILE_SAMPLES ? series->count : PROFILE_SAMPLES;
+    if (n == 0)
+        return false;
+    double sorted[PROFILE_SAMPLES];
+    memcpy(sorted, series->samples, n * sizeof(double));
+    qsort(sorted, n, sizeof(double), compare_doubles);
+    p[0] = sorted[(n - 1) * 50 / 100];
+    p[1] = sorted[(n - 1) * 95 / 100];
+    p[2] = sorted[(n - 1) * 99 / 100];
+    return true;
+}
+
+void profile_dump_series(FILE *file, const char *key, const ProfileSeries *series)
+{
+    double p[3];
+    if (profile_percentiles(series, p))
+        fprintf(file, "\"%s\": {\"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f}", key, p[0], p[1], p[2]);
+    else
+        fprintf(file, "\"%s\": null", key);
+}
+
+const char profile_overlay_fragment_shader_source[] =
+    "#version 330 core\n"
+    "out vec4 FragColor;\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "    FragColor = vec4(0.9f, 0.9f, 0.9f, 0.8f);\n"
+    "}\n\0";
+
+/* Rebuilds the bar mesh: per stage, a CPU bar and a thinner GPU bar below it */
+void profile_build_overlay(Profiler *profiler)
+{
+    size_t n = profiler->num_stages;
+    Mesh *mesh = &profiler->overlay.mesh;
+    delete_Mesh(mesh);
+    *mesh = new_Mesh(8 * n, 12 * n);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        double cpu[3] = {0}, gpu[3] = {0};
+        profile_percentiles(&profiler->stages[i].cpu, cpu);
+        profile_percentiles(&profiler->stages[i].gpu, gpu);
+        float top = 0.98f - 0.05f * i;
+        float bars[2][3] = {
+            {min(cpu[0] / PROFILE_SCALE_MS, 1), top, top - 0.03f},
+            {min(gpu[0] / PROFILE_SCALE_MS, 1), top - 0.03f, top - 0.04f},
+        };
+        for (size_t b = 0; b < 2; ++b)
+        {
+            vec3 *v = &mesh->vertices[8 * i + 4 * b];
+            uint *idx = &mesh->indices[12 * i + 6 * b];
+            uint base = 8 * i + 4 * b;
+            float right = -0.98f + 0.6f * bars[b][0];
+            v[0] = (vec3) {-0.98f, bars[b][2], 0};
+            v[1] = (vec3) {-0.98f, bars[b][1], 0};
+            v[2] = (vec3) {right, bars[b][1], 0};
+            v[3] = (vec3) {right, bars[b][2], 0};
+            uint quad[6] = {base, base + 1, base + 2, base + 2, base + 3, base};
+            memcpy(idx, quad, sizeof(quad));
+        }
+    }
+
+    if (!profiler->overlay_ready)
+    {
+        profiler->overlay.vertex_shader_source = strdup(plot_vertex_shader_source);
+        profiler->overlay.fragment_shader_source = strdup(profile_overlay_fragment_shader_source);
+        setup(&profiler->overlay);
+        profiler->overlay_ready = true;
+    }
+    else
+    {
+        upload(&profiler->overlay, GL_DYNAMIC_DRAW);
+    }
+}
+
+/* Call once per loop pass, after waiting for events: the frame time starts here, not at the last swap */
+void profile_frame_begin(Profiler *profiler)
+{
+    profiler->frame_start = now_seconds();
+}
+
+/*
+ * Call once per frame, before swapping buffers: collects finished GPU
+ * queries, records the frame time since profile_frame_begin(), and once a
+ * second refreshes the overlay, the window title and the dump. Also draws
+ * the overlay.
+ */
+void profile_frame(Profiler *profiler, GLFWwindow *window)
+{
+    double now = now_seconds();
+    profile_cpu(profiler, "frame", now - profiler->frame_start);
+
+    for (size_t i = 0; i < profiler->num_stages; ++i)
+    {
+        ProfileStage *stage = &profiler->stages[i];
+        while (stage->resolved < stage->issued)
+        {
+            uint query = stage->queries[stage->resolved % PROFILE_QUERIES];
+            GLint available = 0;
+            glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                break;
+            GLuint64 ns;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+            profile_record(&stage->gpu, ns * 1e-6);
+            ++stage->resolved;
+        }
+    }
+
+    if (now - profiler->last_report >= 1.0)
+    {
+        profiler->last_report = now;
+        profile_build_overlay(profiler);
+
+        /* No "frame" stage if the table filled before the first frame was timed */
+        double p[3];
+        ProfileStage *frame = profile_stage(profiler, "frame");
+        if (frame != NULL && profile_percentiles(&frame->cpu, p))
+        {
+            char title[128];
+            snprintf(title, sizeof(title), "plot | frame p50 %.2f ms, p95 %.2f ms, p99 %.2f ms", p[0], p[1], p[2]);
+            glfwSetWindowTitle(window, title);
+        }
+
+        if (profiler->dump != NULL)
+        {
+            fprintf(profiler->dump, "{\"time\": %.3f, \"stages\": [", glfwGetTime());
+            for (size_t i = 0; i < profiler->num_stages; ++i)
+            {
+                fprintf(profiler->dump, "%s{\"name\": \"%s\", ", i ? ", " : "", profiler->stages[i].name);
+                profile_dump_series(profiler->dump, "cpu_ms", &profiler->stages[i].cpu);
+                fprintf(profiler->dump, ", ");
+                profile_dump_series(profiler->dump, "gpu_ms", &profiler->stages[i].gpu);
+                fprintf(profiler->dump, "}");
+            }
+            PoolStats pool = pool_stats(&mesh_pool);
+            fprintf(profiler->dump, "], \"mesh_pool\": {\"frame_allocations\": %zu, \"allocations\": %zu, "
+                    "\"bytes_in_use\": %zu, \"peak_bytes\": %zu}}\n", pool.frame_allocations,
+                    pool.allocations, pool.bytes_in_use, pool.peak_bytes);
+            fflush(profiler->dump);
+        }
+    }
+
+    if (profiler->overlay_ready)
+    {
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        draw(&profiler->overlay);
+        glDisable(GL_BLEND);
+    }
+}
+
+void profile_close(Profiler *profiler)
+{
+    if (profiler->dump != NULL)
+        fclose(profiler->dump);
+    for (size_t i = 0; i < profiler->num_stages; ++i)
+        if (profiler->stages[i].issued > 0)
+            glDeleteQueries(PROFILE_QUERIES, profiler->stages[i].queries);
+    if (profiler->overlay_ready)
+    {
+        delete_GameObject(&profiler->overlay);
+    }
+}
+
+#define PROFILE_CPU(profiler, name, ...)                        \
+    do                                                          \
+    {                                                           \
+        double profile_start_ = now_seconds();                  \
+        __VA_ARGS__;                                            \
+        profile_cpu(profiler, name, now_seconds() - profile_start_); \
+    } while (0)
+
+#define PROFILE_DRAW(profiler, name, ...)                       \
+    do                                                          \
+    {                                                           \
+        double profile_start_ = now_seconds();                  \
+        profile_gpu_begin(profiler, name);                      \
+        __VA_ARGS__;                                            \
+        profile_gpu_end(profiler);                              \
+        profile_cpu(profiler, name, now_seconds() - profile_start_); \
+    } while (0)
+
+#else
+
+typedef struct Profiler
+{
+    char unused;
+} Profiler;
+
+void profile_open(Profiler *profiler, const char *dump_filename) {}
+void profile_cpu(Profiler *profiler, const char *name, double seconds) {}
+void profile_frame_begin(Profiler *profiler) {}
+void profile_frame(Profiler *profiler, GLFWwindow *window) {}
+void profile_close(Profiler *profiler) {}
+
+#define PROFILE_CPU(profiler, name, ...) do { __VA_ARGS__; } while (0)
+#define PROFILE_DRAW(profiler, name, ...) do { __VA_ARGS__; } while (0)
+
+#endif
+
+#endif
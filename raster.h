@@ -0,0 +1,245 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mathlib.h"
+#include "mesh.h"
+#include "threads.h"
+
+/*
+ * Software rasteriser for the same meshes the GL path draws, for machines
+ * with no GL driver at all. It follows GL's conventions so the two outputs
+ * compare pixel for pixel up to edge rounding:
+ *
+ * - vertices are NDC and mapped with the full-framebuffer viewport
+ * - a pixel is covered when its centre is inside the triangle, with the
+ *   top-left rule deciding centres that lie exactly on an edge
+ * - colours are converted to bytes as round(255 * c)
+ * - rows are stored bottom-up, as glReadPixels returns them
+ *
+ * Drawing is two parallel passes. Triangle setup splits the index buffer
+ * across threads; each thread computes edge equations and bins triangles
+ * into private per-tile lists. The tile pass then hands whole tiles to
+ * threads, which walk every thread's list for that tile in order, so draw
+ * order is preserved without any locking. Edge functions are evaluated for
+ * RASTER_LANES pixels of a row at once with GCC vector extensions.
+ */
+
+#define RASTER_TILE 64
+#define RASTER_LANES 8
+
+typedef float lanes_f __attribute__((vector_size(RASTER_LANES * sizeof(float))));
+typedef int32_t lanes_i __attribute__((vector_size(RASTER_LANES * sizeof(int32_t))));
+
+typedef struct Framebuffer
+{
+    int width, height;
+    uint8_t *pixels;
+} Framebuffer;
+
+void init_Framebuffer(Framebuffer *fb, int width, int height)
+{
+    fb->width = width;
+    fb->height = height;
+    fb->pixels = malloc((size_t) width * height * 4);
+}
+
+void delete_Framebuffer(Framebuffer *fb)
+{
+    free(fb->pixels);
+    fb->pixels = NULL;
+}
+
+uint32_t pack_color(vec4 color)
+{
+    uint8_t rgba[4] = {
+        clamp(color.x, 1, 0) * 255 + 0.5f,
+        clamp(color.y, 1, 0) * 255 + 0.5f,
+        clamp(color.z, 1, 0) * 255 + 0.5f,
+        clamp(color.w, 1, 0) * 255 + 0.5f,
+    };
+    uint32_t packed;
+    memcpy(&packed, rgba, 4);
+    return packed;
+}
+
+void clear_Framebuffer(Framebuffer *fb, vec4 color)
+{
+    uint32_t packed = pack_color(color);
+    uint32_t *pixels = (uint32_t *) fb->pixels;
+    for (size_t i = 0; i < (size_t) fb->width * fb->height; ++i)
+        pixels[i] = packed;
+}
+
+/* Edge i is covered where a[i] * x + b[i] * y + c[i] passes its test */
+typedef struct RasterTriangle
+{
+    float a[3], b[3], c[3];
+    bool top_left[3];
+    int xmin, ymin, xmax, ymax;
+} RasterTriangle;
+
+typedef struct RasterBin
+{
+    uint *items;
+    size_t count, capacity;
+} RasterBin;
+
+typedef struct Rasterizer
+{
+    Framebuffer *fb;
+    const Mesh *mesh;
+    uint32_t color;
+    size_t num_threads, tiles_x, tiles_y;
+    RasterTriangle *triangles;
+    RasterBin *bins; /* num_threads * tiles_x * tiles_y, thread-major */
+    size_t next_tile;
+} Rasterizer;
+
+void bin_push(RasterBin *bin, uint item)
+{
+    if (bin->count == bin->capacity)
+    {
+        bin->capacity = bin->capacity ? 2 * bin->capacity : 64;
+        bin->items = realloc(bin->items, bin->capacity * sizeof(uint));
+    }
+    bin->items[bin->count++] = item;
+}
+
+/* Returns false for triangles that are degenerate or miss the framebuffer */
+bool setup_triangle(RasterTriangle *tri, vec3 v0, vec3 v1, vec3 v2, int width, int height)
+{
+    float x[3] = {(v0.x + 1) * 0.5f * width, (v1.x + 1) * 0.5f * width, (v2.x + 1) * 0.5f * width};
+    float y[3] = {(v0.y + 1) * 0.5f * height, (v1.y + 1) * 0.5f * height, (v2.y + 1) * 0.5f * height};
+
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (area == 0 || area != area)
+        return false;
+    float sign = area > 0 ? 1 : -1;
+
+    /* Pixel centres are at +0.5, so these bounds are inclusive pixel indices */
+    tri->xmin = max(0, ceilf(min(x[0], min(x[1], x[2])) - 0.5f));
+    tri->ymin = max(0, ceilf(min(y[0], min(y[1], y[2])) - 0.5f));
+    tri->xmax = min(width - 1, floorf(max(x[0], max(x[1], x[2])) - 0.5f));
+    tri->ymax = min(height - 1, floorf(max(y[0], max(y[1], y[2])) - 0.5f));
+    if (tri->xmin > tri->xmax || tri->ymin > tri->ymax)
+        return false;
+
+    for (int i = 0; i < 3; ++i)
+    {
+        int j = (i + 1) % 3;
+        float dx = x[j] - x[i], dy = y[j] - y[i];
+        tri->a[i] = -dy * sign;
+        tri->b[i] = dx * sign;
+        tri->c[i] = (dy * x[i] - dx * y[i]) * sign;
+        /* y grows upwards here, so a "top" edge runs leftwards in CCW order */
+        tri->top_left[i] = (dy * sign == 0 && dx * sign < 0) || dy * sign < 0;
+    }
+    return true;
+}
+
+void raster_setup(void *ctx, size_t thread, size_t begin, size_t end)
+{
+    Rasterizer *r = ctx;
+    const Mesh *mesh = r->mesh;
+    size_t num_tiles = r->tiles_x * r->tiles_y;
+    RasterBin *bins = &r->bins[thread * num_tiles];
+    for (size_t t = begin; t < end; ++t)
+    {
+        const uint *idx = &mesh->indices[3 * t];
+        if (idx[0] >= mesh->num_vertices || idx[1] >= mesh->num_vertices || idx[2] >= mesh->num_vertices)
+            continue;
+        RasterTriangle *tri = &r->triangles[t];
+        if (!setup_triangle(tri, mesh->vertices[idx[0]], mesh->vertices[idx[1]], mesh->vertices[idx[2]],
+                            r->fb->width, r->fb->height))
+            continue;
+        for (int ty = tri->ymin / RASTER_TILE; ty <= tri->ymax / RASTER_TILE; ++ty)
+            for (int tx = tri->xmin / RASTER_TILE; tx <= tri->xmax / RASTER_TILE; ++tx)
+                bin_push(&bins[ty * r->tiles_x + tx], t);
+    }
+}
+
+void raster_triangle(Rasterizer *r, const RasterTriangle *tri, int x0, int y0, int x1, int y1)
+{
+    const lanes_f offsets = {0, 1, 2, 3, 4, 5, 6, 7};
+    uint32_t *pixels = (uint32_t *) r->fb->pixels;
+    int width = r->fb->width;
+    x0 = x0 > tri->xmin ? x0 : tri->xmin;
+    y0 = y0 > tri->ymin ? y0 : tri->ymin;
+    x1 = x1 < tri->xmax ? x1 : tri->xmax;
+    y1 = y1 < tri->ymax ? y1 : tri->ymax;
+
+    for (int y = y0; y <= y1; ++y)
+    {
+        float py = y + 0.5f;
+        for (int x = x0; x <= x1; x += RASTER_LANES)
+        {
+            lanes_f px = offsets + (x + 0.5f);
+            lanes_f e0 = tri->a[0] * px + (tri->b[0] * py + tri->c[0]);
+            lanes_f e1 = tri->a[1] * px + (tri->b[1] * py + tri->c[1]);
+            lanes_f e2 = tri->a[2] * px + (tri->b[2] * py + tri->c[2]);
+            lanes_i inside = (tri->top_left[0] ? e0 >= 0 : e0 > 0)
+                & (tri->top_left[1] ? e1 >= 0 : e1 > 0)
+                & (tri->top_left[2] ? e2 >= 0 : e2 > 0);
+            uint32_t *row = &pixels[(size_t) y * width];
+            int count = x1 - x + 1 < RASTER_LANES ? x1 - x + 1 : RASTER_LANES;
+            for (int i = 0; i < count; ++i)
+                if (inside[i])
+                    row[x + i] = r->color;
+        }
+    }
+}
+
+void raster_tiles(void *ctx, size_t thread, size_t begin, size_t end)
+{
+    Rasterizer *r = ctx;
+    size_t num_tiles = r->tiles_x * r->tiles_y;
+    size_t tile;
+    while ((tile = __atomic_fetch_add(&r->next_tile, 1, __ATOMIC_RELAXED)) < num_tiles)
+    {
+        int x0 = (tile % r->tiles_x) * RASTER_TILE;
+        int y0 = (tile / r->tiles_x) * RASTER_TILE;
+        int x1 = x0 + RASTER_TILE - 1;
+        int y1 = y0 + RASTER_TILE - 1;
+        for (size_t k = 0; k < r->num_threads; ++k)
+        {
+            RasterBin *bin = &r->bins[k * num_tiles + tile];
+            for (size_t i = 0; i < bin->count; ++i)
+                raster_triangle(r, &r->triangles[bin->items[i]], x0, y0, x1, y1);
+        }
+    }
+}
+
+/* Fills every triangle of `mesh` with a solid colour; num_threads 0 uses every core */
+void rasterize(Framebuffer *fb, const Mesh *mesh, vec4 color, size_t num_threads)
+{
+    size_t num_triangles = mesh->num_indices / 3;
+    if (num_triangles == 0)
+        return;
+    if (num_threads == 0)
+        num_threads = num_cores();
+
+    Rasterizer r;
+    r.fb = fb;
+    r.mesh = mesh;
+    r.color = pack_color(color);
+    r.num_threads = num_threads;
+    r.tiles_x = (fb->width + RASTER_TILE - 1) / RASTER_TILE;
+    r.tiles_y = (fb->height + RASTER_TILE - 1) / RASTER_TILE;
+    r.triangles = malloc(num_triangles * sizeof(RasterTriangle));
+    r.bins = calloc(num_threads * r.tiles_x * r.tiles_y, sizeof(RasterBin));
+    r.next_tile = 0;
+
+    parallel_for(num_threads, num_triangles, raster_setup, &r);
+    parallel_for(num_threads, num_threads, raster_tiles, &r);
+
+    for (size_t i = 0; i < num_threads * r.tiles_x * r.tiles_y; ++i)
+        free(r.bins[i].items);
+    free(r.bins);
+    free(r.triangles);
+}
+
+#endif
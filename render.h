@@ -0,0 +1,240 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "mesh.h"
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+const char plot_vertex_shader_source[] =
+    "#version 330 core\n"
+    "layout (location = 0) in vec3 aPos;\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "   gl_Position = vec4(aPos.x, aPos.y, aPos.z, 1.0);\n"
+    "}\n\0";
+const char plot_fragment_shader_source[] =
+    "#version 330 core\n"
+    "out vec4 FragColor;\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "    FragColor = vec4(1.0f, 0.5f, 0.2f, 1.0f);\n"
+    "}\n\0";
+
+/* `dirty` is set whenever the GPU copy of the mesh changes and cleared by draw() */
+typedef struct GameObject
+{
+    uint program, VAO, VBO, EBO;
+    char *vertex_shader_source;
+    char *fragment_shader_source;
+    Mesh mesh;
+    bool dirty;
+} GameObject;
+
+/*
+ * Event-driven redraw: the render loop sleeps in glfwWaitEventsTimeout() and
+ * only draws when something asked for it. request_redraw() is safe to call
+ * from any thread; it wakes the loop with an empty event.
+ */
+bool redraw_requested = true;
+
+void request_redraw(void)
+{
+    __atomic_store_n(&redraw_requested, true, __ATOMIC_RELEASE);
+    glfwPostEmptyEvent();
+}
+
+/* True if a redraw was requested or any object in the scene is dirty; clears the request */
+bool needs_redraw(size_t n, GameObject *scene[n])
+{
+    bool redraw = __atomic_exchange_n(&redraw_requested, false, __ATOMIC_ACQ_REL);
+    for (size_t i = 0; i < n; ++i)
+        redraw = redraw || scene[i]->dirty;
+    return redraw;
+}
+
+uint setup_shader_program(const char *vertex_shader_source, const char *fragment_shader_source)
+{
+    /*
+     * 1. Compile vertex shader
+     * 2. Compile fragment shader
+     * 3. Compile shader program
+     * 4. Delete shaders
+     */
+    int success;
+    char log[512];
+
+    /* Vertex Shader */
+    unsigned int vertex_shader;
+    vertex_shader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertex_shader, 1, &vertex_shader_source, NULL);
+    glCompileShader(vertex_shader);
+    glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &success);
+    if (!success)
+    {
+        glGetShaderInfoLog(vertex_shader, 512, NULL, log);
+        printf("error compiling vertex shader: %s\n", log);
+        return -1;
+    }
+
+    /* Fragment Shader */
+    unsigned int fragment_shader;
+    fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragment_shader, 1, &fragment_shader_source, NULL);
+    glCompileShader(fragment_shader);
+    glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &success);
+    if (!success)
+    {
+        glGetShaderInfoLog(fragment_shader, 512, NULL, log);
+        printf("error compiling fragment shader: %s\n", log);
+        return -1;
+    }
+
+    /* Shader Program */
+    unsigned int shader_program;
+    shader_program = glCreateProgram();
+    glAttachShader(shader_program, vertex_shader);
+    glAttachShader(shader_program, fragment_shader);
+    glLinkProgram(shader_program);
+    glGetProgramiv(shader_program, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        glGetProgramInfoLog(shader_program, 512, NULL, log);
+        printf("error linking shader program: %s\n", log);
+        return -1;
+    }
+    glDeleteShader(vertex_shader);
+    glDeleteShader(fragment_shader);
+
+    return shader_program;
+}
+
+void setup(GameObject *rend)
+{
+    /*
+     * 1. Compile program
+     * 2. Bind VAO
+     * 3. Copy our vertices into a VBO
+     * 4. Copy Index array into an EBO
+     * 5. Set the VAPs
+     * 6. Unbind objects
+     */
+    rend->program = setup_shader_program(rend->vertex_shader_source, rend->fragment_shader_source);
+
+    glGenVertexArrays(1, &rend->VAO);
+    glBindVertexArray(rend->VAO);
+
+    glGenBuffers(1, &rend->VBO);
+    glBindBuffer(GL_ARRAY_BUFFER, rend->VBO);
+    glBufferData(GL_ARRAY_BUFFER, rend->mesh.num_vertices * sizeof(vec3), rend->mesh.vertices, GL_STATIC_DRAW);
+
+    glGenBuffers(1, &rend->EBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, rend->EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, rend->mesh.num_indices * sizeof(uint), rend->mesh.indices, GL_STATIC_DRAW);
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_TRUE, sizeof(vec3), (void *)0);
+    glEnableVertexAttribArray(0);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0); /* Unbind VBO */
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0); /* Unbind EBO */
+    rend->dirty = true;
+}
+
+/* Replaces the contents of an already set up object's buffers with its current mesh */
+void upload(GameObject *rend, GLenum usage)
+{
+    glBindVertexArray(rend->VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, rend->VBO);
+    glBufferData(GL_ARRAY_BUFFER, rend->mesh.num_vertices * sizeof(vec3), rend->mesh.vertices, usage);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, rend->EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, rend->mesh.num_indices * sizeof(uint), rend->mesh.indices, usage);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0); /* Unbind VBO */
+    rend->dirty = true;
+}
+
+void draw(GameObject *rend)
+{
+    glUseProgram(rend->program);
+    glBindVertexArray(rend->VAO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, rend->EBO);
+
+    glDrawElements(GL_TRIANGLES, rend->mesh.num_indices, GL_UNSIGNED_INT, 0);
+
+    glBindVertexArray(0);
+    glUseProgram(0);
+    rend->dirty = false;
+}
+
+void delete_GameObject(GameObject *rend)
+{
+
+
+    delete_Mesh(&rend->mesh);
+    glDeleteProgram(rend->program);
+    glDeleteVertexArrays(1, &rend->VAO);
+    glDeleteBuffers(2, (uint[]){rend->VBO, rend->EBO});
+}
+
+/*
+ * Opens a visible window and makes its context current. With `share`, the
+ * new context shares buffers, textures and shader programs with that
+ * window's, though not VAOs or framebuffers, which are per context. GLFW
+ * must be started first, with start_glfw().
+ */
+GLFWwindow *open_window(const char *title, int width, int height, GLFWwindow *share)
+{
+    GLFWwindow *window = glfwCreateWindow(width, height, title, NULL, share);
+    if (window == NULL)
+    {
+        printf("Failed to create GLFW window\n");
+        glfwTerminate();
+        exit(-1);
+    }
+    glfwMakeContextCurrent(window);
+
+    /* Every context is 3.3 core from the same driver, so the entry points loaded for the first serve all */
+    if (share == NULL && !gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        printf("Failed to initialize GLAD\n");
+        exit(-1);
+    }
+    glViewport(0, 0, width, height);
+    return window;
+}
+
+/* Initialises GLFW for 3.3 core contexts */
+void start_glfw(void)
+{
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+}
+
+GLFWwindow *init_glfw(GLFWframebuffersizefun framebuffer_size_callback)
+{
+    /*
+     * 1. Initialize GLFW
+     * 2. Set configuration
+     * 3. Create window and initialize GLAD
+     * 4. Setup the resize callback
+     */
+    printf("Starting\n");
+
+    start_glfw();
+    GLFWwindow *window = open_window("plot", 800, 600, NULL);
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+
+    printf("Done starting\n");
+
+    return window;
+}
+
+#endif
@@ -0,0 +1,223 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mathlib.h"
+#include "threads.h"
+
+/*
+ * Adaptive sampling of y = f(x) over the visible range.
+ *
+ * The range is cut into one interval per SAMPLER_INITIAL_PIXELS pixels, and
+ * each interval is split in half for as long as the polyline through its
+ * ends and midpoint misses f at the quarter points by more than `tolerance`
+ * pixels vertically, down to SAMPLER_MIN_PIXELS wide. An accepted interval
+ * contributes its start, plus its midpoint unless that lies on the chord
+ * too, so flat stretches cost one point per initial interval and curved or
+ * steep ones get as many as the tolerance asks for. Values that are not
+ * finite (poles, log of negatives) are refined to the minimum width and then
+ * left out.
+ *
+ * Initial intervals are shared out between threads in order, each refining
+ * into its own buffer, and the buffers are concatenated. Since everything is
+ * relative to the view, callers resample on every pan or zoom and only ever
+ * pay for what is on screen.
+ */
+
+#define SAMPLER_INITIAL_PIXELS 16
+#define SAMPLER_MIN_PIXELS (1.0 / 16)
+#define SAMPLER_MAX_DEPTH 24
+
+typedef double (*PlotFunction)(void *ctx, double x);
+
+/* Visible data range and its size on screen */
+typedef struct View
+{
+    double x0, x1, y0, y1;
+    int width, height;
+} View;
+
+/* Built-in functions, the ones exp.py and quad.py used to tabulate and a few harder ones */
+
+double function_exp(void *ctx, double x)
+{
+    return exp(x) / exp(1);
+}
+
+double function_quad(void *ctx, double x)
+{
+    return x * x;
+}
+
+double function_runge(void *ctx, double x)
+{
+    return 1 / (1 + 25 * x * x);
+}
+
+double function_tanh(void *ctx, double x)
+{
+    return tanh(50 * x);
+}
+
+double function_chirp(void *ctx, double x)
+{
+    return sin(1 / (x + 1.05));
+}
+
+typedef struct NamedFunction
+{
+    const char *name;
+    PlotFunction function;
+} NamedFunction;
+
+NamedFunction builtin_functions[] = {
+    {"exp", function_exp},
+    {"quad", function_quad},
+    {"runge", function_runge},
+    {"tanh", function_tanh},
+    {"chirp", function_chirp},
+};
+
+/* NULL if there is no built-in function called `name` */
+PlotFunction find_function(const char *name)
+{
+    for (size_t i = 0; i < sizeof(builtin_functions) / sizeof(builtin_functions[0]); ++i)
+        if (strcmp(builtin_functions[i].name, name) == 0)
+            return builtin_functions[i].function;
+    return NULL;
+}
+
+/* Sampling */
+
+typedef struct SampleBuffer
+{
+    vec3 *points;
+    size_t count, capacity;
+} SampleBuffer;
+
+void sample_push(SampleBuffer *buffer, double x, double y)
+{
+    if (!isfinite(y))
+        return;
+    if (buffer->count == buffer->capacity)
+    {
+        buffer->capacity = buffer->capacity ? 2 * buffer->capacity : 256;
+        buffer->points = realloc(buffer->points, buffer->capacity * sizeof(vec3));
+    }
+    buffer->points[buffer->count++] = (vec3) {x, y, 0};
+}
+
+typedef struct Sampler
+{
+    PlotFunction function;
+    void *ctx;
+    View view;
+    double tolerance;      /* in pixels */
+    double y_pixels;       /* pixels per unit of y */
+    double min_width;      /* narrowest interval, in units of x */
+    size_t num_intervals;
+    SampleBuffer *buffers; /* one per thread */
+} Sampler;
+
+/* Refines [a, b] with midpoint m, emitting every point but b */
+void sample_refine(Sampler *sampler, SampleBuffer *out, double a, double fa, double m, double fm, double b, double fb,
+                   size_t depth)
+{
+    double q1 = 0.5 * (a + m), q3 = 0.5 * (m + b);
+    double fq1 = sampler->function(sampler->ctx, q1), fq3 = sampler->function(sampler->ctx, q3);
+    double error = fmax(fabs(fq1 - 0.5 * (fa + fm)), fabs(fq3 - 0.5 * (fm + fb))) * sampler->y_pixels;
+
+    /* Written so that NaN errors refine too */
+    if (!(error <= sampler->tolerance) && depth < SAMPLER_MAX_DEPTH && b - a > sampler->min_width)
+    {
+        sample_refine(sampler, out, a, fa, q1, fq1, m, fm, depth + 1);
+        sample_refine(sampler, out, m, fm, q3, fq3, b, fb, depth + 1);
+        return;
+    }
+    sample_push(out, a, fa);
+    if (!(fabs(fm - 0.5 * (fa + fb)) * sampler->y_pixels <= sampler->tolerance))
+        sample_push(out, m, fm);
+}
+
+void sample_intervals(void *ctx, size_t thread, size_t begin, size_t end)
+{
+    Sampler *sampler = ctx;
+    SampleBuffer *out = &sampler->buffers[thread];
+    double x0 = sampler->view.x0, dx = (sampler->view.x1 - x0) / sampler->num_intervals;
+    double a = x0 + begin * dx, fa = sampler->function(sampler->ctx, a);
+    for (size_t i = begin; i < end; ++i)
+    {
+        double b = i + 1 == sampler->num_intervals ? sampler->view.x1 : x0 + (i + 1) * dx;
+        double m = 0.5 * (a + b);
+        double fm = sampler->function(sampler->ctx, m), fb = sampler->function(sampler->ctx, b);
+        sample_refine(sampler, out, a, fa, m, fm, b, fb, 0);
+        a = b;
+        fa = fb;
+    }
+}
+
+/*
+ * Samples `function` over [view.x0, view.x1] to within `tolerance` pixels of
+ * the view; returns the points (malloc'd, in data units) and sets *n.
+ * num_threads 0 uses every core.
+ */
+vec3 *sample_function(PlotFunction function, void *ctx, View view, double tolerance, size_t num_threads, size_t *n)
+{
+    if (num_threads == 0)
+        num_threads = num_cores();
+    Sampler sampler = {function, ctx, view, tolerance};
+    sampler.y_pixels = view.height / (view.y1 - view.y0);
+    sampler.min_width = SAMPLER_MIN_PIXELS * (view.x1 - view.x0) / view.width;
+    sampler.num_intervals = view.width / SAMPLER_INITIAL_PIXELS > 0 ? view.width / SAMPLER_INITIAL_PIXELS : 1;
+    if (num_threads > sampler.num_intervals)
+        num_threads = sampler.num_intervals;
+    sampler.buffers = calloc(num_threads, sizeof(SampleBuffer));
+
+    parallel_for(num_threads, sampler.num_intervals, sample_intervals, &sampler);
+
+    size_t total = 1;
+    for (size_t t = 0; t < num_threads; ++t)
+        total += sampler.buffers[t].count;
+    vec3 *points = malloc(total * sizeof(vec3));
+    *n = 0;
+    for (size_t t = 0; t < num_threads; ++t)
+    {
+        memcpy(&points[*n], sampler.buffers[t].points, sampler.buffers[t].count * sizeof(vec3));
+        *n += sampler.buffers[t].count;
+        free(sampler.buffers[t].points);
+    }
+    free(sampler.buffers);
+
+    double last = function(ctx, view.x1);
+    if (isfinite(last))
+        points[(*n)++] = (vec3) {view.x1, last, 0};
+    return points;
+}
+
+/* n points evenly spaced over [x0, x1], as np.linspace did */
+vec3 *sample_uniform(PlotFunction function, void *ctx, double x0, double x1, size_t n)
+{
+    vec3 *points = malloc(n * sizeof(vec3));
+    for (size_t i = 0; i < n; ++i)
+    {
+        double x = n > 1 ? x0 + (x1 - x0) * i / (n - 1) : x0;
+        points[i] = (vec3) {x, function(ctx, x), 0};
+    }
+    return points;
+}
+
+/* Maps points from the view's data range to normalised device coordinates, in place */
+void view_to_ndc(View view, size_t n, vec3 points[n])
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        points[i].x = 2 * (points[i].x - view.x0) / (view.x1 - view.x0) - 1;
+        points[i].y = 2 * (points[i].y - view.y0) / (view.y1 - view.y0) - 1;
+    }
+}
+
+#endif
@@ -0,0 +1,183 @@
+#ifndef SCALE_H
+#define SCALE_H
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "mathlib.h"
+
+/*
+ * Axis scales: linear, log10, ln and symlog, applied per axis to raw data
+ * values. The GPU paths that draw raw points (density plots and the
+ * polylines of polyline.h) apply them in the vertex shader from uniforms,
+ * through AXIS_SCALE_GLSL, so switching scale only changes a uniform and
+ * the View, which is kept in scaled units so that panning and zooming stay
+ * linear on screen. The CPU functions here convert views and bounds.
+ *
+ * symlog is sign(v) log10(1 + |v| / threshold): linear within about the
+ * threshold of zero and logarithmic beyond, defined for every value. log10
+ * and ln are only defined for v > 0; other values are left out of the plot.
+ */
+
+#define SCALE_THRESHOLD 1.0
+
+typedef enum ScaleType
+{
+    SCALE_LINEAR,
+    SCALE_LOG10,
+    SCALE_LN,
+    SCALE_SYMLOG,
+} ScaleType;
+
+typedef struct Scale
+{
+    ScaleType type;
+    double threshold; /* symlog only */
+} Scale;
+
+const char *scale_names[] = {"linear", "log10", "ln", "symlog"};
+
+/* The same functions as scale_forward() for the vertex shaders; type is a ScaleType */
+#define AXIS_SCALE_GLSL                                                             \
+    "float axis_scale(float v, int type, float threshold)\n"                      \
+    "{\n"                                                                         \
+    "    if (type == 1)\n"                                                        \
+    "        return log(v) * 0.4342944819;\n"                                     \
+    "    if (type == 2)\n"                                                        \
+    "        return log(v);\n"                                                    \
+    "    if (type == 3)\n"                                                        \
+    "        return sign(v) * log(1.0 + abs(v) / threshold) * 0.4342944819;\n"    \
+    "    return v;\n"                                                             \
+    "}\n"                                                                         \
+    "bool axis_valid(float v, int type)\n"                                        \
+    "{\n"                                                                         \
+    "    return (type != 1 && type != 2) || v > 0.0;\n"                           \
+    "}\n"
+
+/* Reads "linear", "log10", "ln" or "symlog"; false for anything else */
+bool parse_scale(const char *name, Scale *scale)
+{
+    for (ScaleType type = SCALE_LINEAR; type <= SCALE_SYMLOG; ++type)
+    {
+        if (strcmp(name, scale_names[type]) == 0)
+        {
+            *scale = (Scale) {type, SCALE_THRESHOLD};
+            return true;
+        }
+    }
+    return false;
+}
+
+bool scale_valid(Scale scale, double v)
+{
+    return (scale.type != SCALE_LOG10 && scale.type != SCALE_LN) || v > 0;
+}
+
+double scale_forward(Scale scale, double v)
+{
+    switch (scale.type)
+    {
+    case SCALE_LOG10:
+        return log10(v);
+    case SCALE_LN:
+        return log(v);
+    case SCALE_SYMLOG:
+        return copysign(log10(1 + fabs(v) / scale.threshold), v);
+    default:
+        return v;
+    }
+}
+
+double scale_inverse(Scale scale, double s)
+{
+    switch (scale.type)
+    {
+    case SCALE_LOG10:
+        return pow(10, s);
+    case SCALE_LN:
+        return exp(s);
+    case SCALE_SYMLOG:
+        return copysign(scale.threshold * (pow(10, fabs(s)) - 1), s);
+    default:
+        return s;
+    }
+}
+
+/* Range of raw values along one axis, with the smallest positive one for log scales */
+typedef struct Extent
+{
+    double min, max, min_positive;
+} Extent;
+
+void point_extents(const vec3 *points, size_t n, Extent *x, Extent *y)
+{
+    *x = *y = (Extent) {INFINITY, -INFINITY, INFINITY};
+    for (size_t i = 0; i < n; ++i)
+    {
+        x->min = points[i].x < x->min ? points[i].x : x->min;
+        x->max = points[i].x > x->max ? points[i].x : x->max;
+        x->min_positive = points[i].x > 0 && points[i].x < x->min_positive ? points[i].x : x->min_positive;
+        y->min = points[i].y < y->min ? points[i].y : y->min;
+        y->max = points[i].y > y->max ? points[i].y : y->max;
+        y->min_positive = points[i].y > 0 && points[i].y < y->min_positive ? points[i].y : y->min_positive;
+    }
+}
+
+/* The same for one column of values */
+void value_extent(const float *values, size_t n, Extent *extent)
+{
+    *extent = (Extent) {INFINITY, -INFINITY, INFINITY};
+    for (size_t i = 0; i < n; ++i)
+    {
+        extent->min = values[i] < extent->min ? values[i] : extent->min;
+        extent->max = values[i] > extent->max ? values[i] : extent->max;
+        extent->min_positive = values[i] > 0 && values[i] < extent->min_positive ? values[i] : extent->min_positive;
+    }
+}
+
+/*
+ * The extent in scaled units, for the view that shows all of it. Empty or
+ * single-valued extents, and log scales of data with nothing positive, get
+ * a range of width 1 (or 2) instead.
+ */
+void scaled_extent(Scale scale, Extent extent, double *s0, double *s1)
+{
+    double v0 = scale_valid(scale, extent.min) ? extent.min : extent.min_positive;
+    *s0 = scale_forward(scale, v0);
+    *s1 = scale_forward(scale, extent.max);
+    if (!isfinite(*s0) || !isfinite(*s1))
+    {
+        *s0 = -1;
+        *s1 = 1;
+    }
+    else if (!(*s1 > *s0))
+    {
+        *s0 -= 0.5;
+        *s1 = *s0 + 1;
+    }
+}
+
+/*
+ * Converts the range [s0, s1] of a view from one scale to another, showing
+ * the same values where the new scale can. A log scale's range starts at
+ * the smallest positive value of the extent instead of at zero or below,
+ * and falls back to the whole extent if nothing in the old range is positive.
+ */
+void rescale_range(Scale from, Scale to, Extent extent, double *s0, double *s1)
+{
+    double v0 = scale_inverse(from, *s0), v1 = scale_inverse(from, *s1);
+    if (!scale_valid(to, v0))
+    {
+        if (!(extent.min_positive < v1))
+        {
+            scaled_extent(to, extent, s0, s1);
+            return;
+        }
+        v0 = extent.min_positive;
+    }
+    *s0 = scale_forward(to, v0);
+    *s1 = scale_forward(to, v1);
+}
+
+#endif
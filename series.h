@@ -0,0 +1,221 @@
+#ifndef SERIES_H
+#define SERIES_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <time.h>
+#include "mesh.h"
+#include "alloc.h"
+#include "timing.h"
+#include "spatial.h"
+#include "stream.h"
+
+/*
+ * Series workers: one thread per plotted file that loads, reduces and meshes
+ * it off the render thread, then publishes the finished mesh through a
+ * triple buffer. The render thread only ever calls series_acquire(), which
+ * never blocks, and uploads whatever it gets; it never waits on parsing or
+ * meshing. With `watch` set the worker polls the file's modification time and
+ * republishes whenever it changes.
+ *
+ * Each slot also keeps the full-resolution points and a spatial index over
+ * them, so the render thread can find the sample under the cursor without
+ * going back to the file or searching the downsampled mesh.
+ *
+ * Triple buffer: three mesh slots. The writer fills `back`, the reader draws
+ * from `front`, and `middle` is swapped atomically between them with a flag
+ * saying whether it holds a mesh the reader has not seen. A slot only returns
+ * to the writer after the reader has moved on to a newer one, so the mesh the
+ * render thread holds is never freed or rewritten underneath it.
+ */
+
+#define TRIPLE_FRESH 4u
+#define SERIES_BUCKETS 4096
+#define SERIES_POLL_NS 100000000L
+
+typedef struct TripleBuffer
+{
+    uint32_t middle;
+    uint32_t back;  /* writer only */
+    uint32_t front; /* reader only */
+} TripleBuffer;
+
+void init_TripleBuffer(TripleBuffer *tb)
+{
+    tb->front = 0;
+    tb->middle = 1;
+    tb->back = 2;
+}
+
+/* Writer: hands `back` over and takes whatever slot was in the middle */
+void triple_publish(TripleBuffer *tb)
+{
+    uint32_t prev = __atomic_exchange_n(&tb->middle, tb->back | TRIPLE_FRESH, __ATOMIC_ACQ_REL);
+    tb->back = prev & 3;
+}
+
+/* Reader: moves to the newest published slot; false if nothing new */
+bool triple_acquire(TripleBuffer *tb)
+{
+    if (!(__atomic_load_n(&tb->middle, __ATOMIC_ACQUIRE) & TRIPLE_FRESH))
+        return false;
+    uint32_t prev = __atomic_exchange_n(&tb->middle, tb->front, __ATOMIC_ACQ_REL);
+    tb->front = prev & 3;
+    return true;
+}
+
+typedef Mesh (*MeshBuilder)(size_t n, vec3 vertices[n], float width);
+
+typedef struct SeriesWorker
+{
+    const char *filename;
+    MeshBuilder builder;
+    float width;
+    bool scaled; /* reduce with downsample_scaled_into(), for drawing under any axis scale */
+    bool watch;
+    void (*on_publish)(void); /* e.g. request_redraw */
+
+    TripleBuffer buffer;
+    Mesh slots[3];
+    vec3 *points[3];
+    SpatialIndex indices[3];
+    double build_seconds[3];
+    pthread_t thread;
+    bool stop;
+} SeriesWorker;
+
+/* Loads, reduces and meshes the file into the back slot; false if it cannot be read */
+bool series_build(SeriesWorker *worker)
+{
+    size_t n;
+    vec3 *points = stream_csv(worker->filename, 0, &n, NULL);
+    if (points == NULL || n < 2)
+    {
+        free(points);
+        return false;
+    }
+
+    vec3 *reduced;
+    size_t m;
+    if (worker->scaled)
+    {
+        reduced = malloc(downsample_scaled_capacity(n, SERIES_BUCKETS) * sizeof(vec3));
+        m = downsample_scaled_into(n, points, SERIES_BUCKETS, reduced);
+    }
+    else
+    {
+        reduced = malloc(downsample_capacity(n, SERIES_BUCKETS) * sizeof(vec3));
+        m = downsample_into(n, points, SERIES_BUCKETS, reduced);
+    }
+
+    uint32_t back = worker->buffer.back;
+    delete_Mesh(&worker->slots[back]);
+    worker->slots[back] = worker->builder(m, reduced, worker->width);
+    free(reduced);
+
+    delete_SpatialIndex(&worker->indices[back]);
+    free(worker->points[back]);
+    worker->points[back] = points;
+    init_SpatialIndex(&worker->indices[back], points, n, 0);
+    return true;
+}
+
+void *series_worker(void *arg)
+{
+    SeriesWorker *worker = arg;
+    struct timespec last_modified = {0, 0};
+    while (!__atomic_load_n(&worker->stop, __ATOMIC_ACQUIRE))
+    {
+        struct stat st;
+        bool found = stat(worker->filename, &st) == 0;
+        bool changed = found
+            && (st.st_mtim.tv_sec != last_modified.tv_sec || st.st_mtim.tv_nsec != last_modified.tv_nsec);
+        if (!found && !worker->watch)
+            printf("error: could not open %s\n", worker->filename);
+        if (changed)
+        {
+            last_modified = st.st_mtim;
+            double t0 = now_seconds();
+            if (series_build(worker))
+            {
+                worker->build_seconds[worker->buffer.back] = now_seconds() - t0;
+                triple_publish(&worker->buffer);
+                if (worker->on_publish != NULL)
+                    worker->on_publish();
+            }
+            else
+            {
+                printf("error: could not load %s\n", worker->filename);
+            }
+        }
+        /* Without watch there is one attempt; with it a missing file is waited for */
+        if (!worker->watch)
+            break;
+        nanosleep(&(struct timespec) {0, SERIES_POLL_NS}, NULL);
+    }
+    return NULL;
+}
+
+void start_SeriesWorker(SeriesWorker *worker, const char *filename, MeshBuilder builder, float width,
+                        bool scaled, bool watch, void (*on_publish)(void))
+{
+    worker->filename = filename;
+    worker->builder = builder;
+    worker->width = width;
+    worker->scaled = scaled;
+    worker->watch = watch;
+    worker->on_publish = on_publish;
+    init_TripleBuffer(&worker->buffer);
+    for (size_t i = 0; i < 3; ++i)
+    {
+        worker->slots[i] = (Mesh) {0};
+        worker->points[i] = NULL;
+        worker->indices[i] = (SpatialIndex) {0};
+    }
+    worker->stop = false;
+    pthread_create(&worker->thread, NULL, series_worker, worker);
+}
+
+/*
+ * Render thread: if a newer mesh was published, points *mesh at it and
+ * returns true. The mesh stays owned by the worker (it is not `pooled` from
+ * the caller's point of view) and valid until the next successful acquire.
+ * series_build_seconds() then gives the time it took to build.
+ */
+bool series_acquire(SeriesWorker *worker, Mesh *mesh)
+{
+    if (!triple_acquire(&worker->buffer))
+        return false;
+    *mesh = worker->slots[worker->buffer.front];
+    mesh->pooled = false;
+    return true;
+}
+
+double series_build_seconds(SeriesWorker *worker)
+{
+    return worker->build_seconds[worker->buffer.front];
+}
+
+/* Render thread: index over the points of the last acquired mesh, valid until the next acquire */
+const SpatialIndex *series_index(SeriesWorker *worker)
+{
+    return &worker->indices[worker->buffer.front];
+}
+
+void stop_SeriesWorker(SeriesWorker *worker)
+{
+    __atomic_store_n(&worker->stop, true, __ATOMIC_RELEASE);
+    pthread_join(worker->thread, NULL);
+    for (size_t i = 0; i < 3; ++i)
+    {
+        delete_Mesh(&worker->slots[i]);
+        delete_SpatialIndex(&worker->indices[i]);
+        free(worker->points[i]);
+    }
+}
+
+#endif
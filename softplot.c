@@ -0,0 +1,169 @@
+#define PLOT_SOFTWARE
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mathlib.h"
+#include "mesh.h"
+#include "stream.h"
+#include "raster.h"
+#include "image.h"
+#include "timing.h"
+#include "export.h"
+#include "batch.h"
+#include "expr.h"
+#include "contour.h"
+
+/*
+ * GL-free front end: renders plots with the software rasteriser, for
+ * machines without any GL driver, or exports them as vector graphics when
+ * the output ends in .svg or .pdf.
+ *
+ *     ./softplot [--derive formula] input.csv output.{png,svg,pdf} width height [tolerance]
+ *     ./softplot --expr formula x0 x1 points output.{png,svg,pdf} width height [tolerance]
+ *     ./softplot --contour grid.csv levels output.png width height
+ *     ./softplot --batch manifest.txt [--threads N]
+ *
+ * --expr plots y = formula evaluated at `points` evenly spaced x over
+ * [x0, x1]; --derive replaces the series' y with formula of x and y.
+ * --contour draws `levels` level sets of a grid with one row of values per
+ * line, evenly spaced between its extremes.
+ */
+int plot_contours(const char *grid_filename, size_t num_levels, const char *output, int width, int height)
+{
+    Grid grid;
+    if (num_levels == 0 || num_levels > CONTOUR_MAX_LEVELS || width <= 0 || height <= 0)
+    {
+        printf("error: need between 1 and %d levels and a positive size\n", CONTOUR_MAX_LEVELS);
+        return 1;
+    }
+    if (!read_grid(grid_filename, &grid))
+        return 1;
+    float levels[num_levels];
+    contour_levels(&grid, num_levels, levels);
+
+    /* The grid spans [-1, 1] both ways, already the rasteriser's coordinates */
+    Contours contours;
+    double t0 = now_seconds();
+    contour_grid(&grid, num_levels, levels, 0, &contours);
+    double elapsed = now_seconds() - t0;
+    printf("contoured %zu x %zu cells in %.3f ms: %zu lines, %zu points\n", grid.width - 1, grid.height - 1,
+           1e3 * elapsed, contours.num_lines, contours.num_points);
+    Mesh mesh = contours.num_lines > 0 ? contour_mesh(&contours, 1.5f / height) : (Mesh) {0};
+
+    Framebuffer fb;
+    init_Framebuffer(&fb, width, height);
+    clear_Framebuffer(&fb, (vec4) {0.2f, 0.3f, 0.3f, 1.0f});
+    rasterize(&fb, &mesh, (vec4) {1.0f, 0.5f, 0.2f, 1.0f}, 0);
+    bool ok = write_png(output, width, height, fb.pixels);
+    delete_Framebuffer(&fb);
+    delete_Mesh(&mesh);
+    delete_Contours(&contours);
+    delete_Grid(&grid);
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc >= 3 && strcmp(argv[1], "--batch") == 0)
+    {
+        size_t num_threads = 0;
+        if (argc >= 5 && strcmp(argv[3], "--threads") == 0)
+            num_threads = strtoul(argv[4], NULL, 10);
+        return run_batch(argv[2], 1, num_threads);
+    }
+    if (argc == 7 && strcmp(argv[1], "--contour") == 0)
+        return plot_contours(argv[2], strtoul(argv[3], NULL, 10), argv[4], atoi(argv[5]), atoi(argv[6]));
+
+    /* Formulas take their arguments off the front, leaving the usual ones */
+    const char *derive = NULL, *formula = NULL;
+    double x0 = 0, x1 = 0;
+    size_t n = 0;
+    if (argc >= 3 && strcmp(argv[1], "--derive") == 0)
+    {
+        derive = argv[2];
+        argv += 2;
+        argc -= 2;
+    }
+    else if (argc >= 6 && strcmp(argv[1], "--expr") == 0)
+    {
+        formula = argv[2];
+        x0 = atof(argv[3]);
+        x1 = atof(argv[4]);
+        n = strtoul(argv[5], NULL, 10);
+        argv += 4;
+        argc -= 4;
+    }
+
+    if (argc != 5 && argc != 6)
+    {
+        printf("usage: %s [--derive formula] input.csv output.{png,svg,pdf} width height [tolerance]\n", argv[0]);
+        printf("       %s --expr formula x0 x1 points output.{png,svg,pdf} width height [tolerance]\n", argv[0]);
+        printf("       %s --contour grid.csv levels output.png width height\n", argv[0]);
+        printf("       %s --batch manifest.txt [--threads N]\n", argv[0]);
+        return 1;
+    }
+
+    int width = atoi(argv[3]), height = atoi(argv[4]);
+    Expr expr;
+    if ((formula != NULL || derive != NULL) && !compile_expr(&expr, formula != NULL ? formula : derive))
+        return 1;
+    if (formula != NULL && expr.uses_y)
+    {
+        printf("error: --expr formulas can only use x\n");
+        return 1;
+    }
+
+    vec3 *vertices;
+    if (formula != NULL)
+    {
+        double t0 = now_seconds();
+        vertices = expr_sample(&expr, x0, x1, n, 0);
+        printf("evaluated %zu points in %.3f ms\n", n, 1e3 * (now_seconds() - t0));
+    }
+    else
+    {
+        vertices = stream_csv(argv[1], 0, &n, NULL);
+        if (vertices != NULL && derive != NULL)
+            expr_derive(&expr, n, vertices, 0);
+    }
+    if (vertices == NULL || n < 2 || width <= 0 || height <= 0)
+    {
+        printf("error: need at least two points and a positive size\n");
+        return 1;
+    }
+
+    const char *extension = strrchr(argv[2], '.');
+    if (extension != NULL && (strcmp(extension, ".svg") == 0 || strcmp(extension, ".pdf") == 0))
+    {
+        /* Simplification tolerance in output pixels */
+        float tolerance = argc == 6 ? atof(argv[5]) : 0.25f;
+        double t0 = now_seconds();
+        size_t bytes = strcmp(extension, ".svg") == 0
+            ? export_svg(argv[2], n, vertices, width, height, tolerance)
+            : export_pdf(argv[2], n, vertices, width, height, tolerance);
+        double elapsed = now_seconds() - t0;
+        printf("exported %zu points in %.3f ms, %zu bytes\n", n, 1e3 * elapsed, bytes);
+        free(vertices);
+        return bytes > 0 ? 0 : 1;
+    }
+
+    normalize(n, vertices);
+    Mesh mesh = line(n, vertices, 1.5f / height);
+
+    Framebuffer fb;
+    init_Framebuffer(&fb, width, height);
+    clear_Framebuffer(&fb, (vec4) {0.2f, 0.3f, 0.3f, 1.0f});
+    double t0 = now_seconds();
+    rasterize(&fb, &mesh, (vec4) {1.0f, 0.5f, 0.2f, 1.0f}, 0);
+    double elapsed = now_seconds() - t0;
+    printf("rasterized %zu triangles in %.3f ms (%.1f M triangles/s)\n",
+           mesh.num_indices / 3, 1e3 * elapsed, mesh.num_indices / 3 / elapsed / 1e6);
+
+    bool ok = write_png(argv[2], width, height, fb.pixels);
+    delete_Framebuffer(&fb);
+    delete_Mesh(&mesh);
+    free(vertices);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,425 @@
+#ifndef SPATIAL_H
+#define SPATIAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "mathlib.h"
+#include "threads.h"
+
+/*
+ * Nearest-point queries over a series, for cursor readouts.
+ *
+ * The index refers to the caller's point array (it does not copy it) and
+ * covers it with blocks of consecutive points. A block that is sorted by x
+ * only keeps the y range of every SPATIAL_BUCKET points: a query
+ * binary-searches x and walks outwards bucket by bucket, skipping buckets
+ * whose bounding box is further than the best match so far and stopping once
+ * the x distance alone is. Any other block gets an implicit k-d tree, a
+ * permutation of its point numbers split at the median on alternating axes
+ * down to SPATIAL_LEAF points, searched with the distance to each cell rather
+ * than just to its splitting line. The top levels of the tree are split on
+ * the calling thread and the subtrees below them built in parallel.
+ *
+ * Appended points go to a tail that queries scan linearly. Once it holds
+ * SPATIAL_TAIL points it becomes a block, and the last two blocks are merged
+ * for as long as the earlier one is no bigger than the later, like carries in
+ * a binary counter: there are O(log n) blocks and each point is rebuilt
+ * O(log n) times. Two sorted blocks that join up in order stay sorted, so
+ * a stream with increasing x never builds a tree.
+ *
+ * Distances are measured after multiplying by `scale`, so passing pixels per
+ * unit on each axis finds the point nearest on screen. Only x and y count.
+ */
+
+#define SPATIAL_LEAF 16
+#define SPATIAL_BUCKET 64
+#define SPATIAL_TAIL 1024
+#define SPATIAL_MAX_BLOCKS 64
+
+typedef struct SpatialBlock
+{
+    size_t begin, end;
+    uint32_t *tree; /* k-d tree order of [begin, end), NULL if sorted by x */
+    float *ybounds; /* sorted blocks: min and max y of every SPATIAL_BUCKET points */
+} SpatialBlock;
+
+typedef struct SpatialIndex
+{
+    const vec3 *points;
+    size_t num_points; /* including the tail */
+    size_t indexed;    /* points covered by blocks */
+    SpatialBlock blocks[SPATIAL_MAX_BLOCKS];
+    size_t num_blocks;
+    size_t num_threads;
+} SpatialIndex;
+
+float spatial_coord(vec3 p, size_t axis)
+{
+    return axis ? p.y : p.x;
+}
+
+/* Construction */
+
+typedef struct SpatialBuild
+{
+    const vec3 *points;
+    size_t begin, n;
+    uint32_t *tree;
+    float *ybounds;
+    size_t *ranges; /* lo, hi, depth per subtree */
+    bool unsorted;
+} SpatialBuild;
+
+void spatial_check_sorted(void *ctx, size_t thread, size_t begin, size_t end)
+{
+    SpatialBuild *build = ctx;
+    for (size_t i = begin > 0 ? begin : 1; i < end; ++i)
+    {
+        if (build->points[i - 1].x > build->points[i].x)
+        {
+            __atomic_store_n(&build->unsorted, true, __ATOMIC_RELAXED);
+            return;
+        }
+    }
+}
+
+/* Partially sorts tree[lo, hi) so that tree[k] holds the median on `axis` */
+void spatial_select(const vec3 *points, uint32_t *tree, size_t lo, size_t hi, size_t k, size_t axis)
+{
+    /* Hoare partitioning, so long runs of equal keys still split evenly */
+    while (hi - lo > 1)
+    {
+        float pivot = spatial_coord(points[tree[lo + (hi - lo - 1) / 2]], axis);
+        size_t i = lo, j = hi - 1;
+        while (true)
+        {
+            while (spatial_coord(points[tree[i]], axis) < pivot)
+                ++i;
+            while (spatial_coord(points[tree[j]], axis) > pivot)
+                --j;
+            if (i >= j)
+                break;
+            uint32_t t = tree[i];
+            tree[i] = tree[j];
+            tree[j] = t;
+            ++i;
+            --j;
+        }
+        if (k <= j)
+            hi = j + 1;
+        else
+            lo = j + 1;
+    }
+}
+
+/* Node [lo, hi) is the point at mid = lo + (hi - lo) / 2, with [lo, mid) <= it <= (mid, hi) */
+void spatial_build_tree(const vec3 *points, uint32_t *tree, size_t lo, size_t hi, size_t depth)
+{
+    while (hi - lo > SPATIAL_LEAF)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        spatial_select(points, tree, lo, hi, mid, depth % 2);
+        spatial_build_tree(points, tree, lo, mid, depth + 1);
+        lo = mid + 1;
+        ++depth;
+    }
+}
+
+void spatial_build_subtrees(void *ctx, size_t thread, size_t begin, size_t end)
+{
+    SpatialBuild *build = ctx;
+    for (size_t i = begin; i < end; ++i)
+    {
+        size_t *range = &build->ranges[3 * i];
+        spatial_build_tree(build->points, build->tree, range[0], range[1], range[2]);
+    }
+}
+
+void spatial_fill(void *ctx, size_t thread, size_t begin, size_t end)
+{
+    SpatialBuild *build = ctx;
+    for (size_t i = begin; i < end; ++i)
+        build->tree[i] = build->begin + i;
+}
+
+void spatial_bound_buckets(void *ctx, size_t thread, size_t begin, size_t end)
+{
+    SpatialBuild *build = ctx;
+    for (size_t k = begin; k < end; ++k)
+    {
+        float ymin = INFINITY, ymax = -INFINITY;
+        size_t last = (k + 1) * SPATIAL_BUCKET < build->n ? (k + 1) * SPATIAL_BUCKET : build->n;
+        for (size_t i = k * SPATIAL_BUCKET; i < last; ++i)
+        {
+            ymin = min(ymin, build->points[i].y);
+            ymax = max(ymax, build->points[i].y);
+        }
+        build->ybounds[2 * k] = ymin;
+        build->ybounds[2 * k + 1] = ymax;
+    }
+}
+
+/* Indexes points [begin, end) as one block */
+SpatialBlock spatial_build_block(const vec3 *points, size_t begin, size_t end, size_t num_threads)
+{
+    SpatialBlock block = {begin, end, NULL, NULL};
+    if (end > UINT32_MAX)
+    {
+        printf("error: cannot index more than %u points\n", UINT32_MAX);
+        exit(1);
+    }
+
+    size_t n = end - begin;
+    SpatialBuild build = {points + begin, begin, n, NULL, NULL, NULL, false};
+    parallel_for(num_threads, n, spatial_check_sorted, &build);
+    if (!build.unsorted)
+    {
+        size_t num_buckets = (n + SPATIAL_BUCKET - 1) / SPATIAL_BUCKET;
+        block.ybounds = malloc(2 * num_buckets * sizeof(float));
+        build.ybounds = block.ybounds;
+        parallel_for(num_threads, num_buckets, spatial_bound_buckets, &build);
+        return block;
+    }
+
+    block.tree = malloc(n * sizeof(uint32_t));
+    if (block.tree == NULL)
+    {
+        printf("error: out of memory indexing %zu points\n", n);
+        exit(1);
+    }
+    /* Positions in the tree are relative to the block, the point numbers in it are not */
+    build.tree = block.tree;
+    parallel_for(num_threads, n, spatial_fill, &build);
+
+    /* Split the top levels here until there is a subtree per thread */
+    size_t num_ranges = 1, levels = 0;
+    while (((size_t) 1 << levels) < num_threads && n >> levels > 4 * SPATIAL_LEAF)
+        ++levels;
+    build.points = points;
+    build.ranges = malloc(3 * ((size_t) 1 << levels) * sizeof(size_t));
+    build.ranges[0] = 0;
+    build.ranges[1] = n;
+    build.ranges[2] = 0;
+    for (size_t level = 0; level < levels; ++level)
+    {
+        /* Backwards, so each range is read before its slot is reused for children */
+        for (size_t i = num_ranges; i-- > 0;)
+        {
+            size_t lo = build.ranges[3 * i], hi = build.ranges[3 * i + 1], mid = lo + (hi - lo) / 2;
+            spatial_select(points, build.tree, lo, hi, mid, level % 2);
+            size_t *children = &build.ranges[6 * i];
+            children[0] = lo;
+            children[1] = mid;
+            children[2] = level + 1;
+            children[3] = mid + 1;
+            children[4] = hi;
+            children[5] = level + 1;
+        }
+        num_ranges *= 2;
+    }
+    parallel_for(num_threads < num_ranges ? num_threads : num_ranges, num_ranges, spatial_build_subtrees, &build);
+    free(build.ranges);
+    return block;
+}
+
+void delete_SpatialBlock(SpatialBlock *block)
+{
+    free(block->tree);
+    free(block->ybounds);
+    block->tree = NULL;
+    block->ybounds = NULL;
+}
+
+/* Merges the last two blocks while the earlier is no bigger than the later */
+void spatial_merge(SpatialIndex *index)
+{
+    while (index->num_blocks >= 2)
+    {
+        SpatialBlock *a = &index->blocks[index->num_blocks - 2];
+        SpatialBlock *b = &index->blocks[index->num_blocks - 1];
+        if (a->end - a->begin > b->end - b->begin && index->num_blocks < SPATIAL_MAX_BLOCKS)
+            break;
+        size_t begin = a->begin, end = b->end;
+        delete_SpatialBlock(a);
+        delete_SpatialBlock(b);
+        *a = spatial_build_block(index->points, begin, end, index->num_threads);
+        --index->num_blocks;
+    }
+}
+
+/* Indexes points[0, n); num_threads 0 uses every core */
+void init_SpatialIndex(SpatialIndex *index, const vec3 *points, size_t n, size_t num_threads)
+{
+    index->points = points;
+    index->num_points = n;
+    index->indexed = n;
+    index->num_blocks = 0;
+    index->num_threads = num_threads ? num_threads : num_cores();
+    if (n > 0)
+        index->blocks[index->num_blocks++] = spatial_build_block(points, 0, n, index->num_threads);
+}
+
+/*
+ * Extends the index to points[0, n) of `points`, which may have moved (e.g.
+ * been realloc'd) but must keep the first num_points points unchanged.
+ */
+void spatial_append(SpatialIndex *index, const vec3 *points, size_t n)
+{
+    index->points = points;
+    index->num_points = n;
+    while (index->num_points - index->indexed >= SPATIAL_TAIL)
+    {
+        size_t begin = index->indexed;
+        index->indexed += SPATIAL_TAIL;
+        index->blocks[index->num_blocks++] = spatial_build_block(points, begin, index->indexed, index->num_threads);
+        spatial_merge(index);
+    }
+}
+
+void delete_SpatialIndex(SpatialIndex *index)
+{
+    for (size_t i = 0; i < index->num_blocks; ++i)
+        delete_SpatialBlock(&index->blocks[i]);
+    *index = (SpatialIndex) {0};
+}
+
+/* Queries */
+
+typedef struct SpatialQuery
+{
+    const vec3 *points;
+    vec3 at, scale;
+    size_t nearest;
+    float distance2;
+} SpatialQuery;
+
+void spatial_consider(SpatialQuery *query, size_t i)
+{
+    float dx = (query->points[i].x - query->at.x) * query->scale.x;
+    float dy = (query->points[i].y - query->at.y) * query->scale.y;
+    float d2 = dx * dx + dy * dy;
+    if (d2 < query->distance2)
+    {
+        query->distance2 = d2;
+        query->nearest = i;
+    }
+}
+
+/* Squared distance from the query to a bucket of a sorted block, given its x distance */
+float spatial_bucket_distance2(SpatialQuery *query, const SpatialBlock *block, size_t k, float dx)
+{
+    float ymin = block->ybounds[2 * k], ymax = block->ybounds[2 * k + 1];
+    float dy = query->at.y < ymin ? ymin - query->at.y : query->at.y > ymax ? query->at.y - ymax : 0;
+    dx *= query->scale.x;
+    dy *= query->scale.y;
+    return dx * dx + dy * dy;
+}
+
+void spatial_query_bucket(SpatialQuery *query, const SpatialBlock *block, size_t k)
+{
+    size_t first = block->begin + k * SPATIAL_BUCKET;
+    size_t last = first + SPATIAL_BUCKET < block->end ? first + SPATIAL_BUCKET : block->end;
+    for (size_t i = first; i < last; ++i)
+        spatial_consider(query, i);
+}
+
+void spatial_query_sorted(SpatialQuery *query, const SpatialBlock *block)
+{
+    /* First point with x >= at.x, and its bucket */
+    size_t lo = block->begin, hi = block->end;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (query->points[mid].x < query->at.x)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    size_t num_buckets = (block->end - block->begin + SPATIAL_BUCKET - 1) / SPATIAL_BUCKET;
+    size_t start = (lo - block->begin) / SPATIAL_BUCKET;
+    if (start == num_buckets)
+        --start;
+    spatial_query_bucket(query, block, start);
+
+    /* Buckets to the right start at or after the query's x, those to the left end before it */
+    for (size_t k = start + 1; k < num_buckets; ++k)
+    {
+        float dx = query->points[block->begin + k * SPATIAL_BUCKET].x - query->at.x;
+        if (dx * dx * query->scale.x * query->scale.x >= query->distance2)
+            break;
+        if (spatial_bucket_distance2(query, block, k, dx) < query->distance2)
+            spatial_query_bucket(query, block, k);
+    }
+    for (size_t k = start; k-- > 0;)
+    {
+        float dx = query->at.x - query->points[block->begin + (k + 1) * SPATIAL_BUCKET - 1].x;
+        if (dx * dx * query->scale.x * query->scale.x >= query->distance2)
+            break;
+        if (spatial_bucket_distance2(query, block, k, dx) < query->distance2)
+            spatial_query_bucket(query, block, k);
+    }
+}
+
+/*
+ * `offset` holds the scaled distance from the query to the node's cell along
+ * each axis and `distance2` the squared distance to the cell, so a subtree is
+ * skipped when its whole cell is further than the best match.
+ */
+void spatial_query_tree(SpatialQuery *query, const uint32_t *tree, size_t lo, size_t hi, size_t depth,
+                        float offset[2], float distance2)
+{
+    if (distance2 >= query->distance2)
+        return;
+    if (hi - lo <= SPATIAL_LEAF)
+    {
+        for (size_t i = lo; i < hi; ++i)
+            spatial_consider(query, tree[i]);
+        return;
+    }
+    size_t mid = lo + (hi - lo) / 2, axis = depth % 2;
+    spatial_consider(query, tree[mid]);
+    float d = (spatial_coord(query->at, axis) - spatial_coord(query->points[tree[mid]], axis))
+        * (axis ? query->scale.y : query->scale.x);
+
+    /* Near side first; the far cell is |d| away along this axis */
+    if (d < 0)
+        spatial_query_tree(query, tree, lo, mid, depth + 1, offset, distance2);
+    else
+        spatial_query_tree(query, tree, mid + 1, hi, depth + 1, offset, distance2);
+    float old = offset[axis];
+    offset[axis] = d;
+    distance2 += d * d - old * old;
+    if (d < 0)
+        spatial_query_tree(query, tree, mid + 1, hi, depth + 1, offset, distance2);
+    else
+        spatial_query_tree(query, tree, lo, mid, depth + 1, offset, distance2);
+    offset[axis] = old;
+}
+
+/*
+ * Finds the point nearest to `at` within `radius` (in scaled units, INFINITY
+ * for no limit). Returns false if there is none; otherwise *nearest is its
+ * position in the point array.
+ */
+bool spatial_nearest(const SpatialIndex *index, vec3 at, vec3 scale, float radius, size_t *nearest)
+{
+    SpatialQuery query = {index->points, at, scale, SIZE_MAX, radius * radius};
+    for (size_t i = 0; i < index->num_blocks; ++i)
+    {
+        const SpatialBlock *block = &index->blocks[i];
+        if (block->tree == NULL)
+            spatial_query_sorted(&query, block);
+        else
+            spatial_query_tree(&query, block->tree, 0, block->end - block->begin, 0, (float[2]) {0, 0}, 0);
+    }
+    for (size_t i = index->indexed; i < index->num_points; ++i)
+        spatial_consider(&query, i);
+    if (query.nearest == SIZE_MAX)
+        return false;
+    *nearest = query.nearest;
+    return true;
+}
+
+#endif
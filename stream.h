@@ -0,0 +1,630 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#ifdef PLOT_ZSTD
+#include <zstd.h>
+#endif
+#include "mathlib.h"
+#include "threads.h"
+
+/*
+ * Streaming CSV loading, from plain, gzip or (with -DPLOT_ZSTD) zstd files,
+ * without writing anything to disk. The calling thread reads the file and
+ * cuts it into blocks of about STREAM_BLOCK bytes. These go into a bounded
+ * queue that worker threads drain, so memory stays at a few blocks per
+ * worker however large the file.
+ *
+ * Where the format splits into independent pieces, workers decompress as
+ * well as parse, and decompression runs in parallel too. That is the case
+ * for BGZF (bgzip) members, whose headers record their size, and for zstd
+ * frames that record their content size. Any other gzip member or zstd
+ * frame is inflated in order on the reading thread, and the workers only
+ * parse.
+ *
+ * Blocks end anywhere, not at line ends. Each worker parses the whole lines
+ * inside its block and keeps the partial lines at either end. Once all
+ * blocks are in, the pieces are joined in order: each block's tail with
+ * the next block's head.
+ *
+ * What a line holds is up to a StreamFormat. stream_csv() reads rows as
+ * read_csv() does: "x, y, z" lines, stopping at the first one that is not,
+ * with blank lines skipped. A format with a header parser takes the first
+ * line as a header. The worker that gets the first block parses the header,
+ * and the other workers wait for it, so rows can depend on the header, as
+ * columns.h's do, down to the row size, which the header parser may set.
+ */
+
+#define STREAM_BLOCK ((size_t) 4 << 20)
+#define STREAM_QUEUE_PER_WORKER 2
+
+typedef enum StreamCodec
+{
+    STREAM_TEXT,
+    STREAM_GZIP, /* one or more whole gzip members */
+    STREAM_ZSTD, /* one or more whole zstd frames */
+} StreamCodec;
+
+/* Parses one line, ending at a newline or NUL, into a row: 1 for a row, 0 for a line to skip, -1 to stop */
+typedef int (*RowParser)(void *ctx, const char *line, void *row);
+/* Reads the header line, NUL-terminated; false if the rows cannot be read by it */
+typedef bool (*HeaderParser)(void *ctx, const char *line);
+
+typedef struct StreamFormat
+{
+    RowParser parse;
+    HeaderParser header; /* NULL if there is no header line */
+    void *ctx;
+    size_t row_size;
+} StreamFormat;
+
+typedef struct StreamBlock
+{
+    size_t index;
+    StreamCodec codec;
+    uint8_t *data;
+    size_t size, text_size; /* text_size: decompressed size, for codecs other than STREAM_TEXT */
+    bool corrupt;
+
+    /* Filled in by a worker */
+    uint8_t *rows;
+    size_t num_rows;
+    char *head, *tail; /* before the first line end and after the last, or all of it in head if it has none */
+    bool newline;
+    bool malformed; /* a whole line in the block was not a row; rows are those before it */
+} StreamBlock;
+
+typedef struct StreamStats
+{
+    size_t input_bytes, text_bytes, blocks, parallel_blocks;
+} StreamStats;
+
+typedef struct StreamLoader
+{
+    FILE *file;
+    const StreamFormat *format;
+    Queue jobs;
+    StreamBlock **blocks;
+    size_t num_blocks, capacity;
+    uint8_t *in; /* read ahead of the blocks cut so far */
+    size_t in_start, in_end, in_capacity;
+    StreamStats stats;
+    int header; /* 0 until the header is read, then 1, or -1 if the format rejects it, or -2 if there is none */
+    pthread_mutex_t header_mutex;
+    pthread_cond_t header_read;
+} StreamLoader;
+
+/* Parses one "x, y, z" line ending at a newline or NUL: 1 for a row, 0 for a blank line, -1 for anything else */
+int parse_row(const char *line, vec3 *out)
+{
+    const char *p = line;
+    while (*p == ' ' || *p == '\t' || *p == '\r')
+        ++p;
+    if (*p == '\n' || *p == '\0')
+        return 0;
+    float v[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        char *end;
+        v[i] = strtof(p, &end);
+        if (end == p)
+            return -1;
+        p = end;
+        while (*p == ' ' || *p == '\t')
+            ++p;
+        if (i < 2)
+        {
+            if (*p != ',')
+                return -1;
+            ++p;
+            while (*p == ' ' || *p == '\t' || *p == '\r')
+                ++p;
+            if (*p == '\n')
+                return -1;
+        }
+    }
+    while (*p == ' ' || *p == '\t' || *p == '\r')
+        ++p;
+    if (*p != '\n' && *p != '\0')
+        return -1;
+    *out = (vec3) {v[0], v[1], v[2]};
+    return 1;
+}
+
+char *copy_text(const char *text, size_t length)
+{
+    char *copy = malloc(length + 1);
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+/* Parses the whole lines of a block's text, which has a NUL after its `length` bytes */
+void parse_block(StreamBlock *block, const StreamFormat *format, const char *text, size_t length)
+{
+    const char *first = memchr(text, '\n', length);
+    block->newline = first != NULL;
+    if (first == NULL)
+    {
+        block->head = copy_text(text, length);
+        block->tail = copy_text("", 0);
+        return;
+    }
+    const char *last = text + length - 1;
+    while (*last != '\n')
+        --last;
+    block->head = copy_text(text, first - text);
+    block->tail = copy_text(last + 1, text + length - last - 1);
+
+    size_t lines = 0;
+    for (const char *p = first + 1; p < last; p = (const char *) memchr(p, '\n', last + 1 - p) + 1)
+        ++lines;
+    block->rows = malloc((lines > 0 ? lines : 1) * format->row_size);
+    for (const char *p = first + 1; p < last; p = (const char *) memchr(p, '\n', last + 1 - p) + 1)
+    {
+        int row = format->parse(format->ctx, p, block->rows + block->num_rows * format->row_size);
+        if (row < 0)
+        {
+            block->malformed = true;
+            return;
+        }
+        block->num_rows += row;
+    }
+}
+
+/* Inflates whole gzip members into exactly text_size bytes; false if they are corrupt or of another size */
+bool inflate_members(const uint8_t *data, size_t size, char *text, size_t text_size)
+{
+    z_stream z = {0};
+    if (inflateInit2(&z, 15 + 16) != Z_OK)
+        return false;
+    z.next_in = (uint8_t *) data;
+    z.avail_in = size;
+    z.next_out = (uint8_t *) text;
+    z.avail_out = text_size;
+    bool ok = true;
+    while (ok)
+    {
+        int ret = inflate(&z, Z_FINISH);
+        if (ret == Z_STREAM_END && z.avail_in > 0)
+            ok = inflateReset(&z) == Z_OK;
+        else
+        {
+            ok = ret == Z_STREAM_END;
+            break;
+        }
+    }
+    ok = ok && z.avail_out == 0;
+    inflateEnd(&z);
+    return ok;
+}
+
+/* The block's text, decompressed if need be, with a NUL after it; NULL if it is corrupt */
+char *decode_block(StreamBlock *block, size_t *length)
+{
+    if (block->codec == STREAM_TEXT)
+    {
+        *length = block->size;
+        return (char *) block->data;
+    }
+    char *text = malloc(block->text_size + 1);
+    bool ok = false;
+    if (block->codec == STREAM_GZIP)
+        ok = inflate_members(block->data, block->size, text, block->text_size);
+#ifdef PLOT_ZSTD
+    else if (block->codec == STREAM_ZSTD)
+        ok = ZSTD_decompress(text, block->text_size, block->data, block->size) == block->text_size;
+#endif
+    if (!ok)
+    {
+        free(text);
+        return NULL;
+    }
+    text[block->text_size] = '\0';
+    *length = block->text_size;
+    return text;
+}
+
+/* Reads the header from the first block's first line, or fails it, and lets the other workers go on */
+void stream_header(StreamLoader *loader, char *text, size_t length)
+{
+    char *end = text != NULL ? memchr(text, '\n', length) : NULL;
+    int header = -2;
+    if (end != NULL)
+    {
+        *end = '\0';
+        header = loader->format->header(loader->format->ctx, text) ? 1 : -1;
+        *end = '\n';
+    }
+    pthread_mutex_lock(&loader->header_mutex);
+    loader->header = header;
+    pthread_cond_broadcast(&loader->header_read);
+    pthread_mutex_unlock(&loader->header_mutex);
+}
+
+void *stream_worker(void *arg)
+{
+    StreamLoader *loader = arg;
+    StreamBlock *block;
+    while ((block = queue_pop(&loader->jobs)) != NULL)
+    {
+        size_t length;
+        char *text = block->corrupt ? NULL : decode_block(block, &length);
+        block->corrupt = text == NULL;
+        if (loader->format->header != NULL)
+        {
+            if (block->index == 0)
+                stream_header(loader, text, length);
+            pthread_mutex_lock(&loader->header_mutex);
+            while (loader->header == 0)
+                pthread_cond_wait(&loader->header_read, &loader->header_mutex);
+            pthread_mutex_unlock(&loader->header_mutex);
+        }
+        if (text != NULL && loader->header >= 0)
+            parse_block(block, loader->format, text, length);
+        if (text != (char *) block->data)
+            free(text);
+        free(block->data);
+        block->data = NULL;
+    }
+    return NULL;
+}
+
+/* Hands a block to the workers; text blocks need a byte to spare after `size` for the NUL */
+void stream_push(StreamLoader *loader, StreamCodec codec, uint8_t *data, size_t size, size_t text_size, bool corrupt)
+{
+    StreamBlock *block = calloc(1, sizeof(StreamBlock));
+    *block = (StreamBlock) {loader->num_blocks, codec, data, size, text_size, corrupt};
+    if (codec == STREAM_TEXT && data != NULL)
+        data[size] = '\0';
+    if (loader->num_blocks == loader->capacity)
+    {
+        loader->capacity = loader->capacity > 0 ? 2 * loader->capacity : 64;
+        loader->blocks = realloc(loader->blocks, loader->capacity * sizeof(StreamBlock *));
+    }
+    loader->blocks[loader->num_blocks++] = block;
+    loader->stats.blocks += 1;
+    loader->stats.parallel_blocks += codec != STREAM_TEXT;
+    loader->stats.text_bytes += codec == STREAM_TEXT ? size : text_size;
+    queue_push(&loader->jobs, block);
+}
+
+/* Makes at least `need` bytes of input available, unless the file ends first; true if they are */
+bool stream_fill(StreamLoader *loader, size_t need)
+{
+    size_t available = loader->in_end - loader->in_start;
+    if (available >= need)
+        return true;
+    memmove(loader->in, loader->in + loader->in_start, available);
+    loader->in_start = 0;
+    loader->in_end = available;
+    if (need > loader->in_capacity)
+    {
+        loader->in_capacity = need > 2 * loader->in_capacity ? need : 2 * loader->in_capacity;
+        loader->in = realloc(loader->in, loader->in_capacity);
+    }
+    while (loader->in_end < need)
+    {
+        size_t got = fread(loader->in + loader->in_end, 1, loader->in_capacity - loader->in_end, loader->file);
+        if (got == 0)
+            break;
+        loader->in_end += got;
+        loader->stats.input_bytes += got;
+    }
+    return loader->in_end >= need;
+}
+
+/* Size of the BGZF member at p, a gzip member whose header records its size, or 0 for any other */
+size_t bgzf_member_size(const uint8_t *p, size_t available)
+{
+    if (available < 18 || p[0] != 0x1f || p[1] != 0x8b || p[2] != 8 || !(p[3] & 4))
+        return 0;
+    size_t extra_end = 12 + (p[10] | p[11] << 8);
+    for (size_t offset = 12; offset + 4 <= extra_end && offset + 4 <= available;)
+    {
+        size_t length = p[offset + 2] | p[offset + 3] << 8;
+        if (p[offset] == 'B' && p[offset + 1] == 'C' && length == 2 && offset + 6 <= available)
+            return (p[offset + 4] | p[offset + 5] << 8) + 1;
+        offset += 4 + length;
+    }
+    return 0;
+}
+
+/* Batches consecutive BGZF members, up to about STREAM_BLOCK bytes of text, into one block for a worker */
+void stream_bgzf(StreamLoader *loader)
+{
+    uint8_t *data = malloc(STREAM_BLOCK);
+    size_t size = 0, text_size = 0, member;
+    while (stream_fill(loader, 18)
+           && (member = bgzf_member_size(loader->in + loader->in_start, loader->in_end - loader->in_start)) > 0
+           && (size == 0 || (size + member <= STREAM_BLOCK && text_size < STREAM_BLOCK)))
+    {
+        if (member < 26 || !stream_fill(loader, member))
+        {
+            stream_push(loader, STREAM_TEXT, NULL, 0, 0, true);
+            loader->in_start = loader->in_end;
+            break;
+        }
+        const uint8_t *p = loader->in + loader->in_start;
+        if (size + member > STREAM_BLOCK)
+            data = realloc(data, size + member);
+        memcpy(data + size, p, member);
+        size += member;
+        text_size += p[member - 4] | p[member - 3] << 8 | p[member - 2] << 16 | (size_t) p[member - 1] << 24;
+        loader->in_start += member;
+    }
+    if (size > 0)
+        stream_push(loader, STREAM_GZIP, data, size, text_size, false);
+    else
+        free(data);
+}
+
+/* Inflates one gzip member of unrecorded size here, handing its text to the workers a block at a time */
+void stream_gzip_member(StreamLoader *loader)
+{
+    z_stream z = {0};
+    inflateInit2(&z, 15 + 16);
+    uint8_t *text = malloc(STREAM_BLOCK + 1);
+    size_t filled = 0;
+    int ret = Z_OK;
+    while (ret != Z_STREAM_END)
+    {
+        if (loader->in_start == loader->in_end && !stream_fill(loader, 1))
+            break;
+        z.next_in = loader->in + loader->in_start;
+        z.avail_in = loader->in_end - loader->in_start;
+        z.next_out = text + filled;
+        z.avail_out = STREAM_BLOCK - filled;
+        ret = inflate(&z, Z_NO_FLUSH);
+        loader->in_start = loader->in_end - z.avail_in;
+        filled = STREAM_BLOCK - z.avail_out;
+        if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR)
+            break;
+        if (filled == STREAM_BLOCK)
+        {
+            stream_push(loader, STREAM_TEXT, text, filled, 0, false);
+            text = malloc(STREAM_BLOCK + 1);
+            filled = 0;
+        }
+    }
+    if (filled > 0)
+        stream_push(loader, STREAM_TEXT, text, filled, 0, false);
+    else
+        free(text);
+    if (ret != Z_STREAM_END)
+    {
+        stream_push(loader, STREAM_TEXT, NULL, 0, 0, true);
+        loader->in_start = loader->in_end;
+    }
+    inflateEnd(&z);
+}
+
+#ifdef PLOT_ZSTD
+/* Batches consecutive zstd frames with recorded sizes into one block, or streams a frame without them here */
+void stream_zstd(StreamLoader *loader)
+{
+    stream_fill(loader, STREAM_BLOCK);
+    const uint8_t *p = loader->in + loader->in_start;
+    size_t available = loader->in_end - loader->in_start, size = 0, text_size = 0;
+    while (size < available)
+    {
+        size_t frame = ZSTD_findFrameCompressedSize(p + size, available - size);
+        unsigned long long content = ZSTD_getFrameContentSize(p + size, available - size);
+        if (ZSTD_isError(frame) || content == ZSTD_CONTENTSIZE_UNKNOWN || content == ZSTD_CONTENTSIZE_ERROR
+            || (size > 0 && text_size >= STREAM_BLOCK) || content > 4 * STREAM_BLOCK)
+            break;
+        size += frame;
+        text_size += content;
+    }
+    if (size > 0)
+    {
+        uint8_t *data = malloc(size);
+        memcpy(data, p, size);
+        loader->in_start += size;
+        stream_push(loader, STREAM_ZSTD, data, size, text_size, false);
+        return;
+    }
+
+    ZSTD_DStream *stream = ZSTD_createDStream();
+    ZSTD_initDStream(stream);
+    uint8_t *text = malloc(STREAM_BLOCK + 1);
+    size_t filled = 0, ret = 1;
+    while (ret != 0)
+    {
+        if (loader->in_start == loader->in_end && !stream_fill(loader, 1))
+            break;
+        ZSTD_inBuffer in = {loader->in + loader->in_start, loader->in_end - loader->in_start, 0};
+        ZSTD_outBuffer out = {text, STREAM_BLOCK, filled};
+        ret = ZSTD_decompressStream(stream, &out, &in);
+        loader->in_start += in.pos;
+        filled = out.pos;
+        if (ZSTD_isError(ret))
+            break;
+        if (filled == STREAM_BLOCK)
+        {
+            stream_push(loader, STREAM_TEXT, text, filled, 0, false);
+            text = malloc(STREAM_BLOCK + 1);
+            filled = 0;
+        }
+    }
+    if (filled > 0)
+        stream_push(loader, STREAM_TEXT, text, filled, 0, false);
+    else
+        free(text);
+    if (ret != 0)
+    {
+        stream_push(loader, STREAM_TEXT, NULL, 0, 0, true);
+        loader->in_start = loader->in_end;
+    }
+    ZSTD_freeDStream(stream);
+}
+#endif
+
+/* Reads and cuts the whole file, by the format its first bytes give */
+void stream_read(StreamLoader *loader, const char *filename)
+{
+    stream_fill(loader, 4);
+    const uint8_t *p = loader->in + loader->in_start;
+    size_t available = loader->in_end - loader->in_start;
+    if (available >= 2 && p[0] == 0x1f && p[1] == 0x8b)
+    {
+        while (stream_fill(loader, 1))
+        {
+            stream_fill(loader, 18);
+            if (bgzf_member_size(loader->in + loader->in_start, loader->in_end - loader->in_start) > 0)
+                stream_bgzf(loader);
+            else
+                stream_gzip_member(loader);
+        }
+    }
+    else if (available >= 4 && p[0] == 0x28 && p[1] == 0xb5 && p[2] == 0x2f && p[3] == 0xfd)
+    {
+#ifdef PLOT_ZSTD
+        while (stream_fill(loader, 1))
+            stream_zstd(loader);
+#else
+        printf("error: %s is zstd-compressed; compile with -DPLOT_ZSTD and -lzstd to read it\n", filename);
+#endif
+    }
+    else
+    {
+        if (available > 0)
+        {
+            uint8_t *text = malloc(available + 1);
+            memcpy(text, p, available);
+            stream_push(loader, STREAM_TEXT, text, available, 0, false);
+        }
+        for (;;)
+        {
+            uint8_t *text = malloc(STREAM_BLOCK + 1);
+            size_t got = fread(text, 1, STREAM_BLOCK, loader->file);
+            loader->stats.input_bytes += got;
+            if (got == 0)
+            {
+                free(text);
+                break;
+            }
+            stream_push(loader, STREAM_TEXT, text, got, 0, false);
+        }
+    }
+}
+
+/* Appends `text` to the partial line in `carry` */
+void carry_append(char **carry, size_t *length, const char *text)
+{
+    size_t extra = strlen(text);
+    *carry = realloc(*carry, *length + extra + 1);
+    memcpy(*carry + *length, text, extra + 1);
+    *length += extra;
+}
+
+/*
+ * Loads every row of a file in `format`, plain, gzip or zstd, reading on
+ * this thread and decompressing and parsing on num_threads workers (0 for
+ * one per core). Returns the rows, row_size bytes each. Returns NULL if the
+ * file cannot be opened or its header cannot be read. Corrupt input ends
+ * the rows at the last block read intact. With `stats`, it also reports the
+ * bytes read and decompressed.
+ */
+void *stream_rows(const char *filename, const StreamFormat *format, size_t num_threads, size_t *n,
+                  StreamStats *stats)
+{
+    *n = 0;
+    StreamLoader loader = {0};
+    loader.file = fopen(filename, "rb");
+    if (loader.file == NULL)
+    {
+        printf("error: could not open %s\n", filename);
+        return NULL;
+    }
+    loader.format = format;
+    loader.in_capacity = STREAM_BLOCK;
+    loader.in = malloc(loader.in_capacity);
+    pthread_mutex_init(&loader.header_mutex, NULL);
+    pthread_cond_init(&loader.header_read, NULL);
+    num_threads = num_threads > 0 ? num_threads : num_cores();
+    init_Queue(&loader.jobs, STREAM_QUEUE_PER_WORKER * num_threads);
+    pthread_t workers[num_threads];
+    for (size_t i = 0; i < num_threads; ++i)
+        pthread_create(&workers[i], NULL, stream_worker, &loader);
+    stream_read(&loader, filename);
+    queue_close(&loader.jobs);
+    for (size_t i = 0; i < num_threads; ++i)
+        pthread_join(workers[i], NULL);
+    fclose(loader.file);
+    free(loader.in);
+    pthread_mutex_destroy(&loader.header_mutex);
+    pthread_cond_destroy(&loader.header_read);
+
+    /* Join the blocks in order, each block's tail with the next one's head */
+    bool header = format->header != NULL, done = false;
+    if (header && loader.header != 1)
+    {
+        if (loader.header != -1)
+            printf("error: %s: no header line\n", filename);
+        done = true;
+    }
+    size_t capacity = 1;
+    for (size_t i = 0; i < loader.num_blocks; ++i)
+        capacity += loader.blocks[i]->num_rows + 1;
+    uint8_t *rows = done ? NULL : malloc(capacity * format->row_size);
+    char *carry = copy_text("", 0);
+    size_t carry_length = 0, size = format->row_size;
+    for (size_t i = 0; i < loader.num_blocks; ++i)
+    {
+        StreamBlock *block = loader.blocks[i];
+        if (!done && block->corrupt)
+        {
+            printf("error: %s: corrupt or truncated compressed data\n", filename);
+            done = true;
+        }
+        if (!done)
+        {
+            carry_append(&carry, &carry_length, block->head);
+            if (block->newline)
+            {
+                /* The first whole line is the header, read already */
+                int row = header ? 0 : format->parse(format->ctx, carry, rows + *n * size);
+                header = false;
+                *n += row > 0;
+                memcpy(rows + *n * size, block->rows, block->num_rows * size);
+                *n += row >= 0 ? block->num_rows : 0;
+                done = row < 0 || block->malformed;
+                carry_length = 0;
+                carry_append(&carry, &carry_length, block->tail);
+            }
+        }
+        free(block->rows);
+        free(block->head);
+        free(block->tail);
+        free(block->data);
+        free(block);
+    }
+    if (!done && !header && format->parse(format->ctx, carry, rows + *n * size) > 0)
+        ++*n;
+    free(carry);
+    free(loader.blocks);
+    delete_Queue(&loader.jobs);
+    if (stats != NULL)
+        *stats = loader.stats;
+    return rows;
+}
+
+int csv_row(void *ctx, const char *line, void *row)
+{
+    return parse_row(line, row);
+}
+
+/* Loads every "x, y, z" row of a CSV file, plain, gzip or zstd; NULL if it cannot be opened */
+vec3 *stream_csv(const char *filename, size_t num_threads, size_t *n, StreamStats *stats)
+{
+    StreamFormat format = {csv_row, NULL, NULL, sizeof(vec3)};
+    return stream_rows(filename, &format, num_threads, n, stats);
+}
+
+#endif
@@ -0,0 +1,294 @@
+#ifndef SUBPLOTS_H
+#define SUBPLOTS_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "render.h"
+#include "sampler.h"
+#include "axes.h"
+
+/*
+ * A grid of small plots in one window, drawn in one pass whatever the
+ * number of panels. Every panel's points share one vertex buffer, tagged
+ * with their panel's index in z. Every panel's view and rectangle share one
+ * std140 uniform buffer. A single instanced draw of segments, like
+ * polyline.h's, looks up each segment's panel and maps it through that
+ * panel's view into that panel's rectangle.
+ *
+ * GL 3.3 cannot change the viewport or scissor within a draw. Four clip
+ * distances against the rectangle cut each segment instead. Segments that
+ * join the last point of one panel to the first of the next are collapsed.
+ *
+ * Panel count only changes the size of the uniform buffer, so a frame
+ * costs what its points cost. Panning one panel rewrites its 32 bytes of
+ * that buffer. The frames around the panels are one more GL_LINES draw.
+ */
+
+#define SUBPLOTS_MAX 64 /* panels the uniform block holds, 2 KB in std140 */
+#define SUBPLOTS_GAP 6  /* between panels and around the grid, in screen coordinates */
+
+const char subplots_vertex_shader_source[] =
+    "#version 330 core\n"
+    "layout (location = 0) in vec3 a; /* x, y, panel */\n"
+    "layout (location = 1) in vec3 b;\n"
+    "struct Panel\n"
+    "{\n"
+    "    vec4 view; /* x0, x1, y0, y1 */\n"
+    "    vec4 rect; /* left, bottom, width, height in framebuffer pixels */\n"
+    "};\n"
+    "layout (std140) uniform Panels\n"
+    "{\n"
+    "    Panel panels[64]; /* SUBPLOTS_MAX */\n"
+    "};\n"
+    "uniform vec2 viewport;\n"
+    "uniform float width;\n"
+    "\n"
+    "vec2 to_pixels(vec3 p, Panel panel)\n"
+    "{\n"
+    "    return panel.rect.xy + (p.xy - panel.view.xz) / (panel.view.yw - panel.view.xz) * panel.rect.zw;\n"
+    "}\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "   Panel panel = panels[int(a.z)];\n"
+    "   vec2 pa = to_pixels(a, panel), pb = to_pixels(b, panel), d = pb - pa;\n"
+    "   if (a.z != b.z || any(isinf(d)) || any(isnan(d)))\n"
+    "   {\n"
+    "       gl_Position = vec4(2.0, 2.0, 0.0, 1.0);\n"
+    "       gl_ClipDistance[0] = gl_ClipDistance[1] = gl_ClipDistance[2] = gl_ClipDistance[3] = -1.0;\n"
+    "       return;\n"
+    "   }\n"
+    "   vec2 normal = dot(d, d) > 0.0 ? normalize(vec2(-d.y, d.x)) : vec2(0.0, 1.0);\n"
+    "   vec2 p = ((gl_VertexID >> 1) == 0 ? pa : pb) + normal * width * (float(gl_VertexID & 1) - 0.5);\n"
+    "   gl_ClipDistance[0] = p.x - panel.rect.x;\n"
+    "   gl_ClipDistance[1] = panel.rect.x + panel.rect.z - p.x;\n"
+    "   gl_ClipDistance[2] = p.y - panel.rect.y;\n"
+    "   gl_ClipDistance[3] = panel.rect.y + panel.rect.w - p.y;\n"
+    "   gl_Position = vec4(2.0 * p / viewport - 1.0, 0.0, 1.0);\n"
+    "}\n\0";
+
+/* One panel: its view, and its rectangle in screen coordinates from the top left, as the cursor's are */
+typedef struct Panel
+{
+    View view;
+    double x, y, width, height;
+} Panel;
+
+typedef struct Subplots
+{
+    uint program, VAO, VBO, UBO;
+    uint frame_program, frame_VAO, frame_VBO;
+    size_t rows, columns, num_panels;
+    Panel panels[SUBPLOTS_MAX];
+    size_t num_points; /* over all panels */
+    int fb_width, fb_height;
+    double pixels_x, pixels_y; /* framebuffer pixels per screen coordinate */
+} Subplots;
+
+/* A rows x columns grid of panels showing [-1, 1] x [-1, 1]; false if there are none or too many */
+bool init_Subplots(Subplots *subplots, size_t rows, size_t columns)
+{
+    if (rows == 0 || columns == 0 || rows * columns > SUBPLOTS_MAX)
+    {
+        printf("error: subplots need between 1 and %d panels, not %zu x %zu\n", SUBPLOTS_MAX, rows, columns);
+        return false;
+    }
+    subplots->rows = rows;
+    subplots->columns = columns;
+    subplots->num_panels = rows * columns;
+    for (size_t i = 0; i < subplots->num_panels; ++i)
+        subplots->panels[i] = (Panel) {{-1, 1, -1, 1, 0, 0}, 0, 0, 0, 0};
+    subplots->num_points = 0;
+    subplots->fb_width = subplots->fb_height = 0;
+    subplots->pixels_x = subplots->pixels_y = 0;
+
+    subplots->program = setup_shader_program(subplots_vertex_shader_source, plot_fragment_shader_source);
+    glUniformBlockBinding(subplots->program, glGetUniformBlockIndex(subplots->program, "Panels"), 0);
+    glGenBuffers(1, &subplots->UBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, subplots->UBO);
+    glBufferData(GL_UNIFORM_BUFFER, SUBPLOTS_MAX * 8 * sizeof(float), NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    /* Both attributes read the one buffer, a point apart, advancing once per segment */
+    glGenVertexArrays(1, &subplots->VAO);
+    glGenBuffers(1, &subplots->VBO);
+    glBindVertexArray(subplots->VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, subplots->VBO);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), (void *) 0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), (void *) sizeof(vec3));
+    for (uint i = 0; i < 2; ++i)
+    {
+        glEnableVertexAttribArray(i);
+        glVertexAttribDivisor(i, 1);
+    }
+
+    /* The frames, 4 lines a panel in NDC, drawn with the grid lines' shaders */
+    subplots->frame_program = setup_shader_program(axes_vertex_shader_source, axes_fragment_shader_source);
+    glGenVertexArrays(1, &subplots->frame_VAO);
+    glGenBuffers(1, &subplots->frame_VBO);
+    glBindVertexArray(subplots->frame_VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, subplots->frame_VBO);
+    glBufferData(GL_ARRAY_BUFFER, SUBPLOTS_MAX * 8 * sizeof(vec3), NULL, GL_DYNAMIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), (void *) 0);
+    glEnableVertexAttribArray(0);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return true;
+}
+
+void delete_Subplots(Subplots *subplots)
+{
+    glDeleteBuffers(3, (uint[]) {subplots->VBO, subplots->UBO, subplots->frame_VBO});
+    glDeleteVertexArrays(2, (uint[]) {subplots->VAO, subplots->frame_VAO});
+    glDeleteProgram(subplots->program);
+    glDeleteProgram(subplots->frame_program);
+}
+
+/* Writes one panel's view and rectangle into the uniform buffer */
+void subplots_write(Subplots *subplots, size_t i)
+{
+    Panel *panel = &subplots->panels[i];
+    double sx = subplots->pixels_x, sy = subplots->pixels_y;
+    float block[8] = {
+        panel->view.x0, panel->view.x1, panel->view.y0, panel->view.y1,
+        panel->x * sx, subplots->fb_height - (panel->y + panel->height) * sy, panel->width * sx, panel->height * sy,
+    };
+    glBindBuffer(GL_UNIFORM_BUFFER, subplots->UBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, i * sizeof(block), sizeof(block), block);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+/*
+ * Lays the panels out over a window of window_width x window_height screen
+ * coordinates and fb_width x fb_height pixels, rewriting the whole uniform
+ * buffer and the frames. Call it on every resize.
+ */
+void subplots_layout(Subplots *subplots, int window_width, int window_height, int fb_width, int fb_height)
+{
+    if (window_width <= 0 || window_height <= 0)
+        return;
+    subplots->fb_width = fb_width;
+    subplots->fb_height = fb_height;
+    subplots->pixels_x = (double) fb_width / window_width;
+    subplots->pixels_y = (double) fb_height / window_height;
+    double width = (double) (window_width - SUBPLOTS_GAP) / subplots->columns - SUBPLOTS_GAP;
+    double height = (double) (window_height - SUBPLOTS_GAP) / subplots->rows - SUBPLOTS_GAP;
+    width = width > 1 ? width : 1;
+    height = height > 1 ? height : 1;
+    vec3 frames[SUBPLOTS_MAX * 8];
+    for (size_t i = 0; i < subplots->num_panels; ++i)
+    {
+        Panel *panel = &subplots->panels[i];
+        panel->x = SUBPLOTS_GAP + (i % subplots->columns) * (width + SUBPLOTS_GAP);
+        panel->y = SUBPLOTS_GAP + (i / subplots->columns) * (height + SUBPLOTS_GAP);
+        panel->width = width;
+        panel->height = height;
+        panel->view.width = width;
+        panel->view.height = height;
+        subplots_write(subplots, i);
+
+        float x0 = 2 * panel->x / window_width - 1, x1 = 2 * (panel->x + width) / window_width - 1;
+        float y1 = 1 - 2 * panel->y / window_height, y0 = 1 - 2 * (panel->y + height) / window_height;
+        vec3 corners[4] = {{x0, y0, 0.5f}, {x1, y0, 0.5f}, {x1, y1, 0.5f}, {x0, y1, 0.5f}};
+        for (int c = 0; c < 4; ++c)
+        {
+            frames[8 * i + 2 * c] = corners[c];
+            frames[8 * i + 2 * c + 1] = corners[(c + 1) % 4];
+        }
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, subplots->frame_VBO);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, subplots->num_panels * 8 * sizeof(vec3), frames);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/* Changes one panel's view; its size on screen stays the layout's */
+void subplots_set_view(Subplots *subplots, size_t i, View view)
+{
+    view.width = subplots->panels[i].view.width;
+    view.height = subplots->panels[i].view.height;
+    subplots->panels[i].view = view;
+    subplots_write(subplots, i);
+}
+
+/* The panel under a point in screen coordinates, or SIZE_MAX between panels */
+size_t subplots_panel_at(const Subplots *subplots, double x, double y)
+{
+    for (size_t i = 0; i < subplots->num_panels; ++i)
+    {
+        const Panel *panel = &subplots->panels[i];
+        if (x >= panel->x && x < panel->x + panel->width && y >= panel->y && y < panel->y + panel->height)
+            return i;
+    }
+    return SIZE_MAX;
+}
+
+/* Uploads points already tagged with their panels in one glBufferData */
+void subplots_buffer(Subplots *subplots, size_t n, const vec3 *points)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, subplots->VBO);
+    glBufferData(GL_ARRAY_BUFFER, n * sizeof(vec3), points, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    subplots->num_points = n;
+}
+
+/*
+ * Replaces every panel's points: counts[i] points from series[i] for panel
+ * i, for as many panels as the grid has. They are copied into one buffer,
+ * tagged with their panel, and uploaded in one glBufferData.
+ */
+void subplots_upload(Subplots *subplots, const size_t counts[], vec3 *const series[])
+{
+    size_t total = 0;
+    for (size_t i = 0; i < subplots->num_panels; ++i)
+        total += counts[i];
+    vec3 *points = malloc((total > 0 ? total : 1) * sizeof(vec3));
+    size_t k = 0;
+    for (size_t i = 0; i < subplots->num_panels; ++i)
+        for (size_t j = 0; j < counts[i]; ++j)
+            points[k++] = (vec3) {series[i][j].x, series[i][j].y, i};
+    subplots_buffer(subplots, total, points);
+    free(points);
+}
+
+/*
+ * Replaces every panel's points with one series of n points each, all on
+ * the same x, as columns.h reads them: series i goes in panel i, and any
+ * panels past the last series stay empty.
+ */
+void subplots_upload_columns(Subplots *subplots, size_t n, const float *x, float *const y[], size_t num_series)
+{
+    size_t shown = num_series < subplots->num_panels ? num_series : subplots->num_panels;
+    vec3 *points = malloc((n * shown > 0 ? n * shown : 1) * sizeof(vec3));
+    for (size_t i = 0; i < shown; ++i)
+        for (size_t j = 0; j < n; ++j)
+            points[i * n + j] = (vec3) {x[j], y[i][j], i};
+    subplots_buffer(subplots, n * shown, points);
+    free(points);
+}
+
+/* Draws every panel's lines, `width` pixels wide, in one call, then their frames in another */
+void subplots_draw(Subplots *subplots, float width)
+{
+    if (subplots->num_points >= 2)
+    {
+        for (int i = 0; i < 4; ++i)
+            glEnable(GL_CLIP_DISTANCE0 + i);
+        glUseProgram(subplots->program);
+        glBindBufferBase(GL_UNIFORM_BUFFER, 0, subplots->UBO);
+        glUniform2f(glGetUniformLocation(subplots->program, "viewport"), subplots->fb_width, subplots->fb_height);
+        glUniform1f(glGetUniformLocation(subplots->program, "width"), width);
+        glBindVertexArray(subplots->VAO);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, subplots->num_points - 1);
+        for (int i = 0; i < 4; ++i)
+            glDisable(GL_CLIP_DISTANCE0 + i);
+    }
+    glUseProgram(subplots->frame_program);
+    glBindVertexArray(subplots->frame_VAO);
+    glDrawArrays(GL_LINES, 0, subplots->num_panels * 8);
+    glBindVertexArray(0);
+    glUseProgram(0);
+}
+
+#endif
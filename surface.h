@@ -0,0 +1,180 @@
+#ifndef SURFACE_H
+#define SURFACE_H
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "grid.h"
+#include "mathlib.h"
+#include "threads.h"
+
+/*
+ * 3D surfaces of a grid: one vertex per sample, shared by the cells around
+ * it, with z the sample's value. Vertices are placed in a unit box, x and y
+ * over [-1, 1] and z over [-SURFACE_HEIGHT, SURFACE_HEIGHT], so that the
+ * camera need not know the data's units and the normals can be packed.
+ *
+ * Both index lists are strips separated by SURFACE_RESTART, for drawing
+ * with primitive restart: triangles as one strip per row of cells, about
+ * two indices a cell, and the wireframe as one line strip per row and per
+ * column, about two more. Normals are central differences of the surface,
+ * one-sided on the edges, packed as GL_INT_2_10_10_10_REV. That makes 12
+ * bytes of position, 4 of normal and about 16 of indices per cell; the
+ * three passes over the grid all run across threads by rows or columns.
+ */
+
+#define SURFACE_HEIGHT 0.5f
+#define SURFACE_RESTART UINT32_MAX
+
+typedef struct Surface
+{
+    vec3 *vertices;        /* width * height */
+    uint32_t *normals;     /* width * height, packed */
+    uint32_t *triangles;   /* row strips */
+    uint32_t *lines;       /* row strips, then column strips */
+    size_t num_triangle_indices, num_line_indices;
+    size_t width, height;
+} Surface;
+
+void delete_Surface(Surface *surface)
+{
+    free(surface->vertices);
+    free(surface->normals);
+    free(surface->triangles);
+    free(surface->lines);
+    *surface = (Surface) {0};
+}
+
+/* GPU and CPU bytes per cell of the built surface */
+double surface_bytes_per_cell(const Surface *surface)
+{
+    size_t vertices = surface->width * surface->height;
+    size_t bytes = vertices * (sizeof(vec3) + sizeof(uint32_t))
+        + (surface->num_triangle_indices + surface->num_line_indices) * sizeof(uint32_t);
+    return (double) bytes / ((surface->width - 1) * (surface->height - 1));
+}
+
+uint32_t pack_normal(vec3 n)
+{
+    int x = lrintf(n.x * 511), y = lrintf(n.y * 511), z = lrintf(n.z * 511);
+    return (x & 1023) | (y & 1023) << 10 | (uint32_t) (z & 1023) << 20;
+}
+
+typedef struct SurfaceJob
+{
+    const Grid *grid;
+    Surface *surface;
+    float z0, scale; /* z = (value - z0) * scale - SURFACE_HEIGHT */
+} SurfaceJob;
+
+void surface_rows(void *ctx, size_t thread, size_t begin, size_t end)
+{
+    SurfaceJob *job = ctx;
+    const Grid *grid = job->grid;
+    Surface *surface = job->surface;
+    size_t w = grid->width, h = grid->height;
+
+    /* NaN samples sit on the floor of the box */
+    for (size_t j = begin; j < end; ++j)
+    {
+        float y = -1 + 2.0f * j / (h - 1);
+        for (size_t i = 0; i < w; ++i)
+        {
+            float v = grid->values[j * w + i];
+            float z = isnan(v) ? -SURFACE_HEIGHT : (v - job->z0) * job->scale - SURFACE_HEIGHT;
+            surface->vertices[j * w + i] = (vec3) {-1 + 2.0f * i / (w - 1), y, z};
+        }
+    }
+
+    /* From the grid rather than the vertices, whose neighbouring rows may belong to other threads */
+    float dx = 2.0f / (w - 1), dy = 2.0f / (h - 1);
+    for (size_t j = begin; j < end; ++j)
+    {
+        size_t j0 = j > 0 ? j - 1 : j, j1 = j + 1 < h ? j + 1 : j;
+        for (size_t i = 0; i < w; ++i)
+        {
+            size_t i0 = i > 0 ? i - 1 : i, i1 = i + 1 < w ? i + 1 : i;
+            float left = grid->values[j * w + i0], right = grid->values[j * w + i1];
+            float below = grid->values[j0 * w + i], above = grid->values[j1 * w + i];
+            float gx = (right - left) * job->scale / ((i1 - i0) * dx);
+            float gy = (above - below) * job->scale / ((j1 - j0) * dy);
+            vec3 n = isfinite(gx) && isfinite(gy) ? unit((vec3) {-gx, -gy, 1}) : (vec3) {0, 0, 1};
+            surface->normals[j * w + i] = pack_normal(n);
+        }
+
+        if (j + 1 < h)
+        {
+            uint32_t *strip = &surface->triangles[j * (2 * w + 1)];
+            for (size_t i = 0; i < w; ++i)
+            {
+                strip[2 * i] = (j + 1) * w + i;
+                strip[2 * i + 1] = j * w + i;
+            }
+            strip[2 * w] = SURFACE_RESTART;
+        }
+        uint32_t *strip = &surface->lines[j * (w + 1)];
+        for (size_t i = 0; i < w; ++i)
+            strip[i] = j * w + i;
+        strip[w] = SURFACE_RESTART;
+    }
+}
+
+void surface_columns(void *ctx, size_t thread, size_t begin, size_t end)
+{
+    SurfaceJob *job = ctx;
+    size_t w = job->grid->width, h = job->grid->height;
+    for (size_t i = begin; i < end; ++i)
+    {
+        uint32_t *strip = &job->surface->lines[h * (w + 1) + i * (h + 1)];
+        for (size_t j = 0; j < h; ++j)
+            strip[j] = j * w + i;
+        strip[h] = SURFACE_RESTART;
+    }
+}
+
+/*
+ * Builds the surface of a grid on num_threads threads (0 for every core).
+ * Returns false if the grid is too small or has more samples than 32-bit
+ * indices can address.
+ */
+bool init_Surface(Surface *surface, const Grid *grid, size_t num_threads)
+{
+    size_t w = grid->width, h = grid->height;
+    *surface = (Surface) {0};
+    if (w < 2 || h < 2 || (uint64_t) w * h >= SURFACE_RESTART)
+    {
+        printf("error: cannot build a surface of %zu x %zu samples\n", w, h);
+        return false;
+    }
+    num_threads = num_threads ? num_threads : num_cores();
+
+    float z0 = INFINITY, z1 = -INFINITY;
+    for (size_t c = 0; c < w * h; ++c)
+    {
+        z0 = grid->values[c] < z0 ? grid->values[c] : z0;
+        z1 = grid->values[c] > z1 ? grid->values[c] : z1;
+    }
+    SurfaceJob job = {grid, surface, z0, z1 > z0 ? 2 * SURFACE_HEIGHT / (z1 - z0) : 0};
+
+    surface->width = w;
+    surface->height = h;
+    surface->num_triangle_indices = (h - 1) * (2 * w + 1);
+    surface->num_line_indices = h * (w + 1) + w * (h + 1);
+    surface->vertices = malloc(w * h * sizeof(vec3));
+    surface->normals = malloc(w * h * sizeof(uint32_t));
+    surface->triangles = malloc(surface->num_triangle_indices * sizeof(uint32_t));
+    surface->lines = malloc(surface->num_line_indices * sizeof(uint32_t));
+    if (surface->vertices == NULL || surface->normals == NULL || surface->triangles == NULL || surface->lines == NULL)
+    {
+        printf("error: out of memory building a surface of %zu x %zu samples\n", w, h);
+        delete_Surface(surface);
+        return false;
+    }
+    parallel_for(num_threads, h, surface_rows, &job);
+    parallel_for(num_threads, w, surface_columns, &job);
+    return true;
+}
+
+#endif
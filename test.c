@@ -3,10 +3,33 @@
 #include <stdlib.h>
 #include <string.h>
 #include "mathlib.h"
-#include <glad/glad.h>
-#include <GLFW/glfw3.h>
-
-typedef uint uint;
+#include "mesh.h"
+#include "render.h"
+#include "batch.h"
+#include "profile.h"
+#include "series.h"
+#include "uploader.h"
+#include "pick.h"
+#include "sampler.h"
+#include "expr.h"
+#include "heatmap.h"
+#include "density.h"
+#include "contour.h"
+#include "plot3d.h"
+#include "text.h"
+#include "axes.h"
+#include "polyline.h"
+#include "subplots.h"
+#include "multiwindow.h"
+#include "columns.h"
+#include "timestamps.h"
+
+/* Longest the event-driven loop sleeps without any event, in seconds */
+#define IDLE_TIMEOUT 1.0
+/* How close the cursor must be to a sample to hover it, in pixels */
+#define HOVER_RADIUS 8.0f
+/* How long the loop sleeps while GPU reads (picks, density statistics) are in flight, in seconds */
+#define READBACK_POLL 0.001
 
 void processInput(GLFWwindow *window)
 {
@@ -20,354 +43,1027 @@ void processInput(GLFWwindow *window)
 void framebuffer_size_callback(GLFWwindow *window, int width, int height)
 {
     glViewport(0, 0, width, height);
+    request_redraw();
 }
 
-/* Done */
-vec3 *read_to_vertices(const char *filename)
+/* Presses of X and Y not yet applied to the axis scales */
+int scale_presses[2] = {0, 0};
+
+/* Any input may change what is on screen */
+void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods)
 {
-    vec3 *vertices = (vec3 *) calloc(50, sizeof(vec3));
-    FILE *file;
-    file = fopen(filename, "r");
-    for (int i = 0; i < 50; ++i)
-    {
-        vec3 *curr = &vertices[i];
-        fscanf(file, "%20f, %20f, %20f", &curr->x, &curr->y, &curr->z);
-    }
-    return vertices;
+    if (action == GLFW_PRESS && (key == GLFW_KEY_X || key == GLFW_KEY_Y))
+        ++scale_presses[key == GLFW_KEY_Y];
+    request_redraw();
 }
 
-/* Done */
-void normalize(vec3 *vertices)
+void cursor_pos_callback(GLFWwindow *window, double x, double y)
 {
-    float xmin, xmax, ymin, ymax;
-    for (int i = 0; i < 50; ++i)
-    {
-        xmin = min(xmin, vertices[i].x);
-        xmax = max(xmax, vertices[i].x);
-        ymin = min(ymin, vertices[i].y);
-        ymax = max(ymax, vertices[i].y);
-    }
-
-    for (int i = 0; i < 50; ++i)
-    {
-        vertices[i].x = 2 * (vertices[i].x - xmin) / (xmax - xmin) - 1;
-        vertices[i].y = 2 * (vertices[i].y - ymin) / (ymax - ymin) - 1;
-    }
+    request_redraw();
 }
 
-typedef struct Mesh
+void mouse_button_callback(GLFWwindow *window, int button, int action, int mods)
 {
-    size_t num_vertices;
-    size_t num_indices;
-    vec3 *vertices;
-    uint *indices;
-} Mesh;
-
-/* Done */
-Mesh line(size_t n, vec3 vertices[n], float width)
+    request_redraw();
+}
+
+/* Wheel steps not yet applied to the view */
+double scroll_steps = 0;
+
+void scroll_callback(GLFWwindow *window, double dx, double dy)
 {
-    if (n < 2)
-    {
-        printf("error: must have at least two points to form a line\n");
-        exit(1);
-    }
-
-    float dx, dy, norm;
-    Mesh out;
-
-    // Allocate mesh
-    out.num_vertices = 2 * n;
-    out.num_indices = 6 * (n - 1);
-    out.vertices = calloc(out.num_vertices, sizeof(vec3));
-    out.indices = calloc(out.num_indices, sizeof(uint));
-
-    // Left boundary
-    dx = vertices[1].x - vertices[0].x;
-    dy = vertices[1].y - vertices[0].y;
-    norm = sqrt(dx * dx + dy * dy);
-    dx = width * dx / norm;
-    dy = width * dy / norm;
-    out.vertices[0].x = vertices[0].x - dy;
-    out.vertices[0].y = vertices[0].y + dx;
-    out.vertices[1].x = vertices[0].x + dy;
-    out.vertices[1].y = vertices[0].y - dx;
-
-    // Right boundary
-    dx = vertices[n - 1].x - vertices[n - 2].x;
-    dy = vertices[n - 1].y - vertices[n - 2].y;
-    norm = sqrt(dx * dx + dy * dy);
-    dx = width * dx / norm;
-    dy = width * dy / norm;
-    out.vertices[2 * n - 2].x = vertices[n - 1].x - dy;
-    out.vertices[2 * n - 2].y = vertices[n - 1].y + dx;
-    out.vertices[2 * n - 1].x = vertices[n - 1].x + dy;
-    out.vertices[2 * n - 1].y = vertices[n - 1].y - dx;
-
-    // Interior
-    for (size_t i = 1; i < n - 1; ++i)
-    {
-        dx = vertices[i + 1].x + vertices[i].x - vertices[i - 1].x;
-        dy = vertices[i + 1].y + vertices[i].y - vertices[i - 1].y;
-        norm = sqrt(dx * dx + dy * dy);
-        dx = width * dx / norm;
-        dy = width * dy / norm;
-        out.vertices[2 * i].x = vertices[i].x - dy;
-        out.vertices[2 * i].y = vertices[i].y + dx;
-        out.vertices[2 * i + 1].x = vertices[i].x + dy;
-        out.vertices[2 * i + 1].y = vertices[i].y - dx;
-    }
-
-    // Indices
-    for (size_t i = 0; i < n - 1; ++i)
-    {
-        out.indices[6 * i] = 2 * i;
-        out.indices[6 * i + 1] = 2 * i + 1;
-        out.indices[6 * i + 2] = 2 * i + 2;
-        out.indices[6 * i + 3] = 2 * i + 3;
-        out.indices[6 * i + 4] = 2 * i + 2;
-        out.indices[6 * i + 5] = 2 * i + 1;
-    }
-
-    return out;
+    scroll_steps += dy;
+    request_redraw();
 }
 
-typedef struct GameObject
+void window_refresh_callback(GLFWwindow *window)
 {
-    uint program, VAO, VBO, EBO;
-    char *vertex_shader_source;
-    char *fragment_shader_source;
-    Mesh mesh;
-} GameObject;
+    request_redraw();
+}
 
-uint setup_shader_program(const char *vertex_shader_source, const char *fragment_shader_source)
+/* Pans with the left button and zooms about the cursor with the wheel; true if the view changed */
+bool pan_zoom(GLFWwindow *window, View *view, double cursor_x, double cursor_y, double last_x, double last_y)
 {
-    /*
-     * 1. Compile vertex shader
-     * 2. Compile fragment shader
-     * 3. Compile shader program
-     * 4. Delete shaders
-     */
-    int success;
-    char log[512];
-
-    /* Vertex Shader */
-    unsigned int vertex_shader;
-    vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex_shader, 1, &vertex_shader_source, NULL);
-    glCompileShader(vertex_shader);
-    glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &success);
-    if (!success)
-    {
-        glGetShaderInfoLog(vertex_shader, 512, NULL, log);
-        printf("error compiling vertex shader: %s\n", log);
-        return -1;
-    }
-
-    /* Fragment Shader */
-    unsigned int fragment_shader;
-    fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment_shader, 1, &fragment_shader_source, NULL);
-    glCompileShader(fragment_shader);
-    glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &success);
-    if (!success)
-    {
-        glGetShaderInfoLog(fragment_shader, 512, NULL, log);
-        printf("error compiling fragment shader: %s\n", log);
-        return -1;
-    }
-
-    /* Shader Program */
-    unsigned int shader_program;
-    shader_program = glCreateProgram();
-    glAttachShader(shader_program, vertex_shader);
-    glAttachShader(shader_program, fragment_shader);
-    glLinkProgram(shader_program);
-    glGetProgramiv(shader_program, GL_LINK_STATUS, &success);
-    if (!success)
-    {
-        glGetProgramInfoLog(shader_program, 512, NULL, log);
-        printf("error linking shader program: %s\n", log);
-        return -1;
-    }
-    glDeleteShader(vertex_shader);
-    glDeleteShader(fragment_shader);
-
-    return shader_program;
+    bool changed = false;
+    double ux = (view->x1 - view->x0) / view->width, uy = (view->y1 - view->y0) / view->height;
+    if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS && (cursor_x != last_x || cursor_y != last_y))
+    {
+        double dx = (cursor_x - last_x) * ux, dy = (cursor_y - last_y) * uy;
+        view->x0 -= dx;
+        view->x1 -= dx;
+        view->y0 += dy;
+        view->y1 += dy;
+        changed = true;
+    }
+    if (scroll_steps != 0)
+    {
+        double factor = pow(0.9, scroll_steps);
+        double x = view->x0 + cursor_x * ux, y = view->y1 - cursor_y * uy;
+        view->x0 = x + (view->x0 - x) * factor;
+        view->x1 = x + (view->x1 - x) * factor;
+        view->y0 = y + (view->y0 - y) * factor;
+        view->y1 = y + (view->y1 - y) * factor;
+        scroll_steps = 0;
+        changed = true;
+    }
+    return changed;
 }
 
-void setup(GameObject *rend)
+/* Accumulates the points' density and tone maps it into the framebuffer currently bound */
+void draw_density(Profiler *profiler, Density *density, GameObject *points, GLenum primitive, View view,
+                  Scale x_scale, Scale y_scale, int width, int height)
 {
-    /*
-     * 1. Compile program
-     * 2. Bind VAO
-     * 3. Copy our vertices into a VBO
-     * 4. Copy Index array into an EBO
-     * 5. Set the VAPs
-     * 6. Unbind objects
-     */
-    rend->program = setup_shader_program(rend->vertex_shader_source, rend->fragment_shader_source);
-    printf("\x1b[34mHere\x1b[0m\n");
+    density_begin(density, width, height);
+    PROFILE_DRAW(profiler, "density accumulate", density_draw(points, primitive, view, x_scale, y_scale, 1));
+    PROFILE_DRAW(profiler, "density tone map", density_end(density));
+}
 
-    glGenVertexArrays(1, &rend->VAO);
-    glBindVertexArray(rend->VAO);
+/* A random walk of n points over x in [0, 1), for benchmarks */
+vec3 *random_walk(size_t n, uint64_t seed)
+{
+    vec3 *points = malloc(n * sizeof(vec3));
+    uint64_t state = seed;
+    float y = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        y += ((state >> 40) / 16777216.0f - 0.5f) * 0.01f;
+        points[i] = (vec3) {(float) i / n, y, 0};
+    }
+    return points;
+}
 
-    glGenBuffers(1, &rend->VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, rend->VBO);
-    glBufferData(GL_ARRAY_BUFFER, rend->mesh.num_vertices * sizeof(vec3), rend->mesh.vertices, GL_STATIC_DRAW);
+/*
+ * GPU density accumulation against CPU binning of the same points into a
+ * 1920x1080 grid: a random walk of 10^7 points, then 10^8 and so on up to
+ * max_points, drawn as points and as a line strip. GPU times are from
+ * glFinish(), so they include the whole draw but not the upload.
+ */
+int run_density_bench(size_t max_points, size_t reps)
+{
+    GLFWwindow *window = init_glfw(framebuffer_size_callback);
+    Density density;
+    init_Density(&density, DENSITY_LOG);
+    GameObject series;
+    series.vertex_shader_source = strdup(density_vertex_shader_source);
+    series.fragment_shader_source = strdup(density_fragment_shader_source);
+    series.mesh = (Mesh) {0};
+    setup(&series);
+    glViewport(0, 0, 1920, 1080);
+    Scale linear = {SCALE_LINEAR, SCALE_THRESHOLD};
+
+    for (size_t n = 10000000; n <= max_points; n *= 10)
+    {
+        vec3 *points = random_walk(n, 0x9e3779b97f4a7c15ull);
+        series.mesh = (Mesh) {n, 0, points, NULL, false};
+        upload(&series, GL_STATIC_DRAW);
+        double bounds[4];
+        histogram_bounds(points, n, num_cores(), bounds);
+        View view = {bounds[0], bounds[1], bounds[2], bounds[3], 1920, 1080};
+
+        const char *names[] = {"density points", "density lines", "heatmap cpu"};
+        for (size_t c = 0; c < 3; ++c)
+        {
+            double best = INFINITY;
+            Binner binner = {points, n, false};
+            binner.num_threads = num_cores();
+            Histogram hist = {malloc((size_t) 1920 * 1080 * sizeof(float)), 1920, 1080};
+            for (size_t r = 0; r < reps + 1; ++r)
+            {
+                double t0 = now_seconds();
+                if (c < 2)
+                {
+                    density_begin(&density, 1920, 1080);
+                    density_draw(&series, c == 0 ? GL_POINTS : GL_LINE_STRIP, view, linear, linear, 1);
+                    glDisable(GL_BLEND);
+                    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+                    glFinish();
+                }
+                else
+                {
+                    bin_range(&binner, 0, n, view.x0, view.x1, view.y0, view.y1, 1920, 1080, NULL, hist.values);
+                }
+                /* The first run warms up */
+                double elapsed = now_seconds() - t0;
+                best = r > 0 && elapsed < best ? elapsed : best;
+            }
+            printf("%-16s %11zu  min %10.4f ms  %8.2f Mpts/s\n", names[c], n, 1e3 * best, n / best / 1e6);
+            delete_Binner(&binner);
+            delete_Histogram(&hist);
+        }
+        series.mesh = (Mesh) {0};
+        free(points);
+    }
 
-    glGenBuffers(1, &rend->EBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, rend->EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, rend->mesh.num_indices * sizeof(uint), rend->mesh.indices, GL_STATIC_DRAW);
+    delete_GameObject(&series);
+    delete_Density(&density);
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return 0;
+}
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_TRUE, sizeof(vec3), (void *)0);
-    glEnableVertexAttribArray(0);
+/* Moves an axis on to the next scale, keeping the values in view where it can */
+void cycle_scale(Scale *scale, Extent extent, double *s0, double *s1)
+{
+    Scale next = {(scale->type + 1) % (SCALE_SYMLOG + 1), scale->threshold};
+    rescale_range(*scale, next, extent, s0, s1);
+    *scale = next;
+}
 
-    glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0); /* Unbind VBO */
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0); /* Unbind EBO */
+/* Turns the camera with the left button and moves it in with the wheel; true if it moved */
+bool orbit(GLFWwindow *window, Camera *camera, double cursor_x, double cursor_y, double last_x, double last_y)
+{
+    bool dragged = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS
+        && (cursor_x != last_x || cursor_y != last_y);
+    if (!dragged && scroll_steps == 0)
+        return false;
+    camera_orbit(camera, dragged ? cursor_x - last_x : 0, dragged ? cursor_y - last_y : 0, scroll_steps);
+    scroll_steps = 0;
+    return true;
 }
 
-void draw(GameObject *rend)
+/*
+ * Frame times for a size x size surface of example_grid() at 1920x1080,
+ * filled, as a wireframe and both, with the build and upload times and
+ * bytes per cell. Times are from glFinish() and the best of `reps`.
+ */
+int run_surface_bench(size_t size, size_t reps)
 {
-    glUseProgram(rend->program);
-    glBindVertexArray(rend->VAO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, rend->EBO);
+    GLFWwindow *window = init_glfw(framebuffer_size_callback);
+    Grid grid = {malloc(size * size * sizeof(float)), size, size, -1, 1, -1, 1};
+    if (grid.values == NULL || size < 2)
+    {
+        printf("error: cannot make a %zu x %zu grid\n", size, size);
+        return 1;
+    }
+    example_grid(&grid);
+
+    Surface surface;
+    double t0 = now_seconds();
+    if (!init_Surface(&surface, &grid, 0))
+        return 1;
+    double build = now_seconds() - t0;
+    SurfacePlot plot;
+    init_SurfacePlot(&plot);
+    t0 = now_seconds();
+    surface_upload(&plot, &surface);
+    glFinish();
+    double upload = now_seconds() - t0;
+    printf("surface %zux%zu: built in %.3f ms, uploaded in %.3f ms, %.2f bytes per cell\n", size, size,
+           1e3 * build, 1e3 * upload, surface_bytes_per_cell(&surface));
+    delete_Surface(&surface);
+    delete_Grid(&grid);
+
+    /* Rendered offscreen so the window's size does not matter */
+    uint FBO, color, depth;
+    glGenFramebuffers(1, &FBO);
+    glGenRenderbuffers(1, &color);
+    glGenRenderbuffers(1, &depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, 1920, 1080);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 1920, 1080);
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+    glViewport(0, 0, 1920, 1080);
+
+    const char *names[] = {"surface filled", "surface wireframe", "surface both"};
+    Camera camera = default_camera();
+    for (SurfaceStyle style = SURFACE_FILLED; style <= SURFACE_BOTH; ++style)
+    {
+        double best = INFINITY;
+        for (size_t r = 0; r < reps + 1; ++r)
+        {
+            /* A different angle each frame, as when orbiting */
+            camera.yaw += 0.05f;
+            t0 = now_seconds();
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            surface_draw(&plot, camera, 1920.0f / 1080, style);
+            glFinish();
+            double elapsed = now_seconds() - t0;
+            best = r > 0 && elapsed < best ? elapsed : best;
+        }
+        printf("%-18s frame %10.4f ms\n", names[style], 1e3 * best);
+    }
 
-    glDrawElements(GL_TRIANGLES, rend->mesh.num_indices, GL_UNSIGNED_INT, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &FBO);
+    glDeleteRenderbuffers(2, (uint[]){color, depth});
+    delete_SurfacePlot(&plot);
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return 0;
+}
 
-    glBindVertexArray(0);
-    glUseProgram(0);
+/*
+ * Lays out and draws `labels` numbers of up to 12 characters scattered over
+ * a 1920x1080 framebuffer, as axis labels would be every frame while
+ * panning. Layout is timed on the CPU, upload and draw up to glFinish().
+ */
+int run_text_bench(size_t labels, size_t reps)
+{
+    GLFWwindow *window = init_glfw(framebuffer_size_callback);
+    TextRenderer text;
+    init_TextRenderer(&text);
+    TextBatch batch;
+    init_TextBatch(&batch, 0);
+
+    uint FBO, color;
+    glGenFramebuffers(1, &FBO);
+    glGenRenderbuffers(1, &color);
+    glBindRenderbuffer(GL_RENDERBUFFER, color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, 1920, 1080);
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+    glViewport(0, 0, 1920, 1080);
+
+    double best_layout = INFINITY, best_draw = INFINITY;
+    for (size_t r = 0; r < reps + 1; ++r)
+    {
+        /* New values each frame, as when panning */
+        double t0 = now_seconds();
+        text_clear(&batch);
+        for (size_t i = 0; i < labels; ++i)
+            text_addf(&batch, (i * 7919) % 1920, (i * 104729) % 1080, 0, 0, 1, rgba(1, 1, 1, 1), "%.6g",
+                      r + i * 1e-3);
+        double t1 = now_seconds();
+        glClear(GL_COLOR_BUFFER_BIT);
+        text_draw(&text, &batch, 1920, 1080);
+        glFinish();
+        double t2 = now_seconds();
+        best_layout = r > 0 && t1 - t0 < best_layout ? t1 - t0 : best_layout;
+        best_draw = r > 0 && t2 - t1 < best_draw ? t2 - t1 : best_draw;
+    }
+    printf("%zu labels, %zu glyphs: layout %.3f ms, upload and draw %.3f ms, frame %.3f ms\n", labels, batch.count,
+           1e3 * best_layout, 1e3 * best_draw, 1e3 * (best_layout + best_draw));
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &FBO);
+    glDeleteRenderbuffers(1, &color);
+    delete_TextBatch(&batch);
+    delete_TextRenderer(&text);
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return 0;
 }
 
-void delete_Mesh(Mesh *mesh)
+/*
+ * GPU cost per frame of the grid lines, against one draw of a 10^4-point
+ * thick line, at 1920x1080. Each frame pans the view, so the grid's ticks
+ * are recomputed and its buffer rewritten every time as well. Frames are
+ * timed in runs of 100 up to glFinish(), less the cost of a bare clear.
+ */
+int run_axes_bench(size_t reps)
 {
+    GLFWwindow *window = init_glfw(framebuffer_size_callback);
+    Axes axes;
+    init_Axes(&axes);
+    GameObject plot;
+    plot.vertex_shader_source = strdup(plot_vertex_shader_source);
+    plot.fragment_shader_source = strdup(plot_fragment_shader_source);
+    size_t n = 10000;
+    vec3 *points = malloc(n * sizeof(vec3));
+    for (size_t i = 0; i < n; ++i)
+        points[i] = (vec3) {-1 + 2.0f * i / (n - 1), 0.8f * sinf(40.0f * i / n), 0};
+    plot.mesh = line(n, points, 0.01f);
+    free(points);
+    setup(&plot);
+
+    uint FBO, color;
+    glGenFramebuffers(1, &FBO);
+    glGenRenderbuffers(1, &color);
+    glBindRenderbuffer(GL_RENDERBUFFER, color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, 1920, 1080);
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+    glViewport(0, 0, 1920, 1080);
+
+    const char *names[] = {"clear", "grid", "line"};
+    double best[3] = {INFINITY, INFINITY, INFINITY};
+    Ticks x, y;
+    for (size_t r = 0; r < reps + 1; ++r)
+    {
+        for (int c = 0; c < 3; ++c)
+        {
+            double t0 = now_seconds();
+            for (int frame = 0; frame < 100; ++frame)
+            {
+                glClear(GL_COLOR_BUFFER_BIT);
+                if (c == 1)
+                {
+                    double pan = 1e-3 * (r * 100 + frame);
+                    compute_ticks(&x, TICKS_LINEAR, -1 + pan, 1 + pan, 1920 / TICK_SPACING_X);
+                    compute_ticks(&y, TICKS_LINEAR, -1 + pan, 1 + pan, 1080 / TICK_SPACING_Y);
+                    axes_update(&axes, &x, &y);
+                    axes_draw(&axes);
+                }
+                else if (c == 2)
+                    draw(&plot);
+            }
+            glFinish();
+            double elapsed = (now_seconds() - t0) / 100;
+            best[c] = r > 0 && elapsed < best[c] ? elapsed : best[c];
+        }
+    }
+    for (int c = 1; c < 3; ++c)
+        printf("%-5s %10.4f ms per frame over a clear\n", names[c], 1e3 * (best[c] - best[0]));
+    printf("grid: %zu vertices, %zu bytes per update, %.2f of a line draw\n", axes.num_vertices,
+           axes.num_vertices * sizeof(vec3), (best[1] - best[0]) / (best[2] - best[0]));
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &FBO);
+    glDeleteRenderbuffers(1, &color);
+    delete_GameObject(&plot);
+    delete_Axes(&axes);
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return 0;
+}
 
+/*
+ * Grids of panels in one pass against the same panels drawn one at a time,
+ * each with its own viewport, scissor and draw, at 1920x1080: first the
+ * same total of points over 1 to 64 panels, then 32 panels with 10^5 points
+ * in all up to max_points. Frames are timed up to glFinish().
+ */
+int run_subplots_bench(size_t max_points, size_t reps)
+{
+    GLFWwindow *window = init_glfw(framebuffer_size_callback);
+    uint FBO, color;
+    glGenFramebuffers(1, &FBO);
+    glGenRenderbuffers(1, &color);
+    glBindRenderbuffer(GL_RENDERBUFFER, color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, 1920, 1080);
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+    Scale linear = {SCALE_LINEAR, SCALE_THRESHOLD};
+
+    size_t grids[][3] = {
+        {1, 1, 1000000}, {2, 2, 1000000}, {4, 4, 1000000}, {4, 8, 1000000}, {8, 8, 1000000},
+        {4, 8, 100000}, {4, 8, 10000000}, {4, 8, 100000000},
+    };
+    printf("%6s %11s %16s %16s\n", "panels", "points", "one pass ms", "per panel ms");
+    for (size_t g = 0; g < sizeof(grids) / sizeof(grids[0]) && grids[g][2] <= max_points; ++g)
+    {
+        size_t rows = grids[g][0], columns = grids[g][1], num_panels = rows * columns;
+        size_t per_panel = grids[g][2] / num_panels;
+        Subplots subplots;
+        init_Subplots(&subplots, rows, columns);
+        subplots_layout(&subplots, 1920, 1080, 1920, 1080);
+        size_t counts[SUBPLOTS_MAX];
+        vec3 *series[SUBPLOTS_MAX];
+        GameObject panels[SUBPLOTS_MAX];
+        for (size_t i = 0; i < num_panels; ++i)
+        {
+            counts[i] = per_panel;
+            series[i] = random_walk(per_panel, 0x9e3779b97f4a7c15ull + i);
+            subplots_set_view(&subplots, i, (View) {0, 1, -1, 1, 0, 0});
+            panels[i].vertex_shader_source = strdup(polyline_vertex_shader_source);
+            panels[i].fragment_shader_source = strdup(plot_fragment_shader_source);
+            panels[i].mesh = (Mesh) {per_panel, 0, series[i], NULL, false};
+            setup(&panels[i]);
+        }
+        subplots_upload(&subplots, counts, series);
+
+        double best[2] = {INFINITY, INFINITY};
+        for (size_t r = 0; r < reps + 1; ++r)
+        {
+            for (int c = 0; c < 2; ++c)
+            {
+                double t0 = now_seconds();
+                glViewport(0, 0, 1920, 1080);
+                glClear(GL_COLOR_BUFFER_BIT);
+                if (c == 0)
+                    subplots_draw(&subplots, 2);
+                else
+                {
+                    glEnable(GL_SCISSOR_TEST);
+                    for (size_t i = 0; i < num_panels; ++i)
+                    {
+                        Panel *panel = &subplots.panels[i];
+                        int x = panel->x, y = 1080 - panel->y - panel->height;
+                        glViewport(x, y, panel->width, panel->height);
+                        glScissor(x, y, panel->width, panel->height);
+                        polyline_draw(&panels[i], panel->view, linear, linear, 2, panel->width, panel->height);
+                    }
+                    glDisable(GL_SCISSOR_TEST);
+                }
+                glFinish();
+                double elapsed = now_seconds() - t0;
+                best[c] = r > 0 && elapsed < best[c] ? elapsed : best[c];
+            }
+        }
+        printf("%6zu %11zu %16.4f %16.4f\n", num_panels, per_panel * num_panels, 1e3 * best[0], 1e3 * best[1]);
+
+        for (size_t i = 0; i < num_panels; ++i)
+        {
+            panels[i].mesh = (Mesh) {0};
+            delete_GameObject(&panels[i]);
+            free(series[i]);
+        }
+        delete_Subplots(&subplots);
+    }
 
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &FBO);
+    glDeleteRenderbuffers(1, &color);
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return 0;
 }
 
-void delete_GameObject(GameObject *rend)
+/*
+ * A rows x columns grid, each panel with its own view: dragging or scrolling
+ * over a panel pans or zooms only that one. With an x or y column
+ * selection, the file is read as columns with a header and each panel shows
+ * one selected series. Otherwise every panel shows the file's one series.
+ */
+int run_subplots(size_t rows, size_t columns, const char *filename, const char *x_column, const char *y_columns)
 {
+    size_t n = 0;
+    vec3 *points = NULL;
+    Columns channels = {0};
+    if (x_column != NULL || y_columns != NULL)
+    {
+        if (!read_columns(filename, x_column, y_columns, false, 0, &channels))
+            return 1;
+        printf("columns: %zu rows of %s against %zu series\n", channels.num_rows, channels.x_name,
+               channels.num_series);
+    }
+    else if ((points = stream_csv(filename, 0, &n, NULL)) == NULL)
+        return 1;
+    GLFWwindow *window = init_glfw(framebuffer_size_callback);
+    glfwSetKeyCallback(window, key_callback);
+    glfwSetCursorPosCallback(window, cursor_pos_callback);
+    glfwSetMouseButtonCallback(window, mouse_button_callback);
+    glfwSetScrollCallback(window, scroll_callback);
+    glfwSetWindowRefreshCallback(window, window_refresh_callback);
+    Subplots subplots;
+    if (!init_Subplots(&subplots, rows, columns))
+        return 1;
+
+    size_t counts[SUBPLOTS_MAX];
+    vec3 *series[SUBPLOTS_MAX];
+    Extent x_extent, y_extent;
+    point_extents(points, n, &x_extent, &y_extent);
+    Scale linear = {SCALE_LINEAR, SCALE_THRESHOLD};
+    View initial = {0};
+    scaled_extent(linear, x_extent, &initial.x0, &initial.x1);
+    scaled_extent(linear, y_extent, &initial.y0, &initial.y1);
+    if (points != NULL)
+    {
+        for (size_t i = 0; i < subplots.num_panels; ++i)
+        {
+            counts[i] = n;
+            series[i] = points;
+            subplots_set_view(&subplots, i, initial);
+        }
+        subplots_upload(&subplots, counts, series);
+    }
+    else
+    {
+        /* Each series' panel starts on its own extent */
+        value_extent(channels.x, channels.num_rows, &x_extent);
+        scaled_extent(linear, x_extent, &initial.x0, &initial.x1);
+        for (size_t i = 0; i < subplots.num_panels && i < channels.num_series; ++i)
+        {
+            value_extent(channels.y[i], channels.num_rows, &y_extent);
+            scaled_extent(linear, y_extent, &initial.y0, &initial.y1);
+            subplots_set_view(&subplots, i, initial);
+        }
+        subplots_upload_columns(&subplots, channels.num_rows, channels.x, channels.y, channels.num_series);
+        if (channels.num_series > subplots.num_panels)
+            printf("subplots: showing the first %zu of %zu series\n", subplots.num_panels, channels.num_series);
+        delete_Columns(&channels);
+    }
+    printf("subplots: %zu panels, %zu points in one buffer\n", subplots.num_panels, subplots.num_points);
 
+    int window_width = 0, window_height = 0;
+    double last_x = 0, last_y = 0;
+    while (!glfwWindowShouldClose(window))
+    {
+        processInput(window);
+        int w, h, fb_width, fb_height;
+        glfwGetWindowSize(window, &w, &h);
+        glfwGetFramebufferSize(window, &fb_width, &fb_height);
+        if (w != window_width || h != window_height || fb_width != subplots.fb_width
+            || fb_height != subplots.fb_height)
+        {
+            window_width = w;
+            window_height = h;
+            subplots_layout(&subplots, w, h, fb_width, fb_height);
+            request_redraw();
+        }
+
+        // Pan or zoom the panel under the cursor
+        double cursor_x, cursor_y;
+        glfwGetCursorPos(window, &cursor_x, &cursor_y);
+        size_t active = subplots_panel_at(&subplots, last_x, last_y);
+        if (active != SIZE_MAX)
+        {
+            Panel *panel = &subplots.panels[active];
+            View view = panel->view;
+            if (pan_zoom(window, &view, cursor_x - panel->x, cursor_y - panel->y, last_x - panel->x,
+                         last_y - panel->y))
+                subplots_set_view(&subplots, active, view);
+        }
+        scroll_steps = 0;
+        last_x = cursor_x;
+        last_y = cursor_y;
+
+        if (needs_redraw(0, NULL))
+        {
+            glViewport(0, 0, fb_width, fb_height);
+            glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+            subplots_draw(&subplots, 0.005f * fb_height);
+            glfwSwapBuffers(window);
+        }
+        glfwWaitEventsTimeout(IDLE_TIMEOUT);
+    }
 
-    delete_Mesh(&rend->mesh);
-    glDeleteProgram(rend->program);
-    glDeleteVertexArrays(1, &rend->VAO);
-    glDeleteBuffers(2, (uint[]){rend->VBO, rend->EBO});
+    delete_Subplots(&subplots);
+    free(points);
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return 0;
 }
 
-GLFWwindow *init_glfw(GLFWframebuffersizefun framebuffer_size_callback)
+/*
+ * num_windows windows on as many monitors as there are, each with its own
+ * view of one series uploaded once: dragging or scrolling in a window pans
+ * or zooms only that window, and only that window redraws. Closing any of
+ * them ends the run. vsync is "first", "all" or "none".
+ */
+int run_windows(size_t num_windows, const char *filename, const char *vsync)
 {
-    /*
-     * 1. Initialize GLFW
-     * 2. Set configuration
-     * 3. Create window
-     * 4. Initialize GLAD
-     * 5. Setup the viewport and resize callback
-     */
-    printf("Starting\n");
-
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-    GLFWwindow *window = glfwCreateWindow(800, 600, "LearnOpenGL", NULL, NULL);
-    if (window == NULL)
+    if (num_windows == 0 || num_windows > WINDOWS_MAX)
     {
-        printf("Failed to create GLFW window\n");
-        glfwTerminate();
-        exit(-1);
+        printf("error: --windows takes between 1 and %d windows\n", WINDOWS_MAX);
+        return 1;
     }
-    glfwMakeContextCurrent(window);
-
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    if (strcmp(vsync, "first") != 0 && strcmp(vsync, "all") != 0 && strcmp(vsync, "none") != 0)
     {
-        printf("Failed to initialize GLAD\n");
-        exit(-1);
+        printf("error: --vsync must be first, all or none\n");
+        return 1;
+    }
+    size_t n;
+    vec3 *points = stream_csv(filename, 0, &n, NULL);
+    if (points == NULL)
+        return 1;
+    Extent x_extent, y_extent;
+    point_extents(points, n, &x_extent, &y_extent);
+    Scale linear = {SCALE_LINEAR, SCALE_THRESHOLD};
+    View initial = {0};
+    scaled_extent(linear, x_extent, &initial.x0, &initial.x1);
+    scaled_extent(linear, y_extent, &initial.y0, &initial.y1);
+
+    start_glfw();
+    PlotWindow windows[WINDOWS_MAX];
+    for (size_t i = 0; i < num_windows; ++i)
+    {
+        char title[64];
+        snprintf(title, sizeof(title), "plot %zu/%zu", i + 1, num_windows);
+        bool synced = strcmp(vsync, "all") == 0 || (i == 0 && strcmp(vsync, "first") == 0);
+        open_PlotWindow(&windows[i], title, 800, 600, i > 0 ? windows[0].window : NULL, initial, synced);
+        place_on_monitor(windows[i].window, i);
     }
 
-    glViewport(0, 0, 800, 600);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-
-    printf("Done starting\n");
+    /* Uploaded once, in the first window's context, and drawn in all of them */
+    glfwMakeContextCurrent(windows[0].window);
+    GameObject series;
+    series.vertex_shader_source = strdup(polyline_vertex_shader_source);
+    series.fragment_shader_source = strdup(plot_fragment_shader_source);
+    series.mesh = (Mesh) {n, 0, points, NULL, false};
+    setup(&series);
+    printf("%zu windows share one %zu-byte vertex buffer and program; each adds a VAO\n", num_windows,
+           n * sizeof(vec3));
+
+    bool open = true;
+    while (open)
+    {
+        for (size_t i = 0; i < num_windows; ++i)
+        {
+            PlotWindow *plot = &windows[i];
+            processInput(plot->window);
+            open = open && !glfwWindowShouldClose(plot->window);
+            int window_width, window_height;
+            double cursor_x, cursor_y;
+            glfwGetWindowSize(plot->window, &window_width, &window_height);
+            glfwGetCursorPos(plot->window, &cursor_x, &cursor_y);
+            plot->view.width = window_width;
+            plot->view.height = window_height;
+            scroll_steps = plot->scroll_steps;
+            if (window_width > 0 && window_height > 0
+                && pan_zoom(plot->window, &plot->view, cursor_x, cursor_y, plot->last_x, plot->last_y))
+                plot->redraw = true;
+            plot->scroll_steps = scroll_steps = 0;
+            plot->last_x = cursor_x;
+            plot->last_y = cursor_y;
+        }
+        for (size_t i = 0; i < num_windows; ++i)
+            if (windows[i].redraw)
+                plot_window_draw(&windows[i], &series, linear, linear, 0.004f);
+        glfwWaitEventsTimeout(IDLE_TIMEOUT);
+    }
 
-    return window;
+    for (size_t i = 0; i < num_windows; ++i)
+        printf("window %zu: %zu frames\n", i + 1, windows[i].frames);
+    glfwMakeContextCurrent(windows[0].window);
+    series.mesh = (Mesh) {0};
+    delete_GameObject(&series);
+    for (size_t i = num_windows; i-- > 0;)
+        close_PlotWindow(&windows[i]);
+    free(points);
+    glfwTerminate();
+    return 0;
 }
 
-Mesh line_naive(size_t n, vec3 vertices[n], float width)
+/*
+ * One series against a time column, ISO-8601 or nanoseconds since the
+ * epoch, with time ticks. The vertex buffer holds seconds since an origin
+ * that follows the view, so zooming in to nanoseconds anywhere in a long
+ * recording keeps the line sharp; the buffer is only rebuilt when the view
+ * moves far from the origin.
+ */
+int run_timeseries(const char *filename, const char *x_column, const char *y_column)
 {
-    Mesh out;
-
-    // Allocate
-    out.num_vertices = 2 * n;
-    out.num_indices = 6 * (n - 1);
-    out.vertices = calloc(out.num_vertices, sizeof(vec3));
-    out.indices = calloc(out.num_indices, sizeof(uint));
-
-    // Vertices
-    for (size_t i = 0; i < n; ++i)
+    Columns channels;
+    if (!read_columns(filename, x_column, y_column, true, 0, &channels))
+        return 1;
+    if (channels.num_series == 0 || channels.num_rows < 2)
     {
-        printf("i: %i; x: %f\n", i, vertices[i].x);
-        out.vertices[2 * i].x = vertices[i].x;
-        out.vertices[2 * i + 1].x = vertices[i].x;
-        out.vertices[2 * i].y = vertices[i].y + width;
-        out.vertices[2 * i + 1].y = vertices[i].y - width;
+        printf("error: %s has no series to plot against %s\n", filename, channels.x_name);
+        delete_Columns(&channels);
+        return 1;
     }
+    printf("timeseries: %zu rows of %s against %s\n", channels.num_rows, channels.names[0], channels.x_name);
+    size_t n = channels.num_rows;
+    int64_t origin = channels.t[0];
+    vec3 *points = malloc(n * sizeof(vec3));
+    time_points(n, channels.t, channels.y[0], origin, points);
 
-    // Indices
-    for (size_t i = 0; i < n - 1; ++i)
+    GLFWwindow *window = init_glfw(framebuffer_size_callback);
+    glfwSetKeyCallback(window, key_callback);
+    glfwSetCursorPosCallback(window, cursor_pos_callback);
+    glfwSetMouseButtonCallback(window, mouse_button_callback);
+    glfwSetScrollCallback(window, scroll_callback);
+    glfwSetWindowRefreshCallback(window, window_refresh_callback);
+    GameObject series;
+    series.vertex_shader_source = strdup(polyline_vertex_shader_source);
+    series.fragment_shader_source = strdup(plot_fragment_shader_source);
+    series.mesh = (Mesh) {n, 0, points, NULL, false};
+    setup(&series);
+    Axes axes;
+    TextRenderer text;
+    TextBatch labels;
+    init_Axes(&axes);
+    init_TextRenderer(&text);
+    init_TextBatch(&labels, 0);
+    Ticks x_ticks, y_ticks;
+
+    Extent x_extent, y_extent;
+    value_extent(channels.x, n, &x_extent);
+    value_extent(channels.y[0], n, &y_extent);
+    Scale linear = {SCALE_LINEAR, SCALE_THRESHOLD};
+    View view = {0}, ticked = {0};
+    scaled_extent(linear, x_extent, &view.x0, &view.x1);
+    scaled_extent(linear, y_extent, &view.y0, &view.y1);
+
+    double last_x = 0, last_y = 0;
+    while (!glfwWindowShouldClose(window))
     {
-        out.indices[6 * i] = 2 * i;
-        out.indices[6 * i + 1] = 2 * i + 1;
-        out.indices[6 * i + 2] = 2 * (i + 1);
-        out.indices[6 * i + 3] = 2 * (i + 1);
-        out.indices[6 * i + 4] = 2 * i + 1;
-        out.indices[6 * i + 5] = 2 * (i + 1) + 1;
+        processInput(window);
+        int window_width, window_height, fb_width, fb_height;
+        double cursor_x, cursor_y;
+        glfwGetWindowSize(window, &window_width, &window_height);
+        glfwGetFramebufferSize(window, &fb_width, &fb_height);
+        glfwGetCursorPos(window, &cursor_x, &cursor_y);
+        view.width = window_width;
+        view.height = window_height;
+        if (window_width > 0 && window_height > 0 && pan_zoom(window, &view, cursor_x, cursor_y, last_x, last_y))
+            request_redraw();
+        scroll_steps = 0;
+        last_x = cursor_x;
+        last_y = cursor_y;
+
+        if (time_rebase(&origin, &view))
+        {
+            time_points(n, channels.t, channels.y[0], origin, points);
+            upload(&series, GL_STATIC_DRAW);
+        }
+        if (memcmp(&view, &ticked, sizeof(View)) != 0 && view.width > 0 && view.height > 0)
+        {
+            compute_time_ticks(&x_ticks, origin, view.x0, view.x1, view.width / TICK_SPACING_X);
+            compute_scaled_ticks(&y_ticks, linear, view.y0, view.y1, view.height / TICK_SPACING_Y);
+            axes_update(&axes, &x_ticks, &y_ticks);
+            ticked = view;
+            request_redraw();
+        }
+
+        if (needs_redraw(0, NULL))
+        {
+            glViewport(0, 0, fb_width, fb_height);
+            glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+            axes_draw(&axes);
+            polyline_draw(&series, view, linear, linear, 0.004f * fb_height, fb_width, fb_height);
+            text_clear(&labels);
+            label_ticks(&labels, &x_ticks, &y_ticks, fb_width, fb_height, fb_width > 2 * view.width ? 2 : 1);
+            text_draw(&text, &labels, fb_width, fb_height);
+            glfwSwapBuffers(window);
+        }
+        glfwWaitEventsTimeout(IDLE_TIMEOUT);
     }
 
-    return out;
+    delete_TextBatch(&labels);
+    delete_TextRenderer(&text);
+    delete_Axes(&axes);
+    delete_GameObject(&series);
+    delete_Columns(&channels);
+    free(points);
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return 0;
 }
 
-Mesh diamond(vec3 point, float offset)
+int main(int argc, char **argv)
 {
-    Mesh out;
-    out.num_vertices = 4;
-    out.num_indices = 6;
-    out.vertices = calloc(out.num_vertices, sizeof(vec3));
-    out.indices = calloc(out.num_indices, sizeof(uint));
+    /* Batch mode: ./test --batch manifest.txt [--contexts N] [--threads N] */
+    if (argc >= 3 && strcmp(argv[1], "--batch") == 0)
+    {
+        size_t num_contexts = 2, num_threads = 0;
+        for (int i = 3; i + 1 < argc; i += 2)
+        {
+            if (strcmp(argv[i], "--contexts") == 0)
+                num_contexts = strtoul(argv[i + 1], NULL, 10);
+            else if (strcmp(argv[i], "--threads") == 0)
+                num_threads = strtoul(argv[i + 1], NULL, 10);
+        }
+        return run_batch(argv[2], num_contexts, num_threads);
+    }
 
-    out.vertices[0] = (vec3) {point.x - offset, point.y, point.z};
-    out.vertices[1] = (vec3) {point.x, point.y - offset, point.z};
-    out.vertices[2] = (vec3) {point.x + offset, point.y, point.z};
-    out.vertices[3] = (vec3) {point.x, point.y + offset, point.z};
+    /* GPU density against CPU binning: ./test --density-bench [max_points] */
+    if (argc >= 2 && strcmp(argv[1], "--density-bench") == 0)
+        return run_density_bench(argc >= 3 ? strtoull(argv[2], NULL, 10) : 100000000, 5);
+    if (argc >= 2 && strcmp(argv[1], "--surface-bench") == 0)
+        return run_surface_bench(argc >= 3 ? strtoull(argv[2], NULL, 10) : 4096, 20);
+    if (argc >= 2 && strcmp(argv[1], "--text-bench") == 0)
+        return run_text_bench(argc >= 3 ? strtoull(argv[2], NULL, 10) : 10000, 20);
+    if (argc >= 2 && strcmp(argv[1], "--axes-bench") == 0)
+        return run_axes_bench(20);
+    if (argc >= 2 && strcmp(argv[1], "--subplots-bench") == 0)
+        return run_subplots_bench(argc >= 3 ? strtoull(argv[2], NULL, 10) : 10000000, 10);
 
-    *out.indices = (uint) {0, 1, 2, 2, 3, 0};
+    /*
+     * A grid of panels in one window: ./test --subplots RxC [file.csv] [--x column] [--y column,column,...]
+     * With --x or --y, the file has a header and panel i shows the i-th --y column (default: all but x)
+     * against the --x column (default: the first), by name or index
+     */
+    if (argc >= 3 && strcmp(argv[1], "--subplots") == 0)
+    {
+        size_t rows, columns;
+        if (sscanf(argv[2], "%zux%zu", &rows, &columns) != 2)
+        {
+            printf("error: --subplots takes rows x columns, as in 4x8\n");
+            return 1;
+        }
+        const char *filename = "quad.csv", *x_column = NULL, *y_columns = NULL;
+        for (int i = 3; i < argc; ++i)
+        {
+            if (strcmp(argv[i], "--x") == 0 && i + 1 < argc)
+                x_column = argv[++i];
+            else if (strcmp(argv[i], "--y") == 0 && i + 1 < argc)
+                y_columns = argv[++i];
+            else
+                filename = argv[i];
+        }
+        return run_subplots(rows, columns, filename, x_column, y_columns);
+    }
 
-    return out;
-}
+    /* Several windows sharing one upload: ./test --windows N [file.csv] [--vsync first|all|none] */
+    if (argc >= 3 && strcmp(argv[1], "--windows") == 0)
+    {
+        const char *filename = "quad.csv", *vsync = "first";
+        for (int i = 3; i < argc; ++i)
+        {
+            if (strcmp(argv[i], "--vsync") == 0 && i + 1 < argc)
+                vsync = argv[++i];
+            else
+                filename = argv[i];
+        }
+        return run_windows(strtoul(argv[2], NULL, 10), filename, vsync);
+    }
+
+    /* A series against a time column: ./test --timeseries file.csv [--x column] [--y column] */
+    if (argc >= 3 && strcmp(argv[1], "--timeseries") == 0)
+    {
+        const char *x_column = NULL, *y_column = NULL;
+        for (int i = 3; i + 1 < argc; i += 2)
+        {
+            if (strcmp(argv[i], "--x") == 0)
+                x_column = argv[i + 1];
+            else if (strcmp(argv[i], "--y") == 0)
+                y_column = argv[i + 1];
+        }
+        return run_timeseries(argv[2], x_column, y_column);
+    }
+
+    /*
+     * --profile profile.jsonl: profiler dump (needs -DPLOT_PROFILE)
+     * --continuous: redraw every iteration instead of waiting for events
+     * --plot file.csv: series to plot (default quad.csv)
+     * --watch: reload the series whenever the file changes
+     * --pick: hover by GPU picking instead of the CPU index; also draws
+     *         markers on plot1's points to pick between overlapping series
+     * --function name: plot a built-in function (exp, quad, runge, tanh,
+     *         chirp) or a formula in x such as "exp(-x^2) * sin(10*x)"
+     *         instead of a file, resampled adaptively on pan and zoom
+     * --heatmap: draw the file's points as a 2D histogram, rebinned on pan
+     *         and zoom, instead of as a line
+     * --density log|eq: accumulate the file's segments on the GPU instead,
+     *         tone mapped by log or histogram equalisation
+     * --density-points: with --density, accumulate points, not segments
+     * --contour grid.csv: draw the level sets of a grid of values, one row
+     *         per line, instead of a series; traced once, remeshed on pan
+     *         and zoom
+     * --levels N: with --contour, N levels evenly spaced between the grid's
+     *         smallest and largest values (default 10)
+     * --surface grid.csv: draw a grid of values as a 3D surface instead,
+     *         orbited by dragging and zoomed with the wheel
+     * --surface-style filled|wireframe|both: how to draw it (default filled)
+     * --x-scale, --y-scale linear|log10|ln|symlog: axis scales for the
+     *         file's series, drawn from its raw points as a line or with
+     *         --density; the X and Y keys cycle through them
+     */
+    const char *profile_filename = NULL;
+    const char *plot_filename = "quad.csv";
+    const char *contour_filename = NULL;
+    const char *surface_filename = NULL;
+    SurfaceStyle surface_style = SURFACE_FILLED;
+    size_t num_levels = 10;
+    bool continuous = false, watch = false, pick = false, heatmap = false, density = false;
+    DensityToneMap tone_map = DENSITY_EQ_HIST;
+    GLenum density_primitive = GL_LINE_STRIP;
+    Scale x_scale = {SCALE_LINEAR, SCALE_THRESHOLD}, y_scale = x_scale;
+    bool scales_given = false;
+    PlotFunction function = NULL;
+    void *function_ctx = NULL;
+    Expr formula;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+            profile_filename = argv[++i];
+        else if (strcmp(argv[i], "--continuous") == 0)
+            continuous = true;
+        else if (strcmp(argv[i], "--plot") == 0 && i + 1 < argc)
+            plot_filename = argv[++i];
+        else if (strcmp(argv[i], "--watch") == 0)
+            watch = true;
+        else if (strcmp(argv[i], "--pick") == 0)
+            pick = true;
+        else if (strcmp(argv[i], "--heatmap") == 0)
+            heatmap = true;
+        else if (strcmp(argv[i], "--density") == 0 && i + 1 < argc)
+        {
+            density = true;
+            tone_map = strcmp(argv[++i], "log") == 0 ? DENSITY_LOG : DENSITY_EQ_HIST;
+        }
+        else if (strcmp(argv[i], "--density-points") == 0)
+            density_primitive = GL_POINTS;
+        else if (strcmp(argv[i], "--contour") == 0 && i + 1 < argc)
+            contour_filename = argv[++i];
+        else if (strcmp(argv[i], "--levels") == 0 && i + 1 < argc)
+            num_levels = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--surface") == 0 && i + 1 < argc)
+            surface_filename = argv[++i];
+        else if (strcmp(argv[i], "--surface-style") == 0 && i + 1 < argc)
+        {
+            ++i;
+            surface_style = strcmp(argv[i], "wireframe") == 0 ? SURFACE_WIREFRAME
+                          : strcmp(argv[i], "both") == 0      ? SURFACE_BOTH
+                                                              : SURFACE_FILLED;
+        }
+        else if ((strcmp(argv[i], "--x-scale") == 0 || strcmp(argv[i], "--y-scale") == 0) && i + 1 < argc)
+        {
+            Scale *scale = argv[i][2] == 'x' ? &x_scale : &y_scale;
+            if (!parse_scale(argv[++i], scale))
+            {
+                printf("error: unknown scale %s (linear, log10, ln or symlog)\n", argv[i]);
+                return 1;
+            }
+            scales_given = true;
+        }
+        else if (strcmp(argv[i], "--function") == 0 && i + 1 < argc)
+        {
+            function = find_function(argv[++i]);
+            if (function == NULL)
+            {
+                /* Not a built-in, so a formula */
+                if (!compile_expr(&formula, argv[i]))
+                    return 1;
+                if (formula.uses_y)
+                {
+                    printf("error: function formulas can only use x\n");
+                    return 1;
+                }
+                function = expr_function;
+                function_ctx = &formula;
+            }
+        }
+    }
+
+    if (num_levels == 0 || num_levels > CONTOUR_MAX_LEVELS)
+    {
+        printf("error: --levels must be between 1 and %d\n", CONTOUR_MAX_LEVELS);
+        return 1;
+    }
+    if (heatmap && density)
+    {
+        printf("error: --heatmap and --density cannot be combined\n");
+        return 1;
+    }
+    if (surface_filename != NULL && pick)
+    {
+        printf("error: --pick does not work with --surface\n");
+        return 1;
+    }
+    /* Their shaders write no IDs, which would leave the picked pixels undefined */
+    if ((heatmap || density) && pick)
+    {
+        printf("error: --pick does not work with --heatmap or --density\n");
+        return 1;
+    }
+    /* Neither a function nor a grid: the series in plot_filename */
+    bool from_file = function == NULL && contour_filename == NULL && surface_filename == NULL;
+    if (scales_given && (!from_file || heatmap || pick))
+    {
+        printf("error: --x-scale and --y-scale need a series drawn as a line or with --density, without --pick\n");
+        return 1;
+    }
+    /* Series under axis scales are drawn from their raw points, scaled on the GPU */
+    bool polyline = from_file && !heatmap && !density && scales_given;
+    bool scalable = polyline || density;
 
-int main(void)
-{
     /* Startup */
     GLFWwindow *window = init_glfw(framebuffer_size_callback);
+    glfwSetKeyCallback(window, key_callback);
+    glfwSetCursorPosCallback(window, cursor_pos_callback);
+    glfwSetMouseButtonCallback(window, mouse_button_callback);
+    glfwSetScrollCallback(window, scroll_callback);
+    glfwSetWindowRefreshCallback(window, window_refresh_callback);
+    Profiler profiler;
+    profile_open(&profiler, profile_filename);
+    Uploader uploader;
+    init_Uploader(&uploader, window);
+    Picker picker;
+    if (pick)
+        init_Picker(&picker);
 
     /* Common */
-    const char vertex_shader_source[] =
-        "#version 330 core\n"
-        "layout (location = 0) in vec3 aPos;\n"
-        "\n"
-        "void main()\n"
-        "{\n"
-        "   gl_Position = vec4(aPos.x, aPos.y, aPos.z, 1.0);\n"
-        "}\n\0";
-    const char fragment_shader_source[] =
-        "#version 330 core\n"
-        "out vec4 FragColor;\n"
-        "\n"
-        "void main()\n"
-        "{\n"
-        "    FragColor = vec4(1.0f, 0.5f, 0.2f, 1.0f);\n"
-        "}\n\0";
+    const char *vertex_shader_source = plot_vertex_shader_source;
+    const char *fragment_shader_source = plot_fragment_shader_source;
 
     /* Triangle */
     GameObject triangle;
@@ -384,6 +1080,7 @@ int main(void)
     triangle.mesh.indices = (uint[]){
         0, 1, 2, 1, 2, 3
     };
+    triangle.mesh.pooled = false;
     setup(&triangle);
 
     /* Rect */
@@ -402,41 +1099,9 @@ int main(void)
         0, 1, 3,
         0, 3, 2
     };
+    rect.mesh.pooled = false;
     setup(&rect);
 
-    /* Axes */
-    GameObject xaxis;
-    xaxis.vertex_shader_source = strdup(vertex_shader_source);
-    xaxis.fragment_shader_source = strdup(fragment_shader_source);
-    xaxis.mesh.num_vertices = 4;
-    xaxis.mesh.num_indices = 6;
-    xaxis.mesh.vertices = (vec3[]){
-        {-1.0, -0.01, 0.0},
-        {-1.0,  0.01, 0.0},
-        { 1.0,  0.01, 0.0},
-        { 1.0, -0.01, 0.0},
-    };
-    xaxis.mesh.indices = (uint[]){
-        0, 1, 2, 2, 3, 0,
-    };
-    setup(&xaxis);
-
-    GameObject yaxis;
-    yaxis.vertex_shader_source = strdup(vertex_shader_source);
-    yaxis.fragment_shader_source = strdup(fragment_shader_source);
-    yaxis.mesh.num_vertices = 4;
-    yaxis.mesh.num_indices = 6;
-    yaxis.mesh.vertices = (vec3[]){
-        {-0.01, -1.0, 0.0},
-        { 0.01, -1.0, 0.0},
-        { 0.01,  1.0, 0.0},
-        {-0.01,  1.0, 0.0},
-    };
-    yaxis.mesh.indices = (uint[]){
-        0, 1, 2, 2, 3, 0,
-    };
-    setup(&yaxis);
-
     /* Plot */
     float width = 0.01f;
 
@@ -453,7 +1118,7 @@ int main(void)
     GameObject plot1;
     plot1.vertex_shader_source = strdup(vertex_shader_source);
     plot1.fragment_shader_source = strdup(fragment_shader_source);
-    plot1.mesh = line(n1, vertices, width);
+    PROFILE_CPU(&profiler, "mesh plot1", plot1.mesh = line(n1, vertices, width));
     for (size_t i = 0; i < plot1.mesh.num_vertices; ++i)
     {
         print_vec3(&plot1.mesh.vertices[i]);
@@ -463,64 +1128,452 @@ int main(void)
     {
         printf("i = %d\n", plot1.mesh.indices[i]);
     }
-    setup(&plot1);
+    PROFILE_CPU(&profiler, "upload plot1", setup(&plot1));
 
-    /* Plot from file */
-    size_t n2 = 100;
-    vec3 *vertices2 = calloc(n2, sizeof(vec3));
-    FILE *file;
-    file = fopen("quad.csv", "r");
-    for (int i = 0; i < n2; ++i)
+    /* Plot from file, loaded and meshed on a worker thread; heatmaps, densities and surfaces draw their own */
+    bool plot2_drawn = !heatmap && !density && surface_filename == NULL;
+    GameObject plot2;
+    plot2.vertex_shader_source = strdup(pick       ? pick_vertex_shader_source
+                                        : polyline ? polyline_vertex_shader_source
+                                                   : vertex_shader_source);
+    plot2.fragment_shader_source = strdup(pick ? pick_fragment_shader_source : fragment_shader_source);
+    plot2.mesh = (Mesh) {0};
+    if (plot2_drawn)
+        setup(&plot2);
+    SeriesWorker series2;
+    if (from_file)
+        start_SeriesWorker(&series2, plot_filename, polyline ? polyline_points : line_naive, width, polyline, watch,
+                           request_redraw);
+    AsyncUpload plot2_upload = {0};
+
+    /* With axis scales, the view is in scaled units and the extents set it up for each scale */
+    Extent x_extent, y_extent;
+    point_extents(NULL, 0, &x_extent, &y_extent);
+
+    /* Or from a function, sampled on this thread whenever the view changes */
+    View view = {-1, 1, -1, 1, 0, 0};
+    vec3 *function_points = NULL;
+    SpatialIndex function_index = {0};
+    double last_x = 0, last_y = 0;
+
+    /* Or contours of a grid, traced once on all cores and remeshed like a function when the view changes */
+    Grid grid = {0};
+    Contours contours = {0};
+    if (contour_filename != NULL)
     {
-        fscanf(file, "%f, %f, %f", &vertices2[i].x, &vertices2[i].y, &vertices2[i].z);
+        if (!read_grid(contour_filename, &grid))
+            return 1;
+        float levels[num_levels];
+        contour_levels(&grid, num_levels, levels);
+        PROFILE_CPU(&profiler, "contour", contour_grid(&grid, num_levels, levels, 0, &contours));
+        init_SpatialIndex(&function_index, contours.points, contours.num_points, 0);
+        view = (View) {grid.x0, grid.x1, grid.y0, grid.y1, 0, 0};
     }
 
-    GameObject plot2;
-    plot2.vertex_shader_source = strdup(vertex_shader_source);
-    plot2.fragment_shader_source = strdup(fragment_shader_source);
-    plot2.mesh = line_naive(n2, vertices2, width);
-    for (size_t i = 0; i < plot2.mesh.num_vertices; ++i)
+    /* Or a surface, built on all cores and kept only on the GPU */
+    SurfacePlot surface_plot;
+    Camera camera = default_camera();
+    if (surface_filename != NULL)
     {
-        printf("i: %i ", i);
-        print_vec3(&plot2.mesh.vertices[i]);
-        printf("\n");
+        Grid surface_grid;
+        Surface surface;
+        if (!read_grid(surface_filename, &surface_grid))
+            return 1;
+        bool built;
+        PROFILE_CPU(&profiler, "build surface", built = init_Surface(&surface, &surface_grid, 0));
+        delete_Grid(&surface_grid);
+        if (!built)
+            return 1;
+        init_SurfacePlot(&surface_plot);
+        PROFILE_CPU(&profiler, "upload surface", surface_upload(&surface_plot, &surface));
+        printf("surface: %zu x %zu samples, %.2f bytes per cell\n", surface.width, surface.height,
+               surface_bytes_per_cell(&surface));
+        delete_Surface(&surface);
     }
-    // for (size_t i = 0; i < plot2.mesh.num_indices; ++i)
-    // {
-    //     printf("i = %d\n", plot2.mesh.indices[i]);
-    // }
-    setup(&plot2);
 
-    while (!glfwWindowShouldClose(window))
+    /* Or as a heatmap, binned on all cores whenever the series or the view changes */
+    Heatmap heatmap_plot;
+    Binner binner = {0};
+    Histogram histogram = {0};
+    bool rebin = false;
+    if (heatmap)
+        init_Heatmap(&heatmap_plot);
+
+    /* Or accumulated on the GPU from the full-resolution points */
+    Density density_plot;
+    GameObject density_points;
+    if (density)
     {
-        // Processing input
-        processInput(window);
+        init_Density(&density_plot, tone_map);
+        density_points.vertex_shader_source = strdup(density_vertex_shader_source);
+        density_points.fragment_shader_source = strdup(density_fragment_shader_source);
+        density_points.mesh = (Mesh) {0};
+        setup(&density_points);
+    }
 
-        // Rendering
-        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
+    /* Grid lines and labels at ticks of data views, recomputed when the view changes */
+    bool labelled = function != NULL || contour_filename != NULL || heatmap || density || polyline;
+    Axes axes;
+    Ticks x_ticks, y_ticks;
+    View ticked = {0};
+    TextRenderer text;
+    TextBatch labels;
+    if (labelled)
+    {
+        init_Axes(&axes);
+        init_TextRenderer(&text);
+        init_TextBatch(&labels, 0);
+    }
+
+    /* Marker on the sample under the cursor */
+    GameObject marker;
+    marker.vertex_shader_source = strdup(vertex_shader_source);
+    marker.fragment_shader_source = strdup(fragment_shader_source);
+    marker.mesh = diamond(zero, 0.02f);
+    setup(&marker);
+    size_t hovered = SIZE_MAX;
+    double hover_x = -1, hover_y = -1;
+    bool hover_stale = true;
+
+    /* With --pick: scatter markers on plot1's points, drawn over plot2 */
+    GameObject points;
+    bool pick_wanted = false;
+    if (pick)
+    {
+        points.vertex_shader_source = strdup(pick_vertex_shader_source);
+        points.fragment_shader_source = strdup(pick_fragment_shader_source);
+        points.mesh = scatter(n1, vertices, 0.02f);
+        setup(&points);
+    }
 
-        // Draw
-        // draw(&triangle);
-        // draw(&rect);
-        // draw(&xaxis);
-        // draw(&yaxis);
-        // draw(&plot1);
-        draw(&plot2);
+    /*
+     * Objects drawn each frame in this mode; a dirty one triggers a redraw.
+     * Heatmaps ask for one on upload and surfaces when the camera orbits.
+     */
+    GameObject *scene[1];
+    size_t scene_size = 0;
+    if (density)
+        scene[scene_size++] = &density_points;
+    else if (plot2_drawn)
+        scene[scene_size++] = &plot2;
+
+    while (!glfwWindowShouldClose(window))
+    {
+        profile_frame_begin(&profiler);
+        pool_begin_frame(&mesh_pool);
+        arena_reset(&frame_arena);
 
-        // Check and call events and swap buffers
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        // Processing input
+        PROFILE_CPU(&profiler, "processInput", processInput(window));
+
+        // Pick up meshes the workers finished and send them to the upload thread
+        Mesh mesh2;
+        if (from_file && !plot2_upload.busy && series_acquire(&series2, &mesh2))
+        {
+            profile_cpu(&profiler, "mesh plot2", series_build_seconds(&series2));
+            if (heatmap)
+            {
+                /* The points stay valid until the next acquire, which rebuilds this */
+                const SpatialIndex *index = series_index(&series2);
+                delete_Binner(&binner);
+                PROFILE_CPU(&profiler, "bin base", init_Binner(&binner, index->points, index->num_points, 0));
+                view.x0 = binner.x0;
+                view.x1 = binner.x1;
+                view.y0 = binner.y0;
+                view.y1 = binner.y1;
+                rebin = true;
+            }
+            else if (density)
+            {
+                /* Uploaded as they are; the worker keeps them until the next acquire */
+                const SpatialIndex *index = series_index(&series2);
+                point_extents(index->points, index->num_points, &x_extent, &y_extent);
+                scaled_extent(x_scale, x_extent, &view.x0, &view.x1);
+                scaled_extent(y_scale, y_extent, &view.y0, &view.y1);
+                Mesh points = {index->num_points, 0, (vec3 *) index->points, NULL, false};
+                upload_async(&uploader, &plot2_upload, &density_points, points);
+            }
+            else if (polyline)
+            {
+                /* The reduced raw points; the extents are of all of them */
+                const SpatialIndex *index = series_index(&series2);
+                point_extents(index->points, index->num_points, &x_extent, &y_extent);
+                scaled_extent(x_scale, x_extent, &view.x0, &view.x1);
+                scaled_extent(y_scale, y_extent, &view.y0, &view.y1);
+                upload_async(&uploader, &plot2_upload, &plot2, mesh2);
+            }
+            else
+            {
+                upload_async(&uploader, &plot2_upload, &plot2, mesh2);
+            }
+            hover_stale = true;
+        }
+        if (upload_poll(&plot2_upload))
+            profile_cpu(&profiler, "upload plot2", plot2_upload.seconds);
+
+        // Cycle the axis scales; only uniforms and the view change
+        if (scale_presses[0] > 0 || scale_presses[1] > 0)
+        {
+            for (; scalable && scale_presses[0] > 0; --scale_presses[0])
+                cycle_scale(&x_scale, x_extent, &view.x0, &view.x1);
+            for (; scalable && scale_presses[1] > 0; --scale_presses[1])
+                cycle_scale(&y_scale, y_extent, &view.y0, &view.y1);
+            scale_presses[0] = scale_presses[1] = 0;
+            if (scalable)
+                printf("scales: x %s, y %s\n", scale_names[x_scale.type], scale_names[y_scale.type]);
+            hovered = SIZE_MAX;
+            hover_stale = true;
+            ticked = (View) {0};
+        }
+
+        double cursor_x, cursor_y;
+        glfwGetCursorPos(window, &cursor_x, &cursor_y);
+        int window_width, window_height;
+        glfwGetWindowSize(window, &window_width, &window_height);
+        bool resized = window_width != view.width || window_height != view.height;
+        view.width = window_width;
+        view.height = window_height;
+
+        // Resample the function for the visible range after a resize, pan or zoom
+        if (function != NULL && view.width > 0 && view.height > 0
+            && (pan_zoom(window, &view, cursor_x, cursor_y, last_x, last_y) || resized))
+        {
+            size_t n;
+            vec3 *sampled;
+            PROFILE_CPU(&profiler, "sample", sampled = sample_function(function, function_ctx, view, 0.25, 0, &n));
+            delete_SpatialIndex(&function_index);
+            free(function_points);
+            function_points = sampled;
+            init_SpatialIndex(&function_index, function_points, n, 1);
+
+            vec3 *ndc = arena_alloc(&frame_arena, n * sizeof(vec3));
+            memcpy(ndc, sampled, n * sizeof(vec3));
+            view_to_ndc(view, n, ndc);
+            delete_Mesh(&plot2.mesh);
+            plot2.mesh = n >= 2 ? line_naive(n, ndc, width) : (Mesh) {0};
+            upload(&plot2, GL_DYNAMIC_DRAW);
+            hover_stale = true;
+        }
+
+        // Remesh the contours for the visible range after a resize, pan or zoom
+        if (contour_filename != NULL && view.width > 0 && view.height > 0
+            && (pan_zoom(window, &view, cursor_x, cursor_y, last_x, last_y) || resized))
+        {
+            Contours ndc = contours;
+            ndc.points = arena_alloc(&frame_arena, contours.num_points * sizeof(vec3));
+            memcpy(ndc.points, contours.points, contours.num_points * sizeof(vec3));
+            view_to_ndc(view, ndc.num_points, ndc.points);
+            delete_Mesh(&plot2.mesh);
+            PROFILE_CPU(&profiler, "mesh contours",
+                        plot2.mesh = ndc.num_lines > 0 ? contour_mesh(&ndc, width) : (Mesh) {0});
+            upload(&plot2, GL_DYNAMIC_DRAW);
+            hover_stale = true;
+        }
+
+        // Orbit the surface's camera
+        if (surface_filename != NULL && orbit(window, &camera, cursor_x, cursor_y, last_x, last_y))
+            request_redraw();
+
+        // Rebin the heatmap for a new series or after a resize, pan or zoom
+        if (heatmap && from_file && binner.base != NULL && view.width > 0 && view.height > 0
+            && (pan_zoom(window, &view, cursor_x, cursor_y, last_x, last_y) || resized || rebin))
+        {
+            PROFILE_CPU(&profiler, "bin", binner_view(&binner, view, &histogram));
+            PROFILE_CPU(&profiler, "upload heatmap", heatmap_upload(&heatmap_plot, &histogram));
+            request_redraw();
+            rebin = false;
+            hover_stale = true;
+        }
+        // Density plots and polylines only need a redraw with the new view
+        if ((density || polyline) && from_file && view.width > 0 && view.height > 0
+            && pan_zoom(window, &view, cursor_x, cursor_y, last_x, last_y))
+        {
+            request_redraw();
+            hover_stale = true;
+        }
+        if (density && density_poll(&density_plot))
+            request_redraw();
+        if (labelled && memcmp(&view, &ticked, sizeof(View)) != 0)
+        {
+            PROFILE_CPU(&profiler, "ticks",
+                        compute_scaled_ticks(&x_ticks, x_scale, view.x0, view.x1, view.width / TICK_SPACING_X);
+                        compute_scaled_ticks(&y_ticks, y_scale, view.y0, view.y1, view.height / TICK_SPACING_Y));
+            axes_update(&axes, &x_ticks, &y_ticks);
+            ticked = view;
+            request_redraw();
+        }
+        last_x = cursor_x;
+        last_y = cursor_y;
+
+        // Find the sample under the cursor, in window pixels, which are only linear in the data on linear axes
+        bool hoverable = surface_filename == NULL && x_scale.type == SCALE_LINEAR && y_scale.type == SCALE_LINEAR;
+        if (!pick && hoverable && (hover_stale || cursor_x != hover_x || cursor_y != hover_y))
+        {
+            hover_x = cursor_x;
+            hover_y = cursor_y;
+            hover_stale = false;
+            double ux = (view.x1 - view.x0) / view.width, uy = (view.y1 - view.y0) / view.height;
+            vec3 at = {view.x0 + cursor_x * ux, view.y1 - cursor_y * uy, 0};
+            vec3 scale = {1 / ux, 1 / uy, 0};
+            const SpatialIndex *index = from_file ? series_index(&series2) : &function_index;
+            size_t nearest = SIZE_MAX;
+            bool found;
+            PROFILE_CPU(&profiler, "hover", found = spatial_nearest(index, at, scale, HOVER_RADIUS, &nearest));
+            if (nearest != hovered)
+            {
+                hovered = nearest;
+                char title[128] = "plot";
+                if (found)
+                {
+                    vec3 p = index->points[nearest];
+                    snprintf(title, sizeof(title), "plot | sample %zu: (%g, %g)", nearest, p.x, p.y);
+                    view_to_ndc(view, 1, &p);
+                    delete_Mesh(&marker.mesh);
+                    marker.mesh = diamond(p, 0.02f);
+                    upload(&marker, GL_DYNAMIC_DRAW);
+                }
+                glfwSetWindowTitle(window, title);
+                request_redraw();
+            }
+        }
+
+        // Or ask the GPU what is drawn there; the read is issued with the next frame
+        if (pick && (cursor_x != hover_x || cursor_y != hover_y))
+        {
+            hover_x = cursor_x;
+            hover_y = cursor_y;
+            pick_wanted = true;
+            request_redraw();
+        }
+        PickResult picked;
+        if (pick && picker_poll(&picker, &picked))
+        {
+            profile_cpu(&profiler, "pick latency", picked.latency);
+            char title[128] = "plot";
+            if (picked.series != 0)
+            {
+                vec3 p = picked.series == 1 ? pick_position(&plot2, 2, picked.point)
+                                            : pick_position(&points, 4, picked.point);
+                snprintf(title, sizeof(title), "plot | series %u, point %u: (%g, %g)", picked.series,
+                         picked.point, p.x, p.y);
+            }
+            glfwSetWindowTitle(window, title);
+        }
+
+        if (continuous || needs_redraw(scene_size, scene))
+        {
+            // Rendering
+            int fb_width, fb_height;
+            glfwGetFramebufferSize(window, &fb_width, &fb_height);
+            if (pick)
+            {
+                picker_begin(&picker, fb_width, fb_height, (vec4) {0.2f, 0.3f, 0.3f, 1.0f});
+            }
+            else
+            {
+                glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            }
+
+            // Draw
+            // draw(&triangle);
+            // draw(&rect);
+            // draw(&plot1);
+            if (pick)
+            {
+                PROFILE_DRAW(&profiler, "draw plot2", pick_draw(&plot2, 1, 2));
+                PROFILE_DRAW(&profiler, "draw points", pick_draw(&points, 2, 4));
+                if (pick_wanted)
+                    pick_wanted = !picker_request(&picker, hover_x * fb_width / window_width,
+                                                  fb_height - 1 - hover_y * fb_height / window_height);
+                PROFILE_DRAW(&profiler, "pick blit", picker_end(&picker));
+            }
+            else
+            {
+                /* Under lines, over the full-screen images */
+                if (labelled && !heatmap && !density)
+                    PROFILE_DRAW(&profiler, "draw axes", axes_draw(&axes));
+                if (surface_filename != NULL)
+                    PROFILE_DRAW(&profiler, "draw surface",
+                                 surface_draw(&surface_plot, camera, (float) fb_width / fb_height, surface_style));
+                else if (heatmap)
+                    PROFILE_DRAW(&profiler, "draw heatmap", heatmap_draw(&heatmap_plot));
+                else if (density)
+                    draw_density(&profiler, &density_plot, &density_points, density_primitive, view, x_scale,
+                                 y_scale, fb_width, fb_height);
+                else if (polyline)
+                    PROFILE_DRAW(&profiler, "draw plot2",
+                                 polyline_draw(&plot2, view, x_scale, y_scale, width * fb_height, fb_width, fb_height));
+                else
+                    PROFILE_DRAW(&profiler, "draw plot2", draw(&plot2));
+                if (labelled && (heatmap || density))
+                    PROFILE_DRAW(&profiler, "draw axes", axes_draw(&axes));
+                if (hovered != SIZE_MAX)
+                    draw(&marker);
+            }
+            if (labelled)
+            {
+                text_clear(&labels);
+                int scale = fb_width > 2 * view.width ? 2 : 1;
+                label_ticks(&labels, &x_ticks, &y_ticks, fb_width, fb_height, scale);
+                PROFILE_DRAW(&profiler, "draw labels", text_draw(&text, &labels, fb_width, fb_height));
+            }
+            profile_frame(&profiler, window);
+
+            glfwSwapBuffers(window);
+        }
+
+        // Check and call events; sleep until there are some unless redrawing continuously
+        if (continuous)
+            glfwPollEvents();
+        else
+            glfwWaitEventsTimeout((pick && (pick_wanted || picker_pending(&picker))) || (density && density_plot.pending)
+                                      ? READBACK_POLL
+                                      : IDLE_TIMEOUT);
     }
 
     printf("Closing window\n");
+    PoolStats pool = pool_stats(&mesh_pool);
+    printf("mesh pool: %zu allocations, peak %zu bytes\n", pool.allocations, pool.peak_bytes);
 
     /* Delete stuff and terminate */
+    delete_Uploader(&uploader);
+    if (from_file)
+        stop_SeriesWorker(&series2);
+    delete_SpatialIndex(&function_index);
+    free(function_points);
+    delete_Arena(&frame_arena);
+    delete_Contours(&contours);
+    delete_Grid(&grid);
+    if (surface_filename != NULL)
+        delete_SurfacePlot(&surface_plot);
+    if (density)
+    {
+        delete_GameObject(&density_points);
+        delete_Density(&density_plot);
+    }
+    if (heatmap)
+    {
+        delete_Binner(&binner);
+        delete_Histogram(&histogram);
+        delete_Heatmap(&heatmap_plot);
+    }
     delete_GameObject(&triangle);
+    delete_GameObject(&marker);
+    if (labelled)
+    {
+        delete_TextBatch(&labels);
+        delete_TextRenderer(&text);
+        delete_Axes(&axes);
+    }
+    if (pick)
+    {
+        delete_GameObject(&points);
+        delete_Picker(&picker);
+    }
     // delete_GameObject(&rect);
-    // delete_GameObject(&xaxis);
-    // delete_GameObject(&yaxis);
     // delete_GameObject(&plot1);
+    profile_close(&profiler);
     glfwTerminate();
 
     return 0;
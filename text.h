@@ -0,0 +1,132 @@
+#ifndef TEXT_H
+#define TEXT_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include "font.h"
+#include "render.h"
+
+/*
+ * Text on the GPU: the font atlas as an R8 texture, and a TextBatch drawn as
+ * instanced quads in one call, whatever the number of labels. Each frame's
+ * glyphs go into a single instance buffer, orphaned before the write so the
+ * driver never waits on the previous frame's draw, and reallocated only when
+ * a batch outgrows it. Glyphs are sampled with GL_NEAREST at integer scales
+ * and cut out by discard, so there is no blending state to manage.
+ */
+
+const char text_vertex_shader_source[] =
+    "#version 330 core\n"
+    "layout (location = 0) in vec2 position;\n"
+    "layout (location = 1) in uvec2 glyph; /* atlas index, scale */\n"
+    "layout (location = 2) in vec4 color;\n"
+    "uniform vec2 viewport;\n"
+    "uniform uint columns;\n"
+    "uniform vec2 cell; /* atlas cell in pixels, and in texture coordinates */\n"
+    "uniform vec2 cell_uv;\n"
+    "out vec2 uv;\n"
+    "flat out vec4 tint;\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "   vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);\n"
+    "   vec2 pixel = position + corner * cell * float(glyph.y);\n"
+    "   gl_Position = vec4(2.0 * pixel.x / viewport.x - 1.0, 1.0 - 2.0 * pixel.y / viewport.y, 0.0, 1.0);\n"
+    "   uv = (vec2(glyph.x % columns, glyph.x / columns) + corner) * cell_uv;\n"
+    "   tint = color;\n"
+    "}\n\0";
+const char text_fragment_shader_source[] =
+    "#version 330 core\n"
+    "uniform sampler2D atlas;\n"
+    "in vec2 uv;\n"
+    "flat in vec4 tint;\n"
+    "out vec4 FragColor;\n"
+    "\n"
+    "void main()\n"
+    "{\n"
+    "    if (texture(atlas, uv).r < 0.5)\n"
+    "        discard;\n"
+    "    FragColor = tint;\n"
+    "}\n\0";
+
+typedef struct TextRenderer
+{
+    uint program, VAO, instances, atlas;
+    size_t capacity; /* glyphs the instance buffer holds */
+} TextRenderer;
+
+void init_TextRenderer(TextRenderer *text)
+{
+    text->program = setup_shader_program(text_vertex_shader_source, text_fragment_shader_source);
+
+    uint8_t pixels[FONT_ATLAS_WIDTH * FONT_ATLAS_HEIGHT];
+    font_atlas(pixels);
+    glGenTextures(1, &text->atlas);
+    glBindTexture(GL_TEXTURE_2D, text->atlas);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, FONT_ATLAS_WIDTH, FONT_ATLAS_HEIGHT, 0, GL_RED, GL_UNSIGNED_BYTE, pixels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    /* Every attribute advances once per instance; the quad's corners come from gl_VertexID */
+    glGenVertexArrays(1, &text->VAO);
+    glGenBuffers(1, &text->instances);
+    glBindVertexArray(text->VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, text->instances);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(GlyphInstance), (void *) offsetof(GlyphInstance, x));
+    glVertexAttribIPointer(1, 2, GL_UNSIGNED_SHORT, sizeof(GlyphInstance), (void *) offsetof(GlyphInstance, glyph));
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(GlyphInstance),
+                          (void *) offsetof(GlyphInstance, color));
+    for (uint i = 0; i < 3; ++i)
+    {
+        glEnableVertexAttribArray(i);
+        glVertexAttribDivisor(i, 1);
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    text->capacity = 0;
+}
+
+void delete_TextRenderer(TextRenderer *text)
+{
+    glDeleteBuffers(1, &text->instances);
+    glDeleteVertexArrays(1, &text->VAO);
+    glDeleteTextures(1, &text->atlas);
+    glDeleteProgram(text->program);
+}
+
+/* Draws the batch over a viewport of width x height pixels in one instanced call */
+void text_draw(TextRenderer *text, const TextBatch *batch, int width, int height)
+{
+    if (batch->count == 0)
+        return;
+    glBindBuffer(GL_ARRAY_BUFFER, text->instances);
+    if (batch->count > text->capacity)
+        text->capacity = batch->capacity > batch->count ? batch->capacity : batch->count;
+    glBufferData(GL_ARRAY_BUFFER, text->capacity * sizeof(GlyphInstance), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, batch->count * sizeof(GlyphInstance), batch->glyphs);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glUseProgram(text->program);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, text->atlas);
+    glUniform1i(glGetUniformLocation(text->program, "atlas"), 0);
+    glUniform2f(glGetUniformLocation(text->program, "viewport"), width, height);
+    glUniform1ui(glGetUniformLocation(text->program, "columns"), FONT_COLUMNS);
+    glUniform2f(glGetUniformLocation(text->program, "cell"), FONT_CELL, FONT_CELL);
+    glUniform2f(glGetUniformLocation(text->program, "cell_uv"), (float) FONT_CELL / FONT_ATLAS_WIDTH,
+                (float) FONT_CELL / FONT_ATLAS_HEIGHT);
+    glBindVertexArray(text->VAO);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, batch->count);
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glUseProgram(0);
+}
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef THREADS_H
+#define THREADS_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/*
+ * Bounded blocking FIFO of pointers. Pushing to a full queue blocks, which is
+ * what keeps a pipeline's memory bounded no matter how much input it is fed.
+ * Once closed, pops drain the remaining items and then return NULL.
+ */
+typedef struct Queue
+{
+    void **items;
+    size_t capacity, head, count;
+    bool closed;
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty, not_full;
+} Queue;
+
+void init_Queue(Queue *queue, size_t capacity)
+{
+    queue->items = calloc(capacity, sizeof(void *));
+    queue->capacity = capacity;
+    queue->head = 0;
+    queue->count = 0;
+    queue->closed = false;
+    pthread_mutex_init(&queue->mutex, NULL);
+    pthread_cond_init(&queue->not_empty, NULL);
+    pthread_cond_init(&queue->not_full, NULL);
+}
+
+void delete_Queue(Queue *queue)
+{
+    free(queue->items);
+    pthread_mutex_destroy(&queue->mutex);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_cond_destroy(&queue->not_full);
+}
+
+void queue_push(Queue *queue, void *item)
+{
+    pthread_mutex_lock(&queue->mutex);
+    while (queue->count == queue->capacity)
+        pthread_cond_wait(&queue->not_full, &queue->mutex);
+    queue->items[(queue->head + queue->count) % queue->capacity] = item;
+    ++queue->count;
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+void *queue_pop(Queue *queue)
+{
+    void *item = NULL;
+    pthread_mutex_lock(&queue->mutex);
+    while (queue->count == 0 && !queue->closed)
+        pthread_cond_wait(&queue->not_empty, &queue->mutex);
+    if (queue->count > 0)
+    {
+        item = queue->items[queue->head];
+        queue->head = (queue->head + 1) % queue->capacity;
+        --queue->count;
+        pthread_cond_signal(&queue->not_full);
+    }
+    pthread_mutex_unlock(&queue->mutex);
+    return item;
+}
+
+void queue_close(Queue *queue)
+{
+    pthread_mutex_lock(&queue->mutex);
+    queue->closed = true;
+    pthread_cond_broadcast(&queue->not_empty);
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+/* Number of online cores, never less than one */
+size_t num_cores(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? n : 1;
+}
+
+/*
+ * Splits [0, n) into `num_threads` contiguous chunks and runs `body` on each,
+ * the first on the calling thread. `thread` is the chunk number, so bodies
+ * can index per-thread scratch space; chunks are in order, so concatenating
+ * per-thread results preserves the sequential order.
+ */
+typedef void (*ParallelBody)(void *ctx, size_t thread, size_t begin, size_t end);
+
+typedef struct ParallelTask
+{
+    ParallelBody body;
+    void *ctx;
+    size_t thread, begin, end;
+} ParallelTask;
+
+void *parallel_task(void *arg)
+{
+    ParallelTask *task = arg;
+    task->body(task->ctx, task->thread, task->begin, task->end);
+    return NULL;
+}
+
+void parallel_for(size_t num_threads, size_t n, ParallelBody body, void *ctx)
+{
+    if (num_threads == 0)
+        num_threads = 1;
+    ParallelTask tasks[num_threads];
+    pthread_t threads[num_threads];
+    for (size_t i = 0; i < num_threads; ++i)
+        tasks[i] = (ParallelTask) {body, ctx, i, i * n / num_threads, (i + 1) * n / num_threads};
+    for (size_t i = 1; i < num_threads; ++i)
+        pthread_create(&threads[i], NULL, parallel_task, &tasks[i]);
+    parallel_task(&tasks[0]);
+    for (size_t i = 1; i < num_threads; ++i)
+        pthread_join(threads[i], NULL);
+}
+
+#endif
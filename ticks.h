@@ -0,0 +1,472 @@
+#ifndef TICKS_H
+#define TICKS_H
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "font.h"
+#include "mathlib.h"
+#include "scale.h"
+
+/*
+ * Axis ticks at "nice" values, and the grid lines and labels they make.
+ *
+ * Linear axes step by 1, 2 or 5 times a power of ten, the smallest such
+ * step giving at most `target` ticks, with minor ticks splitting each step
+ * in 5 (4 for steps of 2). Log axes tick every decade, with minor ticks at
+ * 2..9 times each, or every few decades when there are too many; spans of
+ * less than a decade tick linearly. Symlog axes tick at zero and at the
+ * decades beyond the threshold on either side, in the same way. Time axes take seconds since the Unix
+ * epoch, UTC, and step through seconds, minutes, hours, days, months and
+ * years, with labels formatted to match the step. compute_time_ticks()
+ * takes the range as seconds since an origin in int64 nanoseconds, as
+ * timestamps.h keeps views of time columns, and finds steps under a second
+ * in integer nanoseconds, exact where doubles of seconds since the epoch
+ * only resolve a quarter of a microsecond.
+ *
+ * Every tick keeps its position as a fraction of the axis, so drawing
+ * does not need to know the scale. compute_scaled_ticks() takes the range
+ * of a View in the scaled units of scale.h. Computing ticks is a few dozen
+ * divisions and snprintf calls, done only when the view changes;
+ * tick_lines() turns two axes' ticks into GL_LINES vertices for one
+ * buffer of fixed size, and label_ticks() lays out their labels.
+ */
+
+#define TICKS_MAX 128
+#define TICK_LABEL 24
+#define TICKS_VERTICES (4 * TICKS_MAX + 8)
+
+/* Pixels wanted between major ticks */
+#define TICK_SPACING_X 100
+#define TICK_SPACING_Y 60
+
+typedef enum TickScale
+{
+    TICKS_LINEAR,
+    TICKS_LOG,
+    TICKS_TIME,
+    TICKS_SYMLOG,
+} TickScale;
+
+typedef struct Ticks
+{
+    TickScale scale;
+    double threshold; /* symlog only */
+    double v0, v1;
+    size_t count;
+    double values[TICKS_MAX];
+    float positions[TICKS_MAX]; /* 0 at v0, 1 at v1 */
+    bool major[TICKS_MAX];
+    char labels[TICKS_MAX][TICK_LABEL]; /* empty for minor ticks */
+} Ticks;
+
+/* Smallest 1, 2 or 5 times a power of ten that is at least `step` */
+double nice_step(double step)
+{
+    double power = pow(10, floor(log10(step)));
+    double mantissa = step / power;
+    return (mantissa <= 1 ? 1 : mantissa <= 2 ? 2 : mantissa <= 5 ? 5 : 10) * power;
+}
+
+double tick_position(const Ticks *ticks, double value)
+{
+    if (ticks->scale == TICKS_LOG)
+        return (log10(value) - log10(ticks->v0)) / (log10(ticks->v1) - log10(ticks->v0));
+    if (ticks->scale == TICKS_SYMLOG)
+    {
+        Scale symlog = {SCALE_SYMLOG, ticks->threshold};
+        double s0 = scale_forward(symlog, ticks->v0), s1 = scale_forward(symlog, ticks->v1);
+        return (scale_forward(symlog, value) - s0) / (s1 - s0);
+    }
+    return (value - ticks->v0) / (ticks->v1 - ticks->v0);
+}
+
+/* Adds a tick, with an empty label, if it is on the axis and there is room; true if it was added */
+bool tick_push(Ticks *ticks, double value, bool major)
+{
+    double position = tick_position(ticks, value);
+    if (ticks->count == TICKS_MAX || !(position >= -1e-9 && position <= 1 + 1e-9))
+        return false;
+    ticks->values[ticks->count] = value;
+    ticks->positions[ticks->count] = position;
+    ticks->major[ticks->count] = major;
+    ticks->labels[ticks->count][0] = '\0';
+    ticks->count++;
+    return true;
+}
+
+/* Labels the major ticks with as many decimals as the step needs, in exponent form for very large or small values */
+void label_linear(Ticks *ticks, double step)
+{
+    double largest = fmax(fabs(ticks->v0), fabs(ticks->v1));
+    int magnitude = floor(log10(largest)), precision = floor(log10(step) + 1e-9);
+    bool exponent = magnitude >= 7 || magnitude < -4;
+    int digits = exponent ? magnitude - precision : -precision;
+    digits = digits < 0 ? 0 : digits > 15 ? 15 : digits;
+    for (size_t i = 0; i < ticks->count; ++i)
+    {
+        if (!ticks->major[i])
+            continue;
+        double value = fabs(ticks->values[i]) < 1e-9 * step ? 0 : ticks->values[i];
+        snprintf(ticks->labels[i], TICK_LABEL, exponent ? "%.*e" : "%.*f", digits, value);
+    }
+}
+
+void linear_ticks(Ticks *ticks, size_t target)
+{
+    double step = nice_step((ticks->v1 - ticks->v0) / target);
+    double mantissa = step / pow(10, floor(log10(step) + 1e-9));
+    double minor = step / (mantissa > 1.5 && mantissa < 2.5 ? 4 : 5);
+    /* Multiples of the minor step, so that major ones are exact multiples of `step` too */
+    int64_t per_major = llround(step / minor);
+    for (int64_t k = ceil(ticks->v0 / minor - 1e-9); k * minor <= ticks->v1 + 1e-9 * step; ++k)
+    {
+        bool major = k % per_major == 0;
+        tick_push(ticks, major ? (k / per_major) * step : k * minor, major);
+    }
+    label_linear(ticks, step);
+}
+
+/* sign * 10^d, in full or as 1e<d> */
+void label_decade(char *label, int64_t d, int sign)
+{
+    const char *minus = sign < 0 ? "-" : "";
+    if (d >= 0 && d < 7)
+        snprintf(label, TICK_LABEL, "%s%.0f", minus, pow(10, d));
+    else if (d < 0 && d >= -4)
+        snprintf(label, TICK_LABEL, "%s%.*f", minus, (int) -d, pow(10, d));
+    else
+        snprintf(label, TICK_LABEL, "%s1e%d", minus, (int) d);
+}
+
+void log_ticks(Ticks *ticks, size_t target)
+{
+    double d0 = log10(ticks->v0), d1 = log10(ticks->v1);
+    if (d1 - d0 < 1)
+    {
+        linear_ticks(ticks, target);
+        return;
+    }
+    /*
+     * Every decade with minors at 2..9, or every `every` decades with the ones
+     * between as minors while they fit, so that the far end keeps its ticks
+     */
+    int64_t every = d1 - d0 > target ? ceil((d1 - d0) / target) : 1;
+    bool minors = every == 1 && d1 - d0 < TICKS_MAX / 10, minor_decades = d1 - d0 < TICKS_MAX / 2;
+    for (int64_t d = floor(d0); d <= ceil(d1); ++d)
+    {
+        double decade = pow(10, d);
+        bool major = d % every == 0;
+        if (!major && !minor_decades)
+            continue;
+        if (tick_push(ticks, decade, major) && major)
+            label_decade(ticks->labels[ticks->count - 1], d, 1);
+        for (int m = 2; minors && m < 10; ++m)
+            tick_push(ticks, m * decade, false);
+    }
+}
+
+void symlog_ticks(Ticks *ticks, size_t target)
+{
+    Scale symlog = {SCALE_SYMLOG, ticks->threshold};
+    double s0 = scale_forward(symlog, ticks->v0), s1 = scale_forward(symlog, ticks->v1);
+    if (s1 - s0 < 1)
+    {
+        linear_ticks(ticks, target);
+        return;
+    }
+    /* Zero, then the decades from the threshold out on each side, as log_ticks() does them */
+    int64_t every = s1 - s0 > target ? ceil((s1 - s0) / target) : 1;
+    bool minors = every == 1 && s1 - s0 < TICKS_MAX / 20, minor_decades = s1 - s0 < TICKS_MAX / 4;
+    if (tick_push(ticks, 0, true))
+        strcpy(ticks->labels[ticks->count - 1], "0");
+    int64_t first = ceil(log10(ticks->threshold)), last = ceil(log10(fmax(fabs(ticks->v0), fabs(ticks->v1))));
+    for (int sign = -1; sign <= 1; sign += 2)
+    {
+        for (int64_t d = first; d <= last; ++d)
+        {
+            double decade = sign * pow(10, d);
+            bool major = d % every == 0;
+            if (!major && !minor_decades)
+                continue;
+            if (tick_push(ticks, decade, major) && major)
+                label_decade(ticks->labels[ticks->count - 1], d, sign);
+            for (int m = 2; minors && m < 10; ++m)
+                tick_push(ticks, m * decade, false);
+        }
+    }
+}
+
+#define NS_PER_SECOND 1000000000ll
+#define NS_PER_DAY (86400 * NS_PER_SECOND)
+
+/* Days since 1970-01-01 of a date in the proleptic Gregorian calendar, and back */
+int64_t days_from_civil(int64_t y, int m, int d)
+{
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int64_t yoe = y - era * 400;
+    int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+void civil_from_days(int64_t days, int64_t *y, int *m, int *d)
+{
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    int64_t doe = days - era * 146097;
+    int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int64_t mp = (5 * doy + 2) / 153;
+    *d = doy - (153 * mp + 2) / 5 + 1;
+    *m = mp < 10 ? mp + 3 : mp - 9;
+    *y = yoe + era * 400 + (*m <= 2);
+}
+
+typedef enum TimeUnit
+{
+    TIME_SUBSECOND,
+    TIME_SECONDS,
+    TIME_MINUTES,
+    TIME_DAYS,
+    TIME_MONTHS,
+    TIME_YEARS,
+} TimeUnit;
+
+void label_time(char *label, double t, TimeUnit unit, int decimals)
+{
+    static const char *months[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                   "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+    double days = floor(t / 86400);
+    double seconds = t - days * 86400;
+    int64_t y;
+    int m, d;
+    civil_from_days(days, &y, &m, &d);
+    int hour = seconds / 3600, minute = fmod(seconds, 3600) / 60;
+    double second = fmod(seconds, 60);
+    switch (unit)
+    {
+    case TIME_SUBSECOND:
+        snprintf(label, TICK_LABEL, "%02d:%02d:%0*.*f", hour, minute, decimals + 3, decimals, second);
+        break;
+    case TIME_SECONDS:
+        snprintf(label, TICK_LABEL, "%02d:%02d:%02d", hour, minute, (int) second);
+        break;
+    case TIME_MINUTES:
+        snprintf(label, TICK_LABEL, "%02d:%02d", hour, minute);
+        break;
+    case TIME_DAYS:
+        snprintf(label, TICK_LABEL, "%s %d", months[m - 1], d);
+        break;
+    case TIME_MONTHS:
+        snprintf(label, TICK_LABEL, "%s %lld", months[m - 1], (long long) y);
+        break;
+    case TIME_YEARS:
+        snprintf(label, TICK_LABEL, "%lld", (long long) y);
+        break;
+    }
+}
+
+/* Steps of whole seconds, from one second to a week */
+const double time_steps[] = {1, 2, 5, 10, 15, 30, 60, 120, 300, 600, 900, 1800,
+                             3600, 7200, 10800, 21600, 43200, 86400, 172800, 604800};
+
+void time_ticks(Ticks *ticks, size_t target)
+{
+    double span = ticks->v1 - ticks->v0, wanted = span / target;
+    size_t num_steps = sizeof(time_steps) / sizeof(time_steps[0]);
+
+    /* Under a second: linear steps, labelled with the time of day */
+    if (wanted < 1)
+    {
+        double step = nice_step(wanted);
+        int decimals = -floor(log10(step) + 1e-9);
+        for (int64_t k = ceil(ticks->v0 / step - 1e-9); k * step <= ticks->v1 + 1e-9 * step; ++k)
+        {
+            if (tick_push(ticks, k * step, true))
+                label_time(ticks->labels[ticks->count - 1], k * step, TIME_SUBSECOND, decimals);
+        }
+        return;
+    }
+
+    /* Seconds to weeks: multiples of the step since the epoch, which falls on a midnight */
+    if (wanted <= time_steps[num_steps - 1])
+    {
+        size_t i = 0;
+        while (i + 1 < num_steps && time_steps[i] < wanted)
+            ++i;
+        double step = time_steps[i];
+        TimeUnit unit = step < 60 ? TIME_SECONDS : step < 86400 ? TIME_MINUTES : TIME_DAYS;
+        for (int64_t k = ceil(ticks->v0 / step); k * step <= ticks->v1; ++k)
+        {
+            /* Midnights are labelled with the date */
+            if (tick_push(ticks, k * step, true))
+            {
+                TimeUnit label_unit = fmod(k * step, 86400) == 0 ? TIME_DAYS : unit;
+                label_time(ticks->labels[ticks->count - 1], k * step, label_unit, 0);
+            }
+        }
+        return;
+    }
+
+    /* Months and years, by the calendar */
+    double months = wanted / (365.2425 * 86400 / 12);
+    int64_t step = months <= 1 ? 1 : months <= 3 ? 3 : months <= 6 ? 6 : 12 * nice_step(months / 12);
+    int64_t y;
+    int m, d;
+    civil_from_days(floor(ticks->v0 / 86400), &y, &m, &d);
+    int64_t month = y * 12 + (m - 1);
+    month -= (month % step + step) % step;
+    for (; ticks->count < TICKS_MAX; month += step)
+    {
+        int64_t year = month >= 0 ? month / 12 : (month - 11) / 12;
+        double t = 86400.0 * days_from_civil(year, month - year * 12 + 1, 1);
+        if (t > ticks->v1)
+            break;
+        if (tick_push(ticks, t, true))
+            label_time(ticks->labels[ticks->count - 1], t, step < 12 ? TIME_MONTHS : TIME_YEARS, 0);
+    }
+}
+
+/*
+ * Ticks for the range [v0, v1] of an axis, about `target` major ones (at
+ * least 2). Log axes need 0 < v0; symlog axes take their threshold from
+ * ticks->threshold, as compute_scaled_ticks() sets it. Returns false, with
+ * no ticks, if the range is empty, not finite, or too narrow for doubles
+ * to step through.
+ */
+bool compute_ticks(Ticks *ticks, TickScale scale, double v0, double v1, size_t target)
+{
+    ticks->scale = scale;
+    ticks->threshold = scale == TICKS_SYMLOG ? ticks->threshold : SCALE_THRESHOLD;
+    ticks->v0 = v0;
+    ticks->v1 = v1;
+    ticks->count = 0;
+    if (!(v0 < v1) || !isfinite(v0) || !isfinite(v1) || (scale == TICKS_LOG && !(v0 > 0))
+        || v1 - v0 < 1e-12 * fmax(fabs(v0), fabs(v1)))
+        return false;
+    target = target < 2 ? 2 : target > TICKS_MAX / 6 ? TICKS_MAX / 6 : target;
+    if (scale == TICKS_LOG)
+        log_ticks(ticks, target);
+    else if (scale == TICKS_TIME)
+        time_ticks(ticks, target);
+    else if (scale == TICKS_SYMLOG)
+        symlog_ticks(ticks, target);
+    else
+        linear_ticks(ticks, target);
+    return true;
+}
+
+/* Ticks for the range [s0, s1] of a View along an axis with the given scale, in its scaled units */
+bool compute_scaled_ticks(Ticks *ticks, Scale scale, double s0, double s1, size_t target)
+{
+    double v0 = scale_inverse(scale, s0), v1 = scale_inverse(scale, s1);
+    switch (scale.type)
+    {
+    case SCALE_LOG10:
+    case SCALE_LN:
+        return compute_ticks(ticks, TICKS_LOG, v0, v1, target);
+    case SCALE_SYMLOG:
+        ticks->threshold = scale.threshold;
+        return compute_ticks(ticks, TICKS_SYMLOG, v0, v1, target);
+    default:
+        return compute_ticks(ticks, TICKS_LINEAR, v0, v1, target);
+    }
+}
+
+/* The time of day of t, in nanoseconds since the epoch, with `decimals` digits of the second */
+void label_time_ns(char *label, int64_t t, int decimals)
+{
+    int64_t of_day = (t % NS_PER_DAY + NS_PER_DAY) % NS_PER_DAY, seconds = of_day / NS_PER_SECOND;
+    int length = snprintf(label, TICK_LABEL, "%02d:%02d:%02d", (int) (seconds / 3600), (int) (seconds / 60 % 60),
+                          (int) (seconds % 60));
+    if (decimals > 0 && decimals <= 9)
+    {
+        snprintf(label + length, TICK_LABEL - length, ".%09lld", (long long) (of_day % NS_PER_SECOND));
+        label[length + 1 + decimals] = '\0';
+    }
+}
+
+/*
+ * Time ticks for the range [s0, s1] in seconds since `origin`, which is in
+ * nanoseconds since the epoch; the ticks' values are seconds since the
+ * origin too. Steps of a second or more are those of compute_ticks(), and
+ * shorter ones are 1, 2 or 5 times a power of ten nanoseconds, down to one.
+ */
+bool compute_time_ticks(Ticks *ticks, int64_t origin, double s0, double s1, size_t target)
+{
+    double base = origin / (double) NS_PER_SECOND;
+    target = target < 2 ? 2 : target > TICKS_MAX / 6 ? TICKS_MAX / 6 : target;
+    if (!(s0 < s1) || !isfinite(s0) || !isfinite(s1) || (s1 - s0) / target >= 1)
+    {
+        bool ok = compute_ticks(ticks, TICKS_TIME, base + s0, base + s1, target);
+        ticks->v0 = s0;
+        ticks->v1 = s1;
+        for (size_t i = 0; i < ticks->count; ++i)
+            ticks->values[i] -= base;
+        return ok;
+    }
+
+    ticks->scale = TICKS_TIME;
+    ticks->threshold = SCALE_THRESHOLD;
+    ticks->v0 = s0;
+    ticks->v1 = s1;
+    ticks->count = 0;
+    double wanted = (s1 - s0) * NS_PER_SECOND / target;
+    int64_t step = wanted < 1 ? 1 : llround(nice_step(wanted));
+    int decimals = 9 - (int) floor(log10(step) + 1e-9);
+    int64_t a = origin + (int64_t) floor(s0 * NS_PER_SECOND), b = origin + (int64_t) ceil(s1 * NS_PER_SECOND);
+    int64_t first = a >= 0 ? (a + step - 1) / step : -(-a / step);
+    for (int64_t t = first * step; t <= b && ticks->count < TICKS_MAX; t += step)
+        if (tick_push(ticks, (t - origin) / (double) NS_PER_SECOND, true))
+            label_time_ns(ticks->labels[ticks->count - 1], t, decimals);
+    return true;
+}
+
+/*
+ * GL_LINES vertices in NDC for the grid lines of both axes' ticks across
+ * the whole view, then the frame around it; z is the line's brightness.
+ * Writes at most TICKS_VERTICES and returns how many.
+ */
+size_t tick_lines(const Ticks *x, const Ticks *y, vec3 *out)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < x->count; ++i)
+    {
+        float px = 2 * x->positions[i] - 1, shade = x->major[i] ? 0.45f : 0.3f;
+        out[n++] = (vec3) {px, -1, shade};
+        out[n++] = (vec3) {px, 1, shade};
+    }
+    for (size_t i = 0; i < y->count; ++i)
+    {
+        float py = 2 * y->positions[i] - 1, shade = y->major[i] ? 0.45f : 0.3f;
+        out[n++] = (vec3) {-1, py, shade};
+        out[n++] = (vec3) {1, py, shade};
+    }
+    vec3 corners[] = {{-1, -1, 0.8f}, {1, -1, 0.8f}, {1, 1, 0.8f}, {-1, 1, 0.8f}};
+    for (size_t i = 0; i < 4; ++i)
+    {
+        out[n++] = corners[i];
+        out[n++] = corners[(i + 1) % 4];
+    }
+    return n;
+}
+
+/* Lays out the major ticks' labels inside the bottom and left edges of a framebuffer */
+void label_ticks(TextBatch *batch, const Ticks *x, const Ticks *y, int fb_width, int fb_height, int scale)
+{
+    uint32_t color = rgba(1, 1, 1, 1);
+    float margin = 4 * scale;
+    for (size_t i = 0; i < x->count; ++i)
+        if (x->labels[i][0] != '\0')
+            text_add(batch, x->positions[i] * fb_width, fb_height - margin, 0.5f, 1, scale, color, x->labels[i]);
+    for (size_t i = 0; i < y->count; ++i)
+        if (y->labels[i][0] != '\0')
+            text_add(batch, margin, (1 - y->positions[i]) * fb_height, 0, 0.5f, scale, color, y->labels[i]);
+}
+
+#endif
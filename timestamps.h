@@ -0,0 +1,226 @@
+#ifndef TIMESTAMPS_H
+#define TIMESTAMPS_H
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mathlib.h"
+#include "sampler.h"
+#include "ticks.h"
+
+/*
+ * Timestamps as int64 nanoseconds since the Unix epoch, UTC, which covers
+ * the years 1678 to 2261 to the nanosecond. A float has 24 bits, so today's
+ * seconds since the epoch step by two minutes in one and nanoseconds are
+ * only exact up to 17 ms; times never reach the GPU as they are. Instead
+ * the x of every vertex is the float number of seconds since an origin
+ * that follows the view, and the View is in double seconds since the same
+ * origin. time_rebase() moves the origin to the middle of the view whenever
+ * the view has gone far enough from it that floats near the view would be
+ * coarser than a fraction of a pixel; only then are the offsets rebuilt.
+ *
+ * parse_timestamp() reads ISO-8601, YYYY-MM-DD[Thh:mm:ss[.fffffffff]][Z|
+ * +hh:mm|-hh:mm], or a plain integer of nanoseconds since the epoch. The
+ * fixed-width part of ISO-8601 is checked and split as two 8-byte words,
+ * digits and separators at once, with no branch per character; only the
+ * fraction and the zone, whose lengths vary, are read a character at a
+ * time, though 8 digits of a fraction or an integer are read as one word
+ * too.
+ */
+
+/* How many spans of the view it may be from its origin before time_rebase() moves the origin */
+#define TIME_REBASE 1024
+
+/* 8 bytes as a little-endian word: p[0] is the low byte */
+uint64_t load_word(const char *p)
+{
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+    return word;
+}
+
+/*
+ * Nonzero unless all the bytes of `word` whose high bit is set in `mask`
+ * are ASCII digits. XOR with '0' maps the digits to 0..9 and everything
+ * else to 10 or more, which adding 0x76 carries into the high bit.
+ */
+uint64_t nondigits(uint64_t word, uint64_t mask)
+{
+    uint64_t x = word ^ 0x3030303030303030ull;
+    return ((x + 0x7676767676767676ull) | x) & mask;
+}
+
+/* Byte i of a word XORed with '0', the value of the digit there */
+int word_digit(uint64_t x, int i)
+{
+    return (x >> (8 * i)) & 0xff;
+}
+
+/* The 8 digits of a word, first byte most significant, as a number: pairs, then fours, then all eight */
+uint64_t word_number(uint64_t word)
+{
+    uint64_t x = word ^ 0x3030303030303030ull;
+    x = (10 * x + (x >> 8)) & 0x00ff00ff00ff00ffull;
+    x = (100 * x + (x >> 16)) & 0x0000ffff0000ffffull;
+    return (10000 * x + (x >> 32)) & 0xffffffffull;
+}
+
+/* "YYYY-MM-" and "hh:mm:ss": where the digits are, and the separators between them */
+#define DATE_DIGITS 0x0080800080808080ull
+#define DATE_SEPARATORS_MASK 0xff0000ff00000000ull
+#define DATE_SEPARATORS 0x2d00002d00000000ull
+#define CLOCK_DIGITS 0x8080008080008080ull
+#define CLOCK_SEPARATORS_MASK 0x0000ff0000ff0000ull
+#define CLOCK_SEPARATORS 0x00003a00003a0000ull
+
+/* Days in a month of the Gregorian calendar */
+int days_in_month(int year, int month)
+{
+    static const int days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    bool leap = year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+    return days[month - 1] + (month == 2 && leap);
+}
+
+/* An optional sign and up to 19 digits, as nanoseconds since the epoch */
+bool parse_epoch_ns(const char *p, const char **end, int64_t *ns)
+{
+    bool negative = *p == '-';
+    p += negative || *p == '+';
+    const char *digits = p;
+    uint64_t value = 0;
+    while (p - digits + 8 <= 19 && strnlen(p, 8) == 8 && nondigits(load_word(p), 0x8080808080808080ull) == 0)
+    {
+        value = 100000000 * value + word_number(load_word(p));
+        p += 8;
+    }
+    while (*p >= '0' && *p <= '9' && p - digits < 19)
+        value = 10 * value + (*p++ - '0');
+    if (p == digits || (*p >= '0' && *p <= '9') || value > INT64_MAX)
+        return false;
+    *ns = negative ? -(int64_t) value : (int64_t) value;
+    *end = p;
+    return true;
+}
+
+/*
+ * Reads a timestamp at p into nanoseconds since the epoch and sets *end
+ * after it. Times without a zone are UTC; fractions past nanoseconds are
+ * dropped. False if p does not start with a timestamp in range.
+ */
+bool parse_timestamp(const char *p, const char **end, int64_t *ns)
+{
+    /* Anything shorter than a date, or not starting with one, can only be nanoseconds */
+    size_t length = strnlen(p, 19);
+    if (length < 10)
+        return parse_epoch_ns(p, end, ns);
+    uint64_t date = load_word(p);
+    if (nondigits(date, DATE_DIGITS) || (date & DATE_SEPARATORS_MASK) != DATE_SEPARATORS)
+        return parse_epoch_ns(p, end, ns);
+    uint64_t x = date ^ 0x3030303030303030ull;
+    int year = 1000 * word_digit(x, 0) + 100 * word_digit(x, 1) + 10 * word_digit(x, 2) + word_digit(x, 3);
+    int month = 10 * word_digit(x, 5) + word_digit(x, 6);
+    int day = 10 * (p[8] - '0') + (p[9] - '0');
+    if (p[8] < '0' || p[8] > '9' || p[9] < '0' || p[9] > '9' || month < 1 || month > 12)
+        return false;
+    if (day < 1 || day > days_in_month(year, month))
+        return false;
+    int64_t seconds = 86400 * days_from_civil(year, month, day);
+    const char *q = p + 10;
+
+    /* The time of day, if the date is followed by one */
+    if (length == 19 && (p[10] == 'T' || p[10] == 't' || p[10] == ' '))
+    {
+        uint64_t clock = load_word(p + 11);
+        if (nondigits(clock, CLOCK_DIGITS) == 0 && (clock & CLOCK_SEPARATORS_MASK) == CLOCK_SEPARATORS)
+        {
+            x = clock ^ 0x3030303030303030ull;
+            int hour = 10 * word_digit(x, 0) + word_digit(x, 1);
+            int minute = 10 * word_digit(x, 3) + word_digit(x, 4);
+            int second = 10 * word_digit(x, 6) + word_digit(x, 7);
+            if (hour > 23 || minute > 59 || second > 60)
+                return false;
+            seconds += 3600 * hour + 60 * minute + second;
+            q = p + 19;
+        }
+    }
+    int64_t fraction = 0;
+    if (q == p + 19 && *q == '.')
+    {
+        const char *digits = ++q;
+        int64_t scale = NS_PER_SECOND;
+        if (strnlen(q, 8) == 8 && nondigits(load_word(q), 0x8080808080808080ull) == 0)
+        {
+            fraction = 10 * word_number(load_word(q));
+            scale = 10;
+            q += 8;
+        }
+        for (; *q >= '0' && *q <= '9'; ++q)
+        {
+            scale = scale >= 10 ? scale / 10 : 0;
+            fraction += scale * (*q - '0');
+        }
+        if (q == digits)
+            return false;
+    }
+
+    /* The zone, as an offset from UTC to subtract */
+    if (*q == 'Z' || *q == 'z')
+        ++q;
+    else if ((*q == '+' || *q == '-') && q[1] >= '0' && q[1] <= '9' && q[2] >= '0' && q[2] <= '9')
+    {
+        int sign = *q == '-' ? -1 : 1;
+        int offset = 60 * (10 * (q[1] - '0') + (q[2] - '0'));
+        q += 3;
+        q += *q == ':';
+        if (*q >= '0' && *q <= '9' && q[1] >= '0' && q[1] <= '9')
+        {
+            offset += 10 * (q[0] - '0') + (q[1] - '0');
+            q += 2;
+        }
+        seconds -= sign * 60 * offset;
+    }
+    if (seconds > INT64_MAX / NS_PER_SECOND - 1 || seconds < INT64_MIN / NS_PER_SECOND + 1)
+        return false;
+    *ns = seconds * NS_PER_SECOND + fraction;
+    *end = q;
+    return true;
+}
+
+/* Seconds from `origin` to t, both in nanoseconds, as the GPU gets them */
+float time_offset(int64_t t, int64_t origin)
+{
+    return (t - origin) / (double) NS_PER_SECOND;
+}
+
+/* (seconds since origin, y, 0) points of a time series, for everything that takes them */
+void time_points(size_t n, const int64_t t[n], const float y[n], int64_t origin, vec3 out[n])
+{
+    for (size_t i = 0; i < n; ++i)
+        out[i] = (vec3) {time_offset(t[i], origin), y[i], 0};
+}
+
+/*
+ * Moves the origin to the middle of the view, and the view along with it,
+ * once the view is more than TIME_REBASE of its widths from the origin.
+ * There floats step by at most 1/8192 of the view, about half a pixel on
+ * a 4K display, so they round to within a quarter of a pixel. True if the
+ * origin moved, and the x offsets need rebuilding from it.
+ */
+bool time_rebase(int64_t *origin, View *view)
+{
+    double span = view->x1 - view->x0;
+    if (!(span > 0) || fmax(fabs(view->x0), fabs(view->x1)) <= TIME_REBASE * span)
+        return false;
+    int64_t shift = llround(0.5 * (view->x0 + view->x1) * NS_PER_SECOND);
+    *origin += shift;
+    view->x0 -= shift / (double) NS_PER_SECOND;
+    view->x1 -= shift / (double) NS_PER_SECOND;
+    return true;
+}
+
+#endif
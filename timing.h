@@ -0,0 +1,14 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <time.h>
+
+/* Monotonic wall clock in seconds */
+double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef UPLOADER_H
+#define UPLOADER_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "render.h"
+#include "threads.h"
+#include "timing.h"
+
+/*
+ * Background buffer uploads.
+ *
+ * The uploader owns a hidden window whose context shares objects with the
+ * main window, and a thread that makes it current. An upload creates a fresh
+ * VBO/EBO pair there, fills it in UPLOAD_CHUNK pieces with glBufferSubData,
+ * and fences. The upload thread waits on its own fence (it has nothing else
+ * to do) and then marks the job ready and wakes the render loop.
+ *
+ * The render thread keeps drawing the old buffers meanwhile. Once
+ * upload_poll() sees the job ready it checks the fence without waiting,
+ * points the object's VAO at the new buffers (VAOs are not shared between
+ * contexts, so this has to happen on the render thread) and deletes the old
+ * ones. The mesh must stay valid until then; the object's mesh is replaced
+ * by it when the swap happens.
+ */
+
+#define UPLOAD_CHUNK ((size_t) 8 << 20)
+
+typedef struct AsyncUpload
+{
+    GameObject *target;
+    Mesh mesh;
+    uint VBO, EBO;
+    GLsync fence;
+    double seconds;
+    bool busy;  /* render thread only */
+    bool ready; /* set by the upload thread */
+} AsyncUpload;
+
+typedef struct Uploader
+{
+    GLFWwindow *context;
+    pthread_t thread;
+    Queue requests;
+} Uploader;
+
+void upload_chunked(GLenum target, size_t size, const void *data)
+{
+    glBufferData(target, size, NULL, GL_STATIC_DRAW);
+    for (size_t offset = 0; offset < size; offset += UPLOAD_CHUNK)
+    {
+        size_t chunk = size - offset < UPLOAD_CHUNK ? size - offset : UPLOAD_CHUNK;
+        glBufferSubData(target, offset, chunk, (const char *) data + offset);
+        glFlush();
+    }
+}
+
+void *uploader_thread(void *arg)
+{
+    Uploader *uploader = arg;
+    glfwMakeContextCurrent(uploader->context);
+
+    AsyncUpload *job;
+    while ((job = queue_pop(&uploader->requests)) != NULL)
+    {
+        double t0 = now_seconds();
+        glGenBuffers(1, &job->VBO);
+        glBindBuffer(GL_ARRAY_BUFFER, job->VBO);
+        upload_chunked(GL_ARRAY_BUFFER, job->mesh.num_vertices * sizeof(vec3), job->mesh.vertices);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        /* Bound as an array buffer: element bindings are VAO state and there is no VAO here */
+        glGenBuffers(1, &job->EBO);
+        glBindBuffer(GL_ARRAY_BUFFER, job->EBO);
+        upload_chunked(GL_ARRAY_BUFFER, job->mesh.num_indices * sizeof(uint), job->mesh.indices);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        job->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glClientWaitSync(job->fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        job->seconds = now_seconds() - t0;
+
+        __atomic_store_n(&job->ready, true, __ATOMIC_RELEASE);
+        request_redraw();
+    }
+
+    glfwMakeContextCurrent(NULL);
+    return NULL;
+}
+
+/* Call on the main thread, after the main window exists */
+void init_Uploader(Uploader *uploader, GLFWwindow *main_window)
+{
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    uploader->context = glfwCreateWindow(1, 1, "upload", NULL, main_window);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+    if (uploader->context == NULL)
+    {
+        printf("Failed to create upload context\n");
+        exit(-1);
+    }
+    init_Queue(&uploader->requests, 16);
+    pthread_create(&uploader->thread, NULL, uploader_thread, uploader);
+}
+
+void delete_Uploader(Uploader *uploader)
+{
+    queue_close(&uploader->requests);
+    pthread_join(uploader->thread, NULL);
+    delete_Queue(&uploader->requests);
+    glfwDestroyWindow(uploader->context);
+}
+
+/* Starts uploading `mesh` for `target`; false if `job` still has one in flight */
+bool upload_async(Uploader *uploader, AsyncUpload *job, GameObject *target, Mesh mesh)
+{
+    if (job->busy)
+        return false;
+    job->target = target;
+    job->mesh = mesh;
+    job->busy = true;
+    job->ready = false;
+    queue_push(&uploader->requests, job);
+    return true;
+}
+
+/* Render thread, once per frame: swaps in a finished upload and returns true */
+bool upload_poll(AsyncUpload *job)
+{
+    if (!job->busy || !__atomic_load_n(&job->ready, __ATOMIC_ACQUIRE))
+        return false;
+    GLenum status = glClientWaitSync(job->fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+        return false;
+    glDeleteSync(job->fence);
+
+    GameObject *rend = job->target;
+    glDeleteBuffers(2, (uint[]){rend->VBO, rend->EBO});
+    rend->VBO = job->VBO;
+    rend->EBO = job->EBO;
+    rend->mesh = job->mesh;
+
+    glBindVertexArray(rend->VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, rend->VBO);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_TRUE, sizeof(vec3), (void *)0);
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, rend->EBO);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    rend->dirty = true;
+    job->busy = false;
+    return true;
+}
+
+#endif